@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/chrono.hpp>
+
+#include <rusql/histogram.hpp>
+#include <rusql/mysql/allocations.hpp>
+
+namespace bench {
+	typedef boost::chrono::steady_clock Clock;
+
+	//! One benchmark run: the case loops on keep_running(), which times every iteration, for at least
+	//! min_time. Work done before the loop isn't measured.
+	struct State {
+		State(std::string const name_, Clock::duration const min_time_)
+		: name(name_)
+		, min_time(min_time_)
+		, iterations(0)
+		, items(0)
+		, started(false)
+		, counted_allocations(false)
+		, allocation_budget(-1)
+		{}
+
+		bool keep_running() {
+			auto const now = Clock::now();
+			if(!started) {
+				started = true;
+				start = last = now;
+				allocations_at_start = rusql::mysql::thread_allocations();
+				return true;
+			}
+			latencies.record(now - last);
+			++iterations;
+			last = now;
+			if(now - start >= min_time) {
+				stop = now;
+				allocated = rusql::mysql::allocations_since(allocations_at_start);
+				counted_allocations = rusql::mysql::is_counting_allocations();
+				return false;
+			}
+			return true;
+		}
+
+		//! For cases that time themselves, e.g. over several threads: iterations finished in elapsed, with
+		//! their latencies already in latencies.
+		void finish(Clock::duration const elapsed, uint64_t const iterations_) {
+			start = Clock::time_point();
+			stop = start + elapsed;
+			iterations = iterations_;
+		}
+
+		//! Units of work done, e.g. rows read, for items_per_second.
+		void add_items(uint64_t const n) {
+			items += n;
+		}
+
+		//! Fails the case if its iterations allocate more than this many times on average, counted on the thread
+		//! that calls keep_running(); see rusql/mysql/allocations.hpp. Only checked when allocations are counted.
+		void set_allocation_budget(double const allocations_per_iteration) {
+			allocation_budget = allocations_per_iteration;
+		}
+
+		double allocations_per_iteration() const {
+			return iterations == 0 ? 0.0 : double(allocated.allocations) / double(iterations);
+		}
+
+		bool over_allocation_budget() const {
+			return counted_allocations && allocation_budget >= 0 && allocations_per_iteration() > allocation_budget;
+		}
+
+		//! Reported as is next to the timings.
+		void set_counter(std::string const& counter, double const value) {
+			counters[counter] = value;
+		}
+
+		Clock::duration elapsed() const {
+			return stop - start;
+		}
+
+		//! A line of JSON, so that runs can be compared by a script.
+		std::string to_json() const {
+			double const seconds = boost::chrono::duration<double>(elapsed()).count();
+			std::ostringstream s;
+			s << "{\"benchmark\":\"" << name << "\""
+			  << ",\"iterations\":" << iterations
+			  << ",\"seconds\":" << seconds
+			  << ",\"ns_per_iteration\":" << (iterations == 0 ? 0.0 : seconds * 1e9 / double(iterations));
+			if(items != 0) {
+				s << ",\"items\":" << items << ",\"items_per_second\":" << (seconds == 0 ? 0.0 : double(items) / seconds);
+			}
+			for(double const p : {0.5, 0.9, 0.99}) {
+				s << ",\"p" << int(std::round(p * 100)) << "_us\":" << boost::chrono::duration_cast<boost::chrono::microseconds>(latencies.percentile(p)).count();
+			}
+			if(counted_allocations) {
+				s << ",\"allocations_per_iteration\":" << allocations_per_iteration()
+				  << ",\"allocated_bytes_per_iteration\":" << (iterations == 0 ? 0.0 : double(allocated.bytes) / double(iterations));
+			}
+			for(auto const &counter : counters) {
+				s << ",\"" << counter.first << "\":" << counter.second;
+			}
+			s << "}";
+			return s.str();
+		}
+
+		std::string const name;
+		Clock::duration const min_time;
+		//! Per iteration, or per operation for cases that call finish().
+		rusql::LatencyHistogram latencies;
+
+	private:
+		uint64_t iterations;
+		uint64_t items;
+		bool started;
+		Clock::time_point start, last, stop;
+		bool counted_allocations;
+		rusql::mysql::AllocationCount allocations_at_start, allocated;
+		double allocation_budget;
+		std::map<std::string, double> counters;
+	};
+
+	struct Case {
+		std::string name;
+		std::function<void(State&)> run;
+	};
+
+	inline std::vector<Case>& cases() {
+		static std::vector<Case> all;
+		return all;
+	}
+
+	//! Registers a case at startup; define one as a static in the file that implements it.
+	struct Register {
+		Register(std::string const name, std::function<void(State&)> run) {
+			cases().push_back(Case{name, run});
+		}
+	};
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <rusql/rusql.hpp>
+
+namespace bench {
+	//! Sets up the database like the tests do, see tests/database_test.hpp; provided by main().
+	inline std::function<rusql::Database::ConstructionInfo()>& set_up_database() {
+		static std::function<rusql::Database::ConstructionInfo()> f;
+		return f;
+	}
+
+	//! Where the cases connect to. The database is set up on first use, so cases that need none don't wait
+	//! for the embedded server.
+	inline rusql::Database::ConstructionInfo const& construction_info() {
+		static rusql::Database::ConstructionInfo const info = set_up_database()();
+		return info;
+	}
+
+	//! A Database with a pool of its own, so cases don't inherit each other's connections.
+	inline std::shared_ptr<rusql::Database> database() {
+		return std::make_shared<rusql::Database>(construction_info());
+	}
+}
@@ -0,0 +1,190 @@
+#include <string>
+#include <vector>
+
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+
+#include "bench.hpp"
+
+// The same work as some of the cases in queries.cpp, served from memory by FakeBackend: what's left is the
+// cost of rusql itself.
+namespace {
+	typedef rusql::mysql::FakeBackend FakeBackend;
+
+	size_t const wide_columns = 10;
+	size_t const wide_rows = 1000;
+	size_t const parameters = 10;
+
+	std::string const scan = "SELECT * FROM rusqlbench_wide";
+	std::string const select_row = "SELECT c0 FROM rusqlbench_wide WHERE id = ?";
+	std::string const insert = "INSERT INTO rusqlbench_insert VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+	void script(FakeBackend &fake) {
+		std::vector<std::string> columns = {"id"};
+		for(size_t c = 0; c < wide_columns; ++c) {
+			columns.push_back("c" + std::to_string(c));
+		}
+		FakeBackend::Result wide(columns);
+		for(size_t id = 0; id < wide_rows; ++id) {
+			std::vector<std::string> row = {std::to_string(id)};
+			for(size_t c = 0; c < wide_columns; ++c) {
+				row.push_back("row " + std::to_string(id) + " column " + std::to_string(c));
+			}
+			wide.row(row);
+		}
+		fake.script(scan, wide);
+		fake.script(select_row, FakeBackend::Result({"c0"}).row({"row 1 column 0"}));
+
+		FakeBackend::Result inserted;
+		inserted.affected_rows = 1;
+		fake.script(insert, inserted);
+	}
+
+	// Each case has a budget of allocations per iteration, FakeBackend's own included, a little over what it
+	// allocated when it was written with GCC's libstdc++: a hot path that starts allocating fails the case. The
+	// scans allow less than one more per row.
+
+	//! Runs f with a Database whose statements are served by a scripted FakeBackend.
+	template <typename F>
+	void with_fake(F f) {
+		FakeBackend fake;
+		script(fake);
+		rusql::mysql::BackendScope scope(fake);
+		auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+		f(db);
+	}
+
+	bench::Register fake_select_row_prepared("fake_select_row_prepared", [](bench::State &state) {
+		with_fake([&state](std::shared_ptr<rusql::Database> db) {
+			state.set_allocation_budget(49.5);
+			std::string c0;
+			size_t id = 0;
+			while(state.keep_running()) {
+				auto statement = db->execute(select_row, id++);
+				statement.bind_results(c0);
+				statement.fetch();
+			}
+		});
+	});
+
+	bench::Register fake_select_row_cached("fake_select_row_cached", [](bench::State &state) {
+		with_fake([&state](std::shared_ptr<rusql::Database> db) {
+			state.set_allocation_budget(29.5);
+			auto lease = db->acquire();
+			std::string c0;
+			size_t id = 0;
+			while(state.keep_running()) {
+				auto &statement = lease.execute_cached(select_row, id++);
+				statement.bind_results(c0);
+				statement.fetch();
+				statement.free_result();
+			}
+		});
+	});
+
+	bench::Register fake_scan_resultset("fake_scan_resultset", [](bench::State &state) {
+		with_fake([&state](std::shared_ptr<rusql::Database> db) {
+			state.set_allocation_budget(10500);
+			while(state.keep_running()) {
+				for(auto rs = db->select_query(scan); rs; rs.next()) {
+					for(size_t c = 0; c <= wide_columns; ++c) {
+						rs.get_string(c);
+					}
+					state.add_items(1);
+				}
+			}
+			state.set_counter("columns", wide_columns + 1);
+		});
+	});
+
+	bench::Register fake_scan_prepared("fake_scan_prepared", [](bench::State &state) {
+		with_fake([&state](std::shared_ptr<rusql::Database> db) {
+			state.set_allocation_budget(24500);
+			std::vector<std::string> columns(wide_columns + 1);
+			while(state.keep_running()) {
+				auto statement = db->execute(scan);
+				statement.bind_results(columns);
+				while(statement.fetch()) {
+					state.add_items(1);
+				}
+			}
+			state.set_counter("columns", wide_columns + 1);
+		});
+	});
+
+	//! Counts events and nothing else, so what's measured is the cost of reporting them.
+	struct CountingObserver : rusql::mysql::QueryObserver {
+		CountingObserver()
+		: events(0)
+		{}
+
+		void on_event(rusql::mysql::QueryEvent const&) override {
+			++events;
+		}
+
+		size_t events;
+	};
+
+	bench::Register fake_scan_prepared_observed("fake_scan_prepared_observed", [](bench::State &state) {
+		with_fake([&state](std::shared_ptr<rusql::Database> db) {
+			state.set_allocation_budget(25500);
+			auto observer = std::make_shared<CountingObserver>();
+			db->set_query_observer(observer);
+			std::vector<std::string> columns(wide_columns + 1);
+			while(state.keep_running()) {
+				auto statement = db->execute(scan);
+				statement.bind_results(columns);
+				while(statement.fetch()) {
+					state.add_items(1);
+				}
+			}
+			state.set_counter("columns", wide_columns + 1);
+			state.set_counter("events", observer->events);
+		});
+	});
+
+	bench::Register fake_access_named("fake_access_named", [](bench::State &state) {
+		with_fake([&state](std::shared_ptr<rusql::Database> db) {
+			state.set_allocation_budget(10500);
+			std::vector<std::string> names;
+			for(size_t c = 0; c < wide_columns; ++c) {
+				names.push_back("c" + std::to_string(c));
+			}
+			while(state.keep_running()) {
+				for(auto rs = db->select_query(scan); rs; rs.next()) {
+					for(auto const &name : names) {
+						rs.get<std::string>(name);
+					}
+					state.add_items(wide_columns);
+				}
+			}
+		});
+	});
+
+	bench::Register fake_access_indexed("fake_access_indexed", [](bench::State &state) {
+		with_fake([&state](std::shared_ptr<rusql::Database> db) {
+			state.set_allocation_budget(10500);
+			while(state.keep_running()) {
+				for(auto rs = db->select_query(scan); rs; rs.next()) {
+					for(size_t c = 1; c <= wide_columns; ++c) {
+						rs.get<std::string>(c);
+					}
+					state.add_items(wide_columns);
+				}
+			}
+		});
+	});
+
+	bench::Register fake_bind_parameters("fake_bind_parameters", [](bench::State &state) {
+		with_fake([&state](std::shared_ptr<rusql::Database> db) {
+			state.set_allocation_budget(12.5);
+			auto lease = db->acquire();
+			std::vector<std::string> values(parameters, "a value to bind");
+			while(state.keep_running()) {
+				lease.prepare_cached(insert).bind_parameters(values).execute();
+				state.add_items(parameters);
+			}
+			state.set_counter("parameters", parameters);
+		});
+	});
+}
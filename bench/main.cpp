@@ -0,0 +1,51 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <rusql/rusql.hpp>
+#include "tests/database_test.hpp"
+
+#include "bench.hpp"
+#include "database.hpp"
+
+//! rusql_bench [--filter=<substring>] [--min-time=<milliseconds>] [<host> <user> <pass> <emptydb>]
+//! Without a database to connect to, the embedded server is used. Prints one line of JSON per case.
+int main(int argc, char *argv[]) {
+	std::string filter;
+	long min_time_ms = 1000;
+
+	std::vector<char*> args;
+	for(int i = 0; i < argc; ++i) {
+		if(std::strncmp(argv[i], "--filter=", 9) == 0) {
+			filter = argv[i] + 9;
+		} else if(std::strncmp(argv[i], "--min-time=", 11) == 0) {
+			min_time_ms = std::atol(argv[i] + 11);
+		} else {
+			args.push_back(argv[i]);
+		}
+	}
+
+	bench::set_up_database() = [&args]() { return get_construction_info(int(args.size()), args.data()); };
+
+	int failed = 0;
+	for(auto const &c : bench::cases()) {
+		if(c.name.find(filter) == std::string::npos) {
+			continue;
+		}
+		bench::State state(c.name, boost::chrono::milliseconds(min_time_ms));
+		try {
+			c.run(state);
+			std::cout << state.to_json() << std::endl;
+			if(state.over_allocation_budget()) {
+				std::cerr << c.name << " failed: " << state.allocations_per_iteration() << " allocations per iteration is over its budget" << std::endl;
+				++failed;
+			}
+		} catch(std::exception &e) {
+			std::cerr << c.name << " failed: " << e.what() << std::endl;
+			++failed;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <rusql/rusql.hpp>
+
+#include "bench.hpp"
+#include "database.hpp"
+
+namespace {
+	size_t const wide_columns = 10;
+	size_t const wide_rows = 10000;
+
+	//! A table that exists for as long as the case runs.
+	struct Table {
+		Table(std::shared_ptr<rusql::Database> database_, std::string const name_, std::string const columns)
+		: database(database_)
+		, name(name_)
+		{
+			database->execute("DROP TABLE IF EXISTS " + name);
+			database->execute("CREATE TABLE " + name + " (" + columns + ")");
+		}
+
+		~Table() {
+			try {
+				database->execute("DROP TABLE " + name);
+			} catch(rusql::mysql::SQLError &e) {
+				std::cerr << "Could not drop " << name << ": " << e.what() << std::endl;
+			}
+		}
+
+		std::shared_ptr<rusql::Database> database;
+		std::string const name;
+	};
+
+	//! (?, ?), (?, ?) ... for rows of columns placeholders each.
+	std::string placeholders(size_t const rows, size_t const columns) {
+		std::string row = "(";
+		for(size_t c = 0; c < columns; ++c) {
+			row += c == 0 ? "?" : ", ?";
+		}
+		row += ")";
+		std::string q;
+		for(size_t r = 0; r < rows; ++r) {
+			q += (r == 0 ? "" : ", ") + row;
+		}
+		return q;
+	}
+
+	//! id plus wide_columns short strings, wide_rows rows.
+	std::unique_ptr<Table> wide_table(std::shared_ptr<rusql::Database> db) {
+		std::string columns = "id INT NOT NULL PRIMARY KEY";
+		for(size_t c = 0; c < wide_columns; ++c) {
+			columns += ", c" + std::to_string(c) + " VARCHAR(32) NOT NULL";
+		}
+		std::unique_ptr<Table> table(new Table(db, "rusqlbench_wide", columns));
+
+		size_t const batch = 500;
+		for(size_t first = 0; first < wide_rows; first += batch) {
+			std::vector<std::string> values;
+			for(size_t id = first; id < first + batch; ++id) {
+				values.push_back(std::to_string(id));
+				for(size_t c = 0; c < wide_columns; ++c) {
+					values.push_back("row " + std::to_string(id) + " column " + std::to_string(c));
+				}
+			}
+			db->execute("INSERT INTO rusqlbench_wide VALUES " + placeholders(batch, wide_columns + 1), values);
+		}
+		return table;
+	}
+
+	bench::Register select_row_query("select_row_query", [](bench::State &state) {
+		auto db = bench::database();
+		auto table = wide_table(db);
+		size_t id = 0;
+		while(state.keep_running()) {
+			auto rs = db->select_query("SELECT c0 FROM rusqlbench_wide WHERE id = " + std::to_string(id++ % wide_rows));
+			rs.get_string(0);
+		}
+	});
+
+	bench::Register select_row_prepared("select_row_prepared", [](bench::State &state) {
+		auto db = bench::database();
+		auto table = wide_table(db);
+		size_t id = 0;
+		std::string c0;
+		while(state.keep_running()) {
+			auto statement = db->execute("SELECT c0 FROM rusqlbench_wide WHERE id = ?", id++ % wide_rows);
+			statement.bind_results(c0);
+			statement.fetch();
+		}
+	});
+
+	bench::Register select_row_cached("select_row_cached", [](bench::State &state) {
+		auto db = bench::database();
+		auto table = wide_table(db);
+		auto lease = db->acquire();
+		size_t id = 0;
+		std::string c0;
+		while(state.keep_running()) {
+			auto &statement = lease.execute_cached("SELECT c0 FROM rusqlbench_wide WHERE id = ?", id++ % wide_rows);
+			statement.bind_results(c0);
+			statement.fetch();
+			statement.free_result();
+		}
+	});
+
+	bench::Register scan_resultset("scan_resultset", [](bench::State &state) {
+		auto db = bench::database();
+		auto table = wide_table(db);
+		while(state.keep_running()) {
+			for(auto rs = db->select_query("SELECT * FROM rusqlbench_wide"); rs; rs.next()) {
+				for(size_t c = 0; c <= wide_columns; ++c) {
+					rs.get_string(c);
+				}
+				state.add_items(1);
+			}
+		}
+		state.set_counter("columns", wide_columns + 1);
+	});
+
+	bench::Register scan_prepared("scan_prepared", [](bench::State &state) {
+		auto db = bench::database();
+		auto table = wide_table(db);
+		std::vector<std::string> columns(wide_columns + 1);
+		while(state.keep_running()) {
+			auto statement = db->execute("SELECT * FROM rusqlbench_wide");
+			statement.bind_results(columns);
+			while(statement.fetch()) {
+				state.add_items(1);
+			}
+		}
+		state.set_counter("columns", wide_columns + 1);
+	});
+
+	bench::Register access_indexed("access_indexed", [](bench::State &state) {
+		auto db = bench::database();
+		auto table = wide_table(db);
+		while(state.keep_running()) {
+			for(auto rs = db->select_query("SELECT * FROM rusqlbench_wide LIMIT 1000"); rs; rs.next()) {
+				for(size_t c = 1; c <= wide_columns; ++c) {
+					rs.get<std::string>(c);
+				}
+				state.add_items(wide_columns);
+			}
+		}
+	});
+
+	bench::Register access_named("access_named", [](bench::State &state) {
+		auto db = bench::database();
+		auto table = wide_table(db);
+		std::vector<std::string> names;
+		for(size_t c = 0; c < wide_columns; ++c) {
+			names.push_back("c" + std::to_string(c));
+		}
+		while(state.keep_running()) {
+			for(auto rs = db->select_query("SELECT * FROM rusqlbench_wide LIMIT 1000"); rs; rs.next()) {
+				for(auto const &name : names) {
+					rs.get<std::string>(name);
+				}
+				state.add_items(wide_columns);
+			}
+		}
+	});
+
+	bench::Register access_prepared_named("access_prepared_named", [](bench::State &state) {
+		auto db = bench::database();
+		auto table = wide_table(db);
+		std::vector<std::string> names;
+		for(size_t c = 0; c < wide_columns; ++c) {
+			names.push_back("c" + std::to_string(c));
+		}
+		while(state.keep_running()) {
+			auto statement = db->execute("SELECT * FROM rusqlbench_wide LIMIT 1000");
+			statement.bind_all_self();
+			while(statement.fetch()) {
+				for(auto const &name : names) {
+					statement.get<std::string>(name);
+				}
+				state.add_items(wide_columns);
+			}
+		}
+	});
+
+	std::string const insert_columns = "id INT NOT NULL, name VARCHAR(32) NOT NULL";
+	size_t const insert_batch = 100;
+
+	bench::Register insert_single("insert_single", [](bench::State &state) {
+		auto db = bench::database();
+		Table table(db, "rusqlbench_insert", insert_columns);
+		int id = 0;
+		while(state.keep_running()) {
+			db->execute("INSERT INTO rusqlbench_insert VALUES (?, ?)", id++, "name");
+			state.add_items(1);
+		}
+	});
+
+	bench::Register insert_batched("insert_batched", [](bench::State &state) {
+		auto db = bench::database();
+		Table table(db, "rusqlbench_insert", insert_columns);
+		std::string const q = "INSERT INTO rusqlbench_insert VALUES " + placeholders(insert_batch, 2);
+		std::vector<std::string> values;
+		while(state.keep_running()) {
+			values.clear();
+			for(size_t i = 0; i < insert_batch; ++i) {
+				values.push_back(std::to_string(i));
+				values.push_back("name");
+			}
+			db->execute(q, values);
+			state.add_items(insert_batch);
+		}
+		state.set_counter("batch", insert_batch);
+	});
+
+	bench::Register insert_transaction("insert_transaction", [](bench::State &state) {
+		auto db = bench::database();
+		Table table(db, "rusqlbench_insert", insert_columns);
+		int id = 0;
+		while(state.keep_running()) {
+			auto transaction = db->begin();
+			for(size_t i = 0; i < insert_batch; ++i) {
+				transaction.execute("INSERT INTO rusqlbench_insert VALUES (?, ?)", id++, "name");
+			}
+			transaction.commit();
+			state.add_items(insert_batch);
+		}
+		state.set_counter("batch", insert_batch);
+	});
+
+	//! Like insert_transaction, with the statement prepared once per transaction: what is left is the cost of the
+	//! commits, against one per row in insert_single.
+	bench::Register insert_transaction_prepared("insert_transaction_prepared", [](bench::State &state) {
+		auto db = bench::database();
+		Table table(db, "rusqlbench_insert", insert_columns);
+		int id = 0;
+		while(state.keep_running()) {
+			auto transaction = db->begin();
+			auto statement = transaction.prepare("INSERT INTO rusqlbench_insert VALUES (?, ?)");
+			for(size_t i = 0; i < insert_batch; ++i) {
+				statement.execute(id++, "name");
+			}
+			transaction.commit();
+			state.add_items(insert_batch);
+		}
+		state.set_counter("batch", insert_batch);
+	});
+
+	//! threads threads running short queries through one Database as fast as they can.
+	void pool_contention(bench::State &state, size_t const threads) {
+		auto db = bench::database();
+		std::atomic<uint64_t> done(0);
+		std::atomic<bool> stop(false);
+
+		auto const start = bench::Clock::now();
+		boost::thread_group group;
+		for(size_t t = 0; t < threads; ++t) {
+			group.create_thread([&]() {
+				auto thread_handle = db->get_thread_handle();
+				uint64_t mine = 0;
+				while(!stop) {
+					auto const before = bench::Clock::now();
+					db->select_query("SELECT 1").get_uint64(0);
+					state.latencies.record(bench::Clock::now() - before);
+					++mine;
+				}
+				done += mine;
+			});
+		}
+		boost::this_thread::sleep_for(state.min_time);
+		stop = true;
+		group.join_all();
+
+		state.finish(bench::Clock::now() - start, done);
+		state.add_items(done);
+		state.set_counter("threads", threads);
+		state.set_counter("connections", db->number_of_connections());
+	}
+
+	bench::Register pool_contention_1("pool_contention_1", [](bench::State &state) { pool_contention(state, 1); });
+	bench::Register pool_contention_4("pool_contention_4", [](bench::State &state) { pool_contention(state, 4); });
+	bench::Register pool_contention_16("pool_contention_16", [](bench::State &state) { pool_contention(state, 16); });
+}
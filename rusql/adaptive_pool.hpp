@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <string>
+
+#include <boost/chrono.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace rusql {
+	//! Bounds and tuning of a Database's adaptive pool size; see GradientController.
+	struct AdaptivePoolPolicy {
+		typedef boost::chrono::steady_clock Clock;
+
+		AdaptivePoolPolicy()
+		: enabled(false)
+		, min_connections(1)
+		, max_connections(64)
+		, interval(boost::chrono::seconds(1))
+		, minimum_samples(10)
+		, tolerance(1.5)
+		, smoothing(0.2)
+		, baseline_smoothing(0.05)
+		{}
+
+		bool enabled;
+		size_t min_connections;
+		size_t max_connections;
+		//! How often the size is reconsidered, given minimum_samples requests since the last time.
+		Clock::duration interval;
+		size_t minimum_samples;
+		//! How much slower than the baseline requests may get before the pool shrinks.
+		double tolerance;
+		//! How far the size moves towards its target in one step, between 0 and 1.
+		double smoothing;
+		//! How fast the baseline latency follows the current one, between 0 and 1.
+		double baseline_smoothing;
+	};
+
+	//! Why the pool size changed, or didn't.
+	struct PoolSizeDecision {
+		typedef boost::chrono::steady_clock Clock;
+
+		Clock::time_point when;
+		size_t old_limit;
+		size_t new_limit;
+		//! Most requests running at once during the interval.
+		size_t max_in_flight;
+		//! Mean latency during the interval, and the long-term baseline it is compared with.
+		Clock::duration latency;
+		Clock::duration baseline_latency;
+		//! Mean time requests waited for a connection, over the requests that had to wait.
+		Clock::duration queue_wait;
+		size_t waited;
+		//! baseline / current latency times the tolerance, between 0.5 and 1: below 1 means shrink.
+		double gradient;
+		std::string reason;
+	};
+
+	//! Adjusts a concurrency limit like a gradient limiter: as long as latency stays within tolerance of its
+	//! long-term baseline, the limit grows by about its square root per interval, provided it is actually used;
+	//! once latency rises, it shrinks in proportion. The server's queueing shows up as latency before it shows up
+	//! as errors, so this keeps the pool just big enough.
+	struct GradientController {
+		typedef boost::chrono::steady_clock Clock;
+
+		GradientController()
+		: limit(1)
+		, baseline(0)
+		{
+			reset(Clock::now());
+		}
+
+		void set_policy(AdaptivePoolPolicy const& policy_) {
+			boost::mutex::scoped_lock lock(mutex);
+			policy = policy_;
+			limit = std::min(std::max(limit, double(policy.min_connections)), double(policy.max_connections));
+			reset(Clock::now());
+		}
+
+		bool is_enabled() {
+			boost::mutex::scoped_lock lock(mutex);
+			return policy.enabled;
+		}
+
+		size_t get_limit() {
+			boost::mutex::scoped_lock lock(mutex);
+			return size_t(limit);
+		}
+
+		//! A request that took latency, with in_flight requests running (itself included) when it started.
+		void record(Clock::duration const latency, size_t const in_flight) {
+			boost::mutex::scoped_lock lock(mutex);
+			latency_sum += latency;
+			++samples;
+			max_in_flight = std::max(max_in_flight, in_flight);
+		}
+
+		//! A request that waited for a connection.
+		void record_wait(Clock::duration const wait) {
+			boost::mutex::scoped_lock lock(mutex);
+			wait_sum += wait;
+			++waited;
+		}
+
+		//! Reconsiders the limit if an interval has passed; returns what it decided.
+		boost::optional<PoolSizeDecision> update(Clock::time_point const now) {
+			boost::mutex::scoped_lock lock(mutex);
+			if(!policy.enabled || now - interval_start < policy.interval || samples < policy.minimum_samples) {
+				return boost::none;
+			}
+
+			double const current = boost::chrono::duration<double>(latency_sum).count() / double(samples);
+			if(baseline <= 0) {
+				baseline = current;
+			} else {
+				baseline += (current - baseline) * policy.baseline_smoothing;
+				// after a slow period the baseline would stay high for long; let it recover faster
+				if(baseline > 2 * current) {
+					baseline = current + (baseline - current) * 0.5;
+				}
+			}
+
+			double const gradient = current <= 0 ? 1.0 : std::min(1.0, std::max(0.5, policy.tolerance * baseline / current));
+			bool const used = double(max_in_flight) >= limit / 2 || waited > 0;
+			double target = limit * gradient + (used ? std::sqrt(limit) : 0.0);
+			if(!used) {
+				target = std::min(target, limit);
+			}
+
+			PoolSizeDecision decision;
+			decision.when = now;
+			decision.old_limit = size_t(limit);
+			limit += (target - limit) * policy.smoothing;
+			limit = std::min(std::max(limit, double(policy.min_connections)), double(policy.max_connections));
+			decision.new_limit = size_t(limit);
+			decision.max_in_flight = max_in_flight;
+			decision.latency = boost::chrono::duration_cast<Clock::duration>(boost::chrono::duration<double>(current));
+			decision.baseline_latency = boost::chrono::duration_cast<Clock::duration>(boost::chrono::duration<double>(baseline));
+			decision.queue_wait = waited == 0 ? Clock::duration::zero() : Clock::duration(wait_sum / Clock::rep(waited));
+			decision.waited = waited;
+			decision.gradient = gradient;
+			decision.reason = gradient < 1 ? "latency above baseline" : used ? "latency at baseline, pool in use" : "pool underused";
+
+			recent.push_back(decision);
+			if(recent.size() > 32) {
+				recent.pop_front();
+			}
+			reset(now);
+			return decision;
+		}
+
+		//! The last decisions, oldest first.
+		std::deque<PoolSizeDecision> recent_decisions() {
+			boost::mutex::scoped_lock lock(mutex);
+			return recent;
+		}
+
+	private:
+		boost::mutex mutex;
+		AdaptivePoolPolicy policy;
+		double limit;
+		//! Long-term mean latency, in seconds.
+		double baseline;
+
+		// this interval
+		Clock::time_point interval_start;
+		Clock::duration latency_sum;
+		size_t samples;
+		size_t max_in_flight;
+		Clock::duration wait_sum;
+		size_t waited;
+
+		std::deque<PoolSizeDecision> recent;
+
+		void reset(Clock::time_point const now) {
+			interval_start = now;
+			latency_sum = wait_sum = Clock::duration::zero();
+			samples = max_in_flight = waited = 0;
+		}
+	};
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <string>
+
+#include <boost/chrono.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "mysql/mysql.hpp"
+
+namespace rusql {
+	//! Thrown instead of waiting for a pooled connection when the wait queue is full or the wait took too long.
+	struct PoolOverloaded : mysql::SQLError { PoolOverloaded(std::string const msg) : mysql::SQLError(msg) {} };
+	//! Thrown without contacting the server while the circuit breaker is open.
+	struct CircuitOpen : mysql::SQLError { CircuitOpen(std::string const msg) : mysql::SQLError(msg) {} };
+
+	//! Which wait queue a request for a pooled connection joins. Interactive requests are always served before
+	//! batch requests.
+	enum class Priority {
+		Interactive,
+		Batch,
+	};
+
+	//! The priority of this thread's requests to the pool; Interactive unless a PriorityScope says otherwise.
+	inline Priority& current_priority() {
+		static thread_local Priority priority = Priority::Interactive;
+		return priority;
+	}
+
+	//! Sets this thread's priority for as long as it lives, e.g. around a batch job.
+	struct PriorityScope {
+		PriorityScope(Priority const priority)
+		: previous(current_priority())
+		{
+			current_priority() = priority;
+		}
+
+		~PriorityScope() {
+			current_priority() = previous;
+		}
+
+		PriorityScope(PriorityScope const&) = delete;
+		PriorityScope& operator=(PriorityScope const&) = delete;
+
+	private:
+		Priority const previous;
+	};
+
+	//! Limits on a Database's pool. The default is the unlimited pool: every request that finds no free connection
+	//! opens a new one.
+	struct AdmissionPolicy {
+		typedef boost::chrono::steady_clock Clock;
+
+		AdmissionPolicy()
+		: max_connections(0)
+		, max_interactive_queue(64)
+		, max_batch_queue(64)
+		, max_wait(boost::chrono::seconds(1))
+		{}
+
+		//! Requests wait when this many connections are busy; 0 for no limit.
+		size_t max_connections;
+		//! Requests that find this many others waiting with the same priority fail at once with PoolOverloaded.
+		size_t max_interactive_queue;
+		size_t max_batch_queue;
+		//! Requests that waited this long fail with PoolOverloaded.
+		Clock::duration max_wait;
+	};
+
+	//! When the circuit breaker opens. It judges the requests of the last window; once open, it fails requests
+	//! for open_for, then lets a single request through to decide whether to close again.
+	struct CircuitBreakerPolicy {
+		typedef boost::chrono::steady_clock Clock;
+
+		CircuitBreakerPolicy()
+		: enabled(false)
+		, minimum_requests(20)
+		, max_error_rate(0.5)
+		, latency_slo(Clock::duration::zero())
+		, max_slow_rate(0.5)
+		, window(boost::chrono::seconds(10))
+		, open_for(boost::chrono::seconds(5))
+		{}
+
+		bool enabled;
+		//! The breaker doesn't open on fewer requests than this in a window.
+		size_t minimum_requests;
+		//! Opens when more than this fraction of the requests failed.
+		double max_error_rate;
+		//! Requests slower than this count as slow; zero to ignore latency.
+		Clock::duration latency_slo;
+		//! Opens when more than this fraction of the requests was slow.
+		double max_slow_rate;
+		Clock::duration window;
+		Clock::duration open_for;
+	};
+
+	struct CircuitBreaker {
+		typedef boost::chrono::steady_clock Clock;
+
+		enum class State {
+			Closed,
+			Open,
+			HalfOpen,
+		};
+
+		CircuitBreaker()
+		: state(State::Closed)
+		, probing(false)
+		, requests(0)
+		, errors(0)
+		, slow(0)
+		{}
+
+		void set_policy(CircuitBreakerPolicy const& policy_) {
+			boost::mutex::scoped_lock lock(mutex);
+			policy = policy_;
+			close(Clock::now());
+		}
+
+		State get_state() {
+			boost::mutex::scoped_lock lock(mutex);
+			return state;
+		}
+
+		//! Throws CircuitOpen if the request may not go through right now.
+		void admit() {
+			boost::mutex::scoped_lock lock(mutex);
+			if(!policy.enabled || state == State::Closed) {
+				return;
+			}
+			auto const now = Clock::now();
+			if(state == State::Open && now >= reopen) {
+				state = State::HalfOpen;
+			}
+			if(state == State::HalfOpen && !probing) {
+				probing = true;
+				return;
+			}
+			throw CircuitOpen("Circuit breaker is open; not sending the request to the server");
+		}
+
+		void record(bool const failed, Clock::duration const latency) {
+			boost::mutex::scoped_lock lock(mutex);
+			if(!policy.enabled) {
+				return;
+			}
+			auto const now = Clock::now();
+			bool const too_slow = policy.latency_slo != Clock::duration::zero() && latency > policy.latency_slo;
+
+			if(state == State::HalfOpen) {
+				if(failed || too_slow) {
+					open(now);
+				} else {
+					close(now);
+				}
+				return;
+			}
+			if(state == State::Open) {
+				// admitted before it opened
+				return;
+			}
+
+			if(now - window_start >= policy.window) {
+				window_start = now;
+				requests = errors = slow = 0;
+			}
+			++requests;
+			errors += failed;
+			slow += too_slow;
+			if(requests >= policy.minimum_requests && (errors > policy.max_error_rate * double(requests) || slow > policy.max_slow_rate * double(requests))) {
+				open(now);
+			}
+		}
+
+		//! For an admitted request that ended before it reached the server: neither a success nor a failure.
+		void abandon() {
+			boost::mutex::scoped_lock lock(mutex);
+			if(state == State::HalfOpen) {
+				probing = false;
+			}
+		}
+
+	private:
+		boost::mutex mutex;
+		CircuitBreakerPolicy policy;
+		State state;
+		bool probing;
+		Clock::time_point reopen;
+
+		Clock::time_point window_start;
+		size_t requests, errors, slow;
+
+		void open(Clock::time_point const now) {
+			state = State::Open;
+			probing = false;
+			reopen = now + policy.open_for;
+		}
+
+		void close(Clock::time_point const now) {
+			state = State::Closed;
+			probing = false;
+			window_start = now;
+			requests = errors = slow = 0;
+		}
+	};
+}
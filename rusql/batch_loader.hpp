@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <future>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "database.hpp"
+
+namespace rusql {
+	//! Turns many single-key lookups from any number of threads into one SELECT ... WHERE key IN (...).
+	//!
+	//! Construct it with a query whose key condition is written as IN (?), e.g.
+	//! "SELECT id, name FROM users WHERE id IN (?)", and the name of the result column holding the key.
+	//! Keys passed to load() within one batch window (starting at the first key of a batch) are deduplicated and
+	//! looked up together, on a dedicated connection. Every caller gets the rows for its own key, or an empty
+	//! vector if there were none.
+	//!
+	//! The IN list is padded to a power of two (repeating a key), so only a handful of statements are prepared
+	//! and cached, one per arity bucket.
+	template <typename Key>
+	struct BatchLoader : boost::noncopyable {
+		typedef std::vector<Row> Rows;
+
+		BatchLoader(std::shared_ptr<Database> database_, std::string const query_template, std::string const key_column_, size_t const max_batch_ = 256, boost::chrono::microseconds const window_ = boost::chrono::milliseconds(1))
+		: database(database_)
+		, key_column(key_column_)
+		, max_batch(max_batch_)
+		, window(window_)
+		, stopping(false)
+		{
+			size_t const placeholder = query_template.find("(?)");
+			if(placeholder == std::string::npos || query_template.find("(?)", placeholder + 1) != std::string::npos) {
+				throw std::runtime_error("BatchLoader: query must contain exactly one IN (?): " + query_template);
+			}
+			if(max_batch == 0 || max_batch > 65535) {
+				throw std::runtime_error("BatchLoader: max_batch must be between 1 and 65535");
+			}
+			prefix = query_template.substr(0, placeholder);
+			suffix = query_template.substr(placeholder + 3);
+			dispatcher = boost::thread([this]() { run(); });
+		}
+
+		//! Looks up everything that was requested, then stops.
+		~BatchLoader() {
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				stopping = true;
+			}
+			changed.notify_all();
+			dispatcher.join();
+		}
+
+		//! Requests the rows for one key. The future completes when the batch it ended up in has been looked up.
+		std::future<Rows> load(Key const& key) {
+			std::promise<Rows> promise;
+			auto future = promise.get_future();
+			bool notify;
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				if(pending.empty()) {
+					oldest = boost::chrono::steady_clock::now();
+				}
+				pending[key].emplace_back(std::move(promise));
+				// the dispatcher only needs to know when a batch starts and when it is full
+				notify = pending.size() == 1 || pending.size() >= max_batch;
+			}
+			if(notify) {
+				changed.notify_all();
+			}
+			return future;
+		}
+
+	private:
+		typedef std::map<Key, std::vector<std::promise<Rows>>> Pending;
+		//! Prepared statements by arity of their IN list, all on the dispatcher's connection.
+		typedef std::map<size_t, std::unique_ptr<PreparedStatement>> Statements;
+
+		std::weak_ptr<Database> database;
+		std::string const key_column;
+		size_t const max_batch;
+		boost::chrono::microseconds const window;
+
+		// The query, split around its "(?)"
+		std::string prefix;
+		std::string suffix;
+
+		Pending pending;
+		boost::chrono::steady_clock::time_point oldest;
+		boost::mutex mutex;
+		boost::condition_variable changed;
+		bool stopping;
+
+		boost::thread dispatcher;
+
+		size_t bucket_for(size_t const number_of_keys) const {
+			size_t bucket = 1;
+			while(bucket < number_of_keys) {
+				bucket *= 2;
+			}
+			return std::min(bucket, max_batch);
+		}
+
+		PreparedStatement& statement_for(Statements& statements, Connection& connection, size_t const arity) {
+			auto &statement = statements[arity];
+			if(!statement) {
+				std::string q = prefix + "(";
+				for(size_t i = 0; i < arity; ++i) {
+					q += i == 0 ? "?" : ", ?";
+				}
+				statement.reset(new PreparedStatement(connection.prepare(q + ")" + suffix)));
+			}
+			return *statement;
+		}
+
+		void look_up(Statements& statements, Connection& connection, Pending& batch) {
+			std::vector<Key> keys;
+			keys.reserve(bucket_for(batch.size()));
+			for(auto const &p : batch) {
+				keys.push_back(p.first);
+			}
+			keys.resize(bucket_for(keys.size()), keys.front());
+
+			PreparedStatement &statement = statement_for(statements, connection, keys.size());
+			statement.bind_parameters(keys).execute();
+			MaterializedResult result = materialize(statement);
+
+			std::map<Key, Rows> found;
+			if(!result.rows.empty()) {
+				size_t const key_index = result.rows.front().get_index(key_column);
+				for(auto &row : result.rows) {
+					found[row.template get<Key>(key_index)].push_back(row);
+				}
+			}
+
+			for(auto &p : batch) {
+				Rows const &rows = found[p.first];
+				for(auto &promise : p.second) {
+					promise.set_value(rows);
+				}
+			}
+		}
+
+		void run() {
+			ThreadHandle handle;
+			std::unique_ptr<Connection> connection;
+			// declared after the connection, so they are closed before it
+			Statements statements;
+
+			while(true) {
+				Pending batch;
+				{
+					boost::mutex::scoped_lock lock(mutex);
+					while(pending.empty() && !stopping) {
+						changed.wait(lock);
+					}
+					if(pending.empty()) {
+						return;
+					}
+
+					auto const deadline = oldest + window;
+					while(pending.size() < max_batch && !stopping) {
+						if(changed.wait_until(lock, deadline) == boost::cv_status::timeout) {
+							break;
+						}
+					}
+
+					// take the first max_batch distinct keys, the rest starts the next batch
+					auto end = pending.begin();
+					for(size_t i = 0; i < max_batch && end != pending.end(); ++i) {
+						++end;
+					}
+					batch.insert(std::make_move_iterator(pending.begin()), std::make_move_iterator(end));
+					pending.erase(pending.begin(), end);
+					oldest = boost::chrono::steady_clock::now();
+				}
+
+				try {
+					if(!connection) {
+						connection.reset(new Connection(database));
+					}
+					look_up(statements, *connection, batch);
+				} catch(...) {
+					auto const error = std::current_exception();
+					statements.clear();
+					connection.reset();
+					for(auto &p : batch) {
+						for(auto &promise : p.second) {
+							try {
+								promise.set_exception(error);
+							} catch(std::future_error&) {
+								// this key's value was already delivered before the error
+							}
+						}
+					}
+				}
+			}
+		}
+	};
+}
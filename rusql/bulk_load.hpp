@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mysql/mysql.hpp"
+#include "quote.hpp"
+
+namespace rusql {
+	//! Collects rows for Database::bulk_load(), formatted through type_traits<T>::text.
+	struct BulkWriter {
+		BulkWriter()
+		: rows(0)
+		{}
+
+		//! Appends one row; pass one value per column given to bulk_load().
+		template <typename... T>
+		void row(T const&... cells) {
+			append(cells...);
+			buffer += '\n';
+			++rows;
+		}
+
+		std::string buffer;
+		//! Number of rows written so far.
+		unsigned long long rows;
+
+	private:
+		void append() {
+		}
+
+		template <typename T, typename... Tail>
+		void append(T const& cell, Tail const&... tail) {
+			rusql::mysql::type_traits<T>::text::append(buffer, cell);
+			if(sizeof...(Tail) != 0) {
+				buffer += '\t';
+			}
+			append(tail...);
+		}
+	};
+
+	//! Called whenever the server wants more data. Write any number of rows, then return whether there are more to
+	//! come; returning false ends the load after the rows written in that call.
+	typedef std::function<bool(BulkWriter&)> BulkSource;
+
+	inline std::string bulk_load_query(std::string const& table, std::vector<std::string> const& columns) {
+		std::string q = "LOAD DATA LOCAL INFILE 'rusql' INTO TABLE " + quote_identifier(table) + " (";
+		for(size_t i = 0; i < columns.size(); ++i) {
+			q += (i == 0 ? "" : ", ") + quote_identifier(columns[i]);
+		}
+		return q + ")";
+	}
+
+	//! Adapts a BulkSource to the byte-oriented reader of a LOCAL INFILE, asking for more rows only when all
+	//! earlier ones have been sent.
+	inline rusql::mysql::LocalInfile::Reader bulk_reader(BulkSource source) {
+		auto writer = std::make_shared<BulkWriter>();
+		auto sent = std::make_shared<size_t>(0);
+		auto more = std::make_shared<bool>(true);
+		return [source, writer, sent, more](char* buffer, size_t length) -> size_t {
+			while(*sent == writer->buffer.size() && *more) {
+				writer->buffer.clear();
+				*sent = 0;
+				*more = source(*writer);
+			}
+			size_t const n = std::min(length, writer->buffer.size() - *sent);
+			std::copy(writer->buffer.begin() + *sent, writer->buffer.begin() + *sent + n, buffer);
+			*sent += n;
+			return n;
+		};
+	}
+
+	//! Passes a stream that is already in LOAD DATA's default format (tab-separated, backslash escapes,
+	//! \N for NULL, one row per line) through unchanged.
+	inline rusql::mysql::LocalInfile::Reader bulk_reader(std::istream& input) {
+		return [&input](char* buffer, size_t length) -> size_t {
+			input.read(buffer, std::streamsize(length));
+			if(input.bad()) {
+				throw std::runtime_error("bulk_load: reading the input stream failed");
+			}
+			return size_t(input.gcount());
+		};
+	}
+}
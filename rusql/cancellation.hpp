@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "mysql/mysql.hpp"
+
+namespace rusql {
+	//! Thrown when a statement was stopped by its Deadline or CancellationToken, or not started because it was
+	//! already too late. A statement that was stopped may or may not have taken effect.
+	struct QueryInterrupted : mysql::SQLError { QueryInterrupted(std::string const msg) : mysql::SQLError(msg) {} };
+	struct DeadlineExceeded : QueryInterrupted { DeadlineExceeded(std::string const msg) : QueryInterrupted(msg) {} };
+	struct QueryCancelled : QueryInterrupted { QueryCancelled(std::string const msg) : QueryInterrupted(msg) {} };
+
+	//! A point in time after which a statement should be stopped.
+	struct Deadline {
+		typedef boost::chrono::steady_clock Clock;
+
+		Deadline(Clock::time_point const when_)
+		: when(when_)
+		, never(false)
+		{}
+
+		static Deadline after(Clock::duration const timeout) {
+			return Deadline(Clock::now() + timeout);
+		}
+
+		static Deadline none() {
+			Deadline d((Clock::time_point()));
+			d.never = true;
+			return d;
+		}
+
+		bool is_never() const {
+			return never;
+		}
+
+		bool expired(Clock::time_point const now = Clock::now()) const {
+			return !never && now >= when;
+		}
+
+		Clock::time_point get_time() const {
+			return when;
+		}
+
+	private:
+		Clock::time_point when;
+		bool never;
+	};
+
+	//! Lets one thread stop statements that another thread is running. Copies share their state: cancelling one
+	//! cancels them all. Cancelling can't be undone.
+	struct CancellationToken {
+		typedef std::function<void()> Callback;
+
+		CancellationToken()
+		: state(std::make_shared<State>())
+		{}
+
+		void cancel() {
+			std::vector<Callback> callbacks;
+			{
+				boost::mutex::scoped_lock lock(state->mutex);
+				if(state->cancelled) {
+					return;
+				}
+				state->cancelled = true;
+				for(auto const &entry : state->callbacks) {
+					callbacks.push_back(entry.second);
+				}
+				state->callbacks.clear();
+			}
+			for(auto const &callback : callbacks) {
+				callback();
+			}
+		}
+
+		bool is_cancelled() const {
+			return state->cancelled;
+		}
+
+		//! Calls f once on cancel(), on the cancelling thread; or right now if the token was already cancelled.
+		//! Returns an id for forget().
+		size_t on_cancel(Callback f) {
+			{
+				boost::mutex::scoped_lock lock(state->mutex);
+				if(!state->cancelled) {
+					size_t const id = state->next_id++;
+					state->callbacks[id] = f;
+					return id;
+				}
+			}
+			f();
+			return 0;
+		}
+
+		//! Unregisters a callback. It may still be running on another thread when this returns.
+		void forget(size_t const id) {
+			boost::mutex::scoped_lock lock(state->mutex);
+			state->callbacks.erase(id);
+		}
+
+	private:
+		struct State {
+			State()
+			: cancelled(false)
+			, next_id(1)
+			{}
+
+			boost::mutex mutex;
+			std::atomic<bool> cancelled;
+			size_t next_id;
+			std::map<size_t, Callback> callbacks;
+		};
+
+		std::shared_ptr<State> state;
+	};
+
+	//! When a statement should be stopped: at a deadline, on cancellation, or whichever comes first.
+	struct Interruption {
+		Interruption(Deadline const deadline_)
+		: deadline(deadline_)
+		{}
+
+		Interruption(CancellationToken const token_)
+		: deadline(Deadline::none())
+		, token(token_)
+		{}
+
+		Interruption(Deadline const deadline_, CancellationToken const token_)
+		: deadline(deadline_)
+		, token(token_)
+		{}
+
+		Deadline deadline;
+		boost::optional<CancellationToken> token;
+
+		//! Throws the matching QueryInterrupted if the statement shouldn't start anymore.
+		void check(std::string const& q) const {
+			if(token && token->is_cancelled()) {
+				throw QueryCancelled("Cancelled before running: " + q);
+			}
+			if(deadline.expired()) {
+				throw DeadlineExceeded("Deadline passed before running: " + q);
+			}
+		}
+	};
+}
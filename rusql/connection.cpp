@@ -1,8 +1,14 @@
 #include "rusql.hpp"
 
+#include <set>
+
 namespace rusql {
 	Connection::Connection(std::weak_ptr< Database > database_)
 	: database(database_)
+	, statement_cache_hits(0)
+	, statement_cache_misses(0)
+	, reconnects(0)
+	, connected(false)
 	{
 		connect();
 	}
@@ -10,7 +16,29 @@ namespace rusql {
 	//! Connects with the database, disconnects the previous connection, if there was one.
 	void Connection::connect(){
 		typedef Database::ConstructionInfo::ConstructionInfoType CIType;
+		// statements don't survive the connection they were prepared on
+		statement_cache.clear();
 		std::shared_ptr<Database> db = database.lock();
+		if(!db) {
+			throw mysql::SQLError(__FUNCTION__, "the Database this connection belongs to no longer exists");
+		}
+
+		connection.observers = db->observers;
+		if(connected) {
+			reconnects.fetch_add(1, std::memory_order_relaxed);
+		}
+		connected = true;
+
+		// a last resort against a server that stopped answering; per statement limits are Interruptions
+		if(db->info.connect_timeout != 0) {
+			connection.options(MYSQL_OPT_CONNECT_TIMEOUT, &db->info.connect_timeout);
+		}
+		if(db->info.read_timeout != 0) {
+			connection.options(MYSQL_OPT_READ_TIMEOUT, &db->info.read_timeout);
+		}
+		if(db->info.write_timeout != 0) {
+			connection.options(MYSQL_OPT_WRITE_TIMEOUT, &db->info.write_timeout);
+		}
 
 		switch(db->info.type) {
 		case CIType::TCP:
@@ -41,5 +69,178 @@ namespace rusql {
 		default:
 			assert(!"Unreachable code");
 		}
+
+		session = SessionState();
+		session.schema = db->info.database;
+		session.charset = to_lower(connection.character_set_name());
+		for(auto const &q : db->info.init_commands) {
+			query(q);
+		}
+		// whatever the init commands did is where the session starts
+		session.unknown = false;
+		baseline = session;
+	}
+
+	void Connection::follow_session(SessionStatement const& statement) {
+		if(statement.kind == SessionStatement::None) {
+			return;
+		}
+
+		auto const changes = connection.session_track();
+		if(changes.schema) {
+			session.schema = *changes.schema;
+		}
+		std::set<std::string> tracked;
+		for(auto const &variable : changes.variables) {
+			std::string const name = to_lower(variable.first);
+			tracked.insert(name);
+			// SET NAMES shows up as these three
+			if(name == "character_set_client") {
+				session.charset = to_lower(variable.second);
+			} else if(name != "character_set_connection" && name != "character_set_results") {
+				session.variables[name] = variable.second;
+			}
+		}
+
+		if(statement.kind == SessionStatement::Use && changes.empty()) {
+			session.schema = statement.schema;
+		}
+		for(auto const &name : statement.variables) {
+			if(tracked.count(name) == 0) {
+				// a variable the server doesn't track, or a server that doesn't track at all
+				session.unknown = true;
+			}
+		}
+	}
+
+	void Connection::reset_session() {
+		// its rows would be in the way; the next Database::acquire() tries again
+		if(!is_session_dirty() || !result.expired()) {
+			return;
+		}
+		restore_or_reconnect();
+	}
+
+	void Connection::release_session(Token const* const releasing) {
+		if(!pinned.expired() || !is_session_dirty()) {
+			return;
+		}
+		auto const current = result.lock();
+		if(releasing ? current.get() != releasing : bool(current)) {
+			return;
+		}
+		try {
+			restore_or_reconnect();
+		} catch(std::exception&) {
+			// acquire() tries again, and drops the connection if it still fails
+		}
+	}
+
+	void Connection::restore_or_reconnect() {
+		try {
+			restore_session();
+		} catch(mysql::SQLError&) {
+			// Partly restored perhaps, or the client library can't reset a connection (before 5.7.3). A new
+			// connection starts clean; if there is none to be had, this throws.
+			session.unknown = true;
+			connect();
+		}
+	}
+
+	void Connection::restore_session() {
+		if(session.unknown) {
+			std::shared_ptr<Database> db = database.lock();
+			if(!db) {
+				throw mysql::SQLError(__FUNCTION__, "the Database this connection belongs to no longer exists");
+			}
+			connection.reset_connection();
+			// the server deallocated them
+			statement_cache.clear();
+			if(!baseline.schema.empty()) {
+				connection.select_db(baseline.schema);
+			}
+			connection.set_character_set(baseline.charset);
+			for(auto const &q : db->info.init_commands) {
+				query(q);
+			}
+			session = baseline;
+			return;
+		}
+
+		// Only the text of the old values is known, and bound as strings integer variables would refuse them
+		std::string q;
+		for(auto const &variable : session.variables) {
+			auto const old = baseline.variables.find(variable.first);
+			if(old == baseline.variables.end()) {
+				q += (q.empty() ? "SET SESSION " : ", ") + variable.first + " = DEFAULT";
+			} else if(old->second != variable.second) {
+				q += (q.empty() ? "SET SESSION " : ", ") + variable.first + " = " + session_literal(old->second);
+			}
+		}
+		if(!q.empty()) {
+			connection.query(q);
+		}
+
+		if(session.schema != baseline.schema) {
+			if(baseline.schema.empty()) {
+				baseline.schema = session.schema;
+			} else {
+				connection.select_db(baseline.schema);
+			}
+		}
+		if(session.charset != baseline.charset) {
+			connection.set_character_set(baseline.charset);
+		}
+		session = baseline;
+	}
+
+	void Connection::interruptible(Interruption const& interruption, std::string const& what, std::function<void()> const& run, std::function<void()> const& discard) {
+		interruption.check(what);
+		if(interruption.deadline.is_never() && !interruption.token) {
+			run();
+			return;
+		}
+
+		std::shared_ptr<Database> db = database.lock();
+		if(!db) {
+			throw mysql::SQLError(__FUNCTION__, "the Database this connection belongs to no longer exists");
+		}
+
+		Watchdog::Guard guard(db->get_watchdog(), connection.thread_id(), interruption);
+		try {
+			run();
+		} catch(mysql::SQLError&) {
+			if(!guard.killed()) {
+				throw;
+			}
+		}
+		if(guard.killed()) {
+			// Statements like SLEEP() return early rather than fail, and the statement may have finished just
+			// before the KILL arrived. Either way, this was not the result asked for.
+			discard();
+			if(guard.cancelled()) {
+				throw QueryCancelled("Cancelled while running: " + what);
+			}
+			throw DeadlineExceeded("Deadline passed while running: " + what);
+		}
+	}
+
+	PreparedStatement::~PreparedStatement() {
+		if(!token || !connection) {
+			return;
+		}
+		// closed first, so the session can be reset over the connection
+		if(!is_closed()) {
+			statement.close();
+		}
+		connection->release_session(token.get());
+	}
+
+	PreparedStatement&& PreparedStatement::execute(Interruption const& interruption) {
+		if(!connection) {
+			throw mysql::SQLError(__FUNCTION__, "this statement was not prepared through a Connection, so it can't be interrupted");
+		}
+		connection->interruptible(interruption, "prepared statement", [this]() { statement.execute(); }, [this]() { statement.free_result(); });
+		return std::move(*this);
 	}
 }
@@ -1,16 +1,31 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "mysql/mysql.hpp"
 
+#include "bulk_load.hpp"
+#include "cancellation.hpp"
 #include "resultset.hpp"
 #include "prepared_statement.hpp"
+#include "session_state.hpp"
 
 namespace rusql {
 	struct Database;
 
+	//! Counts of one Connection; see Connection::get_counters().
+	struct ConnectionCounters {
+		uint64_t statement_cache_hits;
+		uint64_t statement_cache_misses;
+		uint64_t reconnects;
+	};
+
 	struct Connection {
 		Connection (std::weak_ptr<Database> database);
 
@@ -25,9 +40,20 @@ namespace rusql {
 			return connection.ping() == 0;
 		}
 
-		//! Returns whether or not the connection is free to do an additional query i.e. there is not a resultset dependent on this connection anymore.
+		//! Returns whether or not the connection is free to do an additional query i.e. there is not a resultset dependent on this connection anymore, and nobody pinned it.
+		//! Call with the Database's lock held. A pinned connection runs statements without that lock, which write
+		//! result, so pinned, which only changes under the lock, is looked at first.
 		bool is_free() {
-			return result.expired();
+			return pinned.expired() && result.expired();
+		}
+
+		//! Keeps the connection from being handed out by the Database for as long as the returned token lives,
+		//! e.g. for the duration of a transaction.
+		std::shared_ptr<Token> pin() {
+			auto token = std::make_shared<Token>();
+			pinned = token;
+			token->released = released;
+			return token;
 		}
 		
 		ResultSet use_result(){
@@ -40,12 +66,23 @@ namespace rusql {
 		ResultSet select_query (std::string const q) {
 			connection.query(q);
 			ResultSet set = use_result();
-			result = set.get_token();
+			track(set.get_token());
+			return set;
+		}
+
+		//! Like select_query(), but stops the query when the deadline passes or the token is cancelled, and throws
+		//! a QueryInterrupted. Covers running the query, not fetching its rows afterwards.
+		ResultSet select_query (Interruption const& interruption, std::string const q) {
+			interruptible(interruption, q, [this, &q]() { connection.query(q); }, [this]() { discard_result(); });
+			ResultSet set = use_result();
+			track(set.get_token());
 			return set;
 		}
 
 		void query (std::string const q) {
+			auto const statement = SessionStatement::classify(q);
 			connection.query(q);
+			follow_session(statement);
 			if(connection.field_count() != 0) {
 				// MySQL does not allow a SELECT query whose
 				// results are not all fetched. Bring the
@@ -61,12 +98,39 @@ namespace rusql {
 			}
 		}
 
+		void query (Interruption const& interruption, std::string const q) {
+			auto const statement = SessionStatement::classify(q);
+			interruptible(interruption, q, [this, &q]() { connection.query(q); }, [this]() { discard_result(); });
+			follow_session(statement);
+			if(connection.field_count() != 0) {
+				discard_result();
+				throw mysql::SQLError("query() called but connection has fields to return; use select_query()");
+			}
+		}
+
 		PreparedStatement prepare (std::string const q) {
-			auto p = PreparedStatement(rusql::mysql::Statement(connection, q));
-			result = p.get_token();
+			// whatever it sets is only known once it ran, and that happens out of sight
+			if(SessionStatement::classify(q).kind != SessionStatement::None) {
+				session.unknown = true;
+			}
+			auto p = PreparedStatement(rusql::mysql::Statement(connection, q), this);
+			track(p.get_token());
 			return p;
 		}
 		
+		//! Returns this connection's prepared statement for q, preparing it the first time. Cached statements
+		//! live as long as the connection and don't mark it as in use; only hand them out while it is pinned.
+		PreparedStatement& cached_statement(std::string const q) {
+			auto &statement = statement_cache[q];
+			if(!statement) {
+				statement.reset(new PreparedStatement(rusql::mysql::Statement(connection, q), this));
+				statement_cache_misses.fetch_add(1, std::memory_order_relaxed);
+			} else {
+				statement_cache_hits.fetch_add(1, std::memory_order_relaxed);
+			}
+			return *statement;
+		}
+
 		template <typename ... T>
 		PreparedStatement execute(std::string const q, T const& ... args) {
 			return prepare(q).bind_parameters(args ...).execute();
@@ -77,6 +141,18 @@ namespace rusql {
 			return prepare(q).bind_parameters(args).execute();
 		}
 
+		template <typename ... T>
+		PreparedStatement execute(Interruption const& interruption, std::string const q, T const& ... args) {
+			return prepare(q).bind_parameters(args ...).execute(interruption);
+		}
+
+		//! Streams the reader's data into table with LOAD DATA LOCAL INFILE. Returns the number of rows loaded.
+		unsigned long long bulk_load(std::string const& table, std::vector<std::string> const& columns, mysql::LocalInfile::Reader reader) {
+			mysql::LocalInfile infile(reader);
+			connection.load_local_infile(bulk_load_query(table, columns), infile);
+			return connection.affected_rows();
+		}
+
 		void ping(){
 			connection.ping();
 		}
@@ -85,13 +161,131 @@ namespace rusql {
 			return connection.insert_id();
 		}
 
+		//! The server's id for this connection, e.g. for KILL QUERY. Changes on reconnect.
+		unsigned long thread_id() {
+			return connection.thread_id();
+		}
+
+		//! Sets a session system variable, unless it is known to have that value already because it was set
+		//! through this function or a SET statement the server reported. Prefer this over running SET yourself.
+		template <typename T>
+		void set_session_variable(std::string const& name, T const& value) {
+			std::string const key = to_lower(check_variable_name(name));
+			std::string const text = session_text(value);
+			auto const it = session.variables.find(key);
+			if(!session.unknown && it != session.variables.end() && it->second == text) {
+				return;
+			}
+			PreparedStatement(rusql::mysql::Statement(connection, "SET SESSION " + key + " = ?"), this).bind_parameters(value).execute();
+			session.variables[key] = text;
+		}
+
+		//! Makes schema the default database, unless it already is.
+		void use_database(std::string const& schema) {
+			if(!session.unknown && session.schema == schema) {
+				return;
+			}
+			connection.select_db(schema);
+			session.schema = schema;
+		}
+
+		//! Like SET NAMES, unless the connection already uses charset.
+		void set_names(std::string const& charset) {
+			std::string const name = to_lower(charset);
+			if(!session.unknown && session.charset == name) {
+				return;
+			}
+			connection.set_character_set(name);
+			session.charset = name;
+		}
+
+		SessionState const& get_session_state() const {
+			return session;
+		}
+
+		//! Whether the session differs from how connect() left it, as far as this connection knows.
+		bool is_session_dirty() const {
+			return session != baseline;
+		}
+
+		//! Puts the session back how connect() left it, if it is dirty: changed variables are set back to their
+		//! old values, or to DEFAULT when those aren't known, followed by the default database and the character
+		//! set. When it isn't known what changed, the whole session is reset, which also drops user variables,
+		//! temporary tables and cached statements, and init_commands run again. Without a default database in
+		//! the ConstructionInfo a USE can't be undone, so it is kept. Does nothing while a ResultSet or
+		//! PreparedStatement of this connection is around. If the session can't be restored, the connection
+		//! reconnects, and throws only when that fails too.
+		void reset_session();
+
+		//! Resets a session left dirty by statements run outside a lease, as the connection goes back to the pool:
+		//! after Database::query(), or when the PreparedStatement whose token is releasing goes away. Does nothing
+		//! while the connection is pinned or still in use otherwise. Never throws; a session that can't be reset
+		//! is left for the next Database::acquire().
+		void release_session(Token const* const releasing = nullptr);
+
+		//! What this connection counted, for the Database's PoolMetrics; may be called from any thread.
+		ConnectionCounters get_counters() const {
+			ConnectionCounters counters;
+			counters.statement_cache_hits = statement_cache_hits.load(std::memory_order_relaxed);
+			counters.statement_cache_misses = statement_cache_misses.load(std::memory_order_relaxed);
+			counters.reconnects = reconnects.load(std::memory_order_relaxed);
+			return counters;
+		}
+
+		//! Notified whenever a ResultSet, PreparedStatement or pin of this connection goes away; see Token.
+		void set_release_signal(std::weak_ptr<boost::condition_variable> const& signal) {
+			released = signal;
+		}
+
+		//! Calls run(), which sends one statement over this connection, while the Database's Watchdog kills the
+		//! statement when the deadline passes or the token is cancelled. Throws QueryInterrupted if it was killed;
+		//! if run() completed anyway, discard() is called first to drop the result, so the connection stays usable.
+		//! what describes the statement in error messages.
+		void interruptible(Interruption const& interruption, std::string const& what, std::function<void()> const& run, std::function<void()> const& discard);
+
 	private:
 		//! Connects with the database, disconnects the previous connection, if there was one.
 		void connect();
 
+		void track(std::weak_ptr<Token> const& token) {
+			result = token;
+			if(!released.expired()) {
+				token.lock()->released = released;
+			}
+		}
+
+		void restore_session();
+
+		//! restore_session(), or a new connection when that fails.
+		void restore_or_reconnect();
+
+		//! Takes note of what a plain text statement changed in the session, after it ran.
+		void follow_session(SessionStatement const& statement);
+
+		//! Reads and drops the rows of the last query, if it had any.
+		void discard_result() {
+			if(connection.field_count() != 0) {
+				ResultSet set(connection);
+			}
+		}
+
 		std::weak_ptr<Database> database;
 		std::weak_ptr<Token> result;
+		std::weak_ptr<Token> pinned;
+		std::weak_ptr<boost::condition_variable> released;
 		
+		//! The session now, and right after connect().
+		SessionState session;
+		SessionState baseline;
+
+		std::atomic<uint64_t> statement_cache_hits;
+		std::atomic<uint64_t> statement_cache_misses;
+		//! Calls of connect() after the first.
+		std::atomic<uint64_t> reconnects;
+		bool connected;
+
 		rusql::mysql::Connection connection;
+		// After the connection, so the statements are closed first
+		std::map<std::string, std::unique_ptr<PreparedStatement>> statement_cache;
 	};
 }
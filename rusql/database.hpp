@@ -1,22 +1,34 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
 #include <string>
+#include <vector>
+#include <boost/chrono.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
+#include "adaptive_pool.hpp"
+#include "admission.hpp"
 #include "connection.hpp"
+#include "executor.hpp"
+#include "histogram.hpp"
+#include "lease.hpp"
+#include "lock_profile.hpp"
+#include "materialized_result.hpp"
+#include "pool_metrics.hpp"
+#include "thread_handle.hpp"
+#include "transaction.hpp"
+#include "watchdog.hpp"
+#include "workload.hpp"
 
 namespace rusql {
-	struct ThreadHandle {
-		ThreadHandle() {
-			rusql::mysql::thread_init();
-		}
-		ThreadHandle(ThreadHandle&&) = default;
-		~ThreadHandle() {
-			rusql::mysql::thread_end();
-		}
-	};
-
 	struct Database : std::enable_shared_from_this<Database> {
 		struct ConstructionInfo {
 			enum class ConstructionInfoType {
@@ -34,6 +46,11 @@ namespace rusql {
 			std::string user, password;
 			// always optional:
 			std::string database;
+			//! In seconds, 0 for the client library's default. MySQL retries reads and writes, so the read and
+			//! write timeouts may take a multiple of this to trigger. A connection that timed out is reconnected.
+			unsigned int connect_timeout, read_timeout, write_timeout;
+			//! Run on every connection right after it connected, e.g. SET time_zone = '+00:00'.
+			std::vector<std::string> init_commands;
 
 			ConstructionInfo (const std::string &host_, uint16_t port_, const std::string &user_, const std::string &password_, const std::string &database_ = std::string())
 				: type (ConstructionInfoType::TCP)
@@ -42,6 +59,9 @@ namespace rusql {
 				, user (user_)
 				, password (password_)
 				, database (database_)
+				, connect_timeout (0)
+				, read_timeout (0)
+				, write_timeout (0)
 			{}
 
 			ConstructionInfo (const std::string &unix_path_, const std::string &user_, const std::string &password_, const std::string &database_ = std::string())
@@ -50,19 +70,36 @@ namespace rusql {
 				, user (user_)
 				, password (password_)
 				, database (database_)
+				, connect_timeout (0)
+				, read_timeout (0)
+				, write_timeout (0)
 			{}
 
 			ConstructionInfo (const std::string &database_ = std::string())
 				: type (ConstructionInfoType::Embedded)
 				, database (database_)
+				, connect_timeout (0)
+				, read_timeout (0)
+				, write_timeout (0)
 			{}
 		};
 
 		Database (ConstructionInfo const& rh)
-		: info (rh) {
+		: info (rh)
+		, observers (std::make_shared<mysql::ObserverSlot>())
+		, connection_released (std::make_shared<boost::condition_variable>())
+		, next_ticket (0)
+		, rejected (0)
+		, connections_created (0)
+		, connections_closed (0)
+		, retired_counters ()
+		, checkout_wait_ns (0)
+		, in_flight (0)
+		, async_workers (std::max(1u, boost::thread::hardware_concurrency())) {
 		}
 
 		int number_of_active_connections() const {
+			ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Inspect);
 			int num = 0;
 			for(auto const &c : connections) {
 				if(!c->is_free()) num++;
@@ -71,59 +108,672 @@ namespace rusql {
 		}
 
 		ResultSet select_query(std::string const q) {
-			boost::mutex::scoped_lock lock(connections_mutex);
-			return get_connection().select_query(q);
+			return measured([&]() {
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::SelectQuery);
+				return get_connection(lock).select_query(q);
+			});
 		}
 
 		void query(std::string const q){
-			boost::mutex::scoped_lock lock(connections_mutex);
-			return get_connection().query(q);
+			measured([&]() {
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Query);
+				Connection &connection = get_connection(lock);
+				connection.query(q);
+				connection.release_session();
+			});
 		}
 
 		PreparedStatement prepare(std::string const q){
-			boost::mutex::scoped_lock lock(connections_mutex);
-			return get_connection().prepare(q);
+			return measured([&]() {
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Prepare);
+				return get_connection(lock).prepare(q);
+			});
+		}
+
+		//! Like select_query(), but the query is killed when the deadline passes or the token is cancelled,
+		//! throwing a QueryInterrupted. The connection stays in the pool.
+		ResultSet select_query(Interruption const& interruption, std::string const q) {
+			return measured([&]() {
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::SelectQuery);
+				return get_connection(lock).select_query(interruption, q);
+			});
+		}
+
+		void query(Interruption const& interruption, std::string const q) {
+			measured([&]() {
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Query);
+				Connection &connection = get_connection(lock);
+				connection.query(interruption, q);
+				connection.release_session();
+			});
+		}
+
+		//! Reserves a connection for a sequence of statements; see Lease. The session starts as connect() left it.
+		//! The pool is locked only here, not for the statements run through the lease. Waits like any other
+		//! request when the pool is at its limit, but is not subject to the circuit breaker.
+		Lease acquire() {
+			std::shared_ptr<Connection> connection;
+			std::shared_ptr<Token> pin;
+			{
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Acquire);
+				connection = get_free_connection(lock);
+				pin = connection->pin();
+			}
+			// left dirty by statements run outside a lease, or by a lease that couldn't reset it
+			try {
+				connection->reset_session();
+			} catch(mysql::SQLError&) {
+				// not even a new connection could be had; don't hand this one out again
+				pin.reset();
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Acquire);
+				close_connection(connection);
+				throw;
+			}
+			return Lease(connection, pin);
+		}
+
+		//! Starts a transaction on a connection that stays reserved for it until it is committed, rolled back or
+		//! destroyed.
+		Transaction begin() {
+			return acquire().begin();
 		}
 
 		template <typename ... T>
 		PreparedStatement execute(std::string const q, T const& ... args) {
-			PreparedStatement s = prepare(q);
-			return s.execute(args ...);
+			return measured([&]() -> PreparedStatement {
+				PreparedStatement s = prepare_pooled(q);
+				return s.execute(args ...);
+			});
 		}
 
 		template <typename T>
 		PreparedStatement execute(std::string const q, std::vector<T> const &args) {
-			PreparedStatement s = prepare(q);
-			return s.execute(args);
+			return measured([&]() -> PreparedStatement {
+				PreparedStatement s = prepare_pooled(q);
+				return s.execute(args);
+			});
+		}
+
+		template <typename ... T>
+		PreparedStatement execute(Interruption const& interruption, std::string const q, T const& ... args) {
+			interruption.check(q);
+			return measured([&]() -> PreparedStatement {
+				PreparedStatement s = prepare_pooled(q);
+				return s.bind_parameters(args ...).execute(interruption);
+			});
 		}
 		
 		void ping(){
-			boost::mutex::scoped_lock lock(connections_mutex);
-			get_connection().ping();
+			measured([&]() {
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Ping);
+				get_connection(lock).ping();
+			});
+		}
+
+		//! Opens connections until the pool has n of them (or as many as its limit allows), all in parallel on
+		//! threads of their own, so startup pays for one connection handshake instead of n in a row. Each also
+		//! prepares the hot statements. The limit is checked again once they're connected: those the pool no
+		//! longer has room for, because other requests opened connections meanwhile, are closed. Returns the
+		//! number of connections in the pool; if any connection failed, the others are still added and the first
+		//! error is thrown.
+		size_t warm_up(size_t n) {
+			std::vector<std::string> statements;
+			size_t missing = 0;
+			{
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::WarmUp);
+				size_t const limit = pool_limit();
+				if(limit != 0) {
+					n = std::min(n, limit);
+				}
+				missing = n > connections.size() ? n - connections.size() : 0;
+				statements = hot_statements;
+			}
+
+			std::vector<std::shared_ptr<Connection>> fresh(missing);
+			std::vector<std::exception_ptr> errors(missing);
+			std::vector<std::shared_ptr<boost::thread>> threads;
+			std::weak_ptr<Database> self = shared_from_this();
+			for(size_t i = 0; i < missing; ++i) {
+				threads.emplace_back(std::make_shared<boost::thread>([self, i, &statements, &fresh, &errors]() {
+					ThreadHandle handle;
+					try {
+						auto connection = std::make_shared<Connection>(self);
+						for(auto const &q : statements) {
+							connection->cached_statement(q);
+						}
+						fresh[i] = connection;
+					} catch(...) {
+						errors[i] = std::current_exception();
+					}
+				}));
+			}
+			for(auto &thread : threads) {
+				thread->join();
+			}
+
+			size_t size;
+			std::vector<std::shared_ptr<Connection>> surplus;
+			{
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::WarmUp);
+				// other requests may have grown the pool, or the limit may have changed, while these connected
+				size_t const limit = pool_limit();
+				size_t const target = limit != 0 ? std::min(n, limit) : n;
+				for(auto &connection : fresh) {
+					if(!connection) {
+						continue;
+					}
+					if(connections.size() < target) {
+						add_connection(connection);
+					} else {
+						surplus.push_back(connection);
+					}
+				}
+				size = connections.size();
+			}
+			connection_released->notify_all();
+			// closed without the lock
+			surplus.clear();
+
+			for(auto const &error : errors) {
+				if(error) {
+					std::rethrow_exception(error);
+				}
+			}
+			return size;
+		}
+
+		//! Statements that every new connection prepares right away, so a Lease's prepare_cached() and
+		//! execute_cached() find them ready. Applies to connections opened from now on.
+		void set_hot_statements(std::vector<std::string> const& statements) {
+			ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Configure);
+			hot_statements = statements;
+		}
+
+		//! Limits the pool; see AdmissionPolicy. Requests that are already waiting keep their place.
+		void set_admission_policy(AdmissionPolicy const& policy) {
+			{
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Configure);
+				admission = policy;
+			}
+			connection_released->notify_all();
+		}
+
+		//! Lets the pool size follow the load between the policy's bounds, overriding
+		//! AdmissionPolicy::max_connections while enabled; see GradientController. Connections beyond the size are
+		//! closed once they're free.
+		void set_adaptive_pool(AdaptivePoolPolicy const& policy) {
+			pool_controller.set_policy(policy);
+			connection_released->notify_all();
+		}
+
+		//! Reports every stage of every statement on this Database's connections to observer, from now on,
+		//! including the wait for a pooled connection; nullptr to stop. See QueryObserver.
+		void set_query_observer(std::shared_ptr<mysql::QueryObserver> const& observer) {
+			boost::mutex::scoped_lock lock(observer_mutex);
+			query_observer = observer;
+			install_observers();
+		}
+
+		//! Records every statement from now on to a file at path, for rusql_replay; see WorkloadRecorder. Ends
+		//! an earlier recording. Works next to the observer of set_query_observer().
+		std::shared_ptr<WorkloadRecorder> start_recording(std::string const& path, WorkloadRecorder::Options const& options = WorkloadRecorder::Options()) {
+			auto recorder = std::make_shared<WorkloadRecorder>(path, options);
+			std::shared_ptr<WorkloadRecorder> earlier;
+			{
+				boost::mutex::scoped_lock lock(observer_mutex);
+				earlier = workload_recorder;
+				workload_recorder = recorder;
+				install_observers();
+			}
+			if(earlier) {
+				earlier->close();
+			}
+			return recorder;
+		}
+
+		//! Ends the recording of start_recording(), if any, and closes its file.
+		void stop_recording() {
+			std::shared_ptr<WorkloadRecorder> recorder;
+			{
+				boost::mutex::scoped_lock lock(observer_mutex);
+				recorder = std::move(workload_recorder);
+				workload_recorder.reset();
+				install_observers();
+			}
+			if(recorder) {
+				recorder->close();
+			}
+		}
+
+		//! Called with every decision of the adaptive pool, on the thread whose request completed an interval.
+		void set_pool_size_listener(std::function<void(PoolSizeDecision const&)> const& listener) {
+			boost::mutex::scoped_lock lock(listener_mutex);
+			pool_size_listener = listener;
+		}
+
+		//! The adaptive pool's most recent decisions, oldest first.
+		std::deque<PoolSizeDecision> recent_pool_size_decisions() {
+			return pool_controller.recent_decisions();
+		}
+
+		//! The most connections the pool will open now; 0 for no limit.
+		size_t get_pool_limit() {
+			ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Inspect);
+			return pool_limit();
+		}
+
+		size_t number_of_connections() {
+			ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Inspect);
+			return connections.size();
+		}
+
+		void set_circuit_breaker(CircuitBreakerPolicy const& policy) {
+			breaker.set_policy(policy);
+		}
+
+		CircuitBreaker::State get_circuit_state() {
+			return breaker.get_state();
+		}
+
+		//! A snapshot of the pool, e.g. to export with to_prometheus().
+		PoolMetrics get_pool_metrics() {
+			PoolMetrics metrics;
+			ConnectionCounters counters;
+			{
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Inspect);
+				counters = retired_counters;
+				metrics.connections = connections.size();
+				metrics.idle = 0;
+				for(auto const &c : connections) {
+					if(c->is_free()) {
+						++metrics.idle;
+					}
+					auto const more = c->get_counters();
+					counters.statement_cache_hits += more.statement_cache_hits;
+					counters.statement_cache_misses += more.statement_cache_misses;
+					counters.reconnects += more.reconnects;
+				}
+				metrics.busy = metrics.connections - metrics.idle;
+				metrics.limit = pool_limit();
+				metrics.waiting_interactive = waiting[size_t(Priority::Interactive)].size();
+				metrics.waiting_batch = waiting[size_t(Priority::Batch)].size();
+				metrics.rejected = rejected;
+				metrics.connections_created = connections_created;
+				metrics.connections_closed = connections_closed;
+			}
+			metrics.in_flight = in_flight.load();
+			metrics.reconnects = counters.reconnects;
+			metrics.statement_cache_hits = counters.statement_cache_hits;
+			metrics.statement_cache_misses = counters.statement_cache_misses;
+
+			metrics.checkouts = checkout_wait.count();
+			metrics.checkout_wait_total = boost::chrono::duration_cast<PoolMetrics::Clock::duration>(boost::chrono::nanoseconds(checkout_wait_ns.load()));
+			// a histogram bucket ends right below every power of two, so these counts are exact
+			for(uint64_t us = 128; us <= (uint64_t(1) << 24); us <<= 1) {
+				auto const bound = boost::chrono::duration_cast<PoolMetrics::Clock::duration>(boost::chrono::microseconds(us));
+				metrics.checkout_wait_buckets.push_back(std::make_pair(bound, checkout_wait.count_at_most(us - 1)));
+			}
+
+			metrics.circuit_state = breaker.get_state();
+			auto const decisions = pool_controller.recent_decisions();
+			if(!decisions.empty()) {
+				metrics.last_pool_size_decision = decisions.back();
+			}
+			return metrics;
+		}
+
+		//! Starts or stops timing, for every operation that locks the pool, how long it waited for the lock and
+		//! how long it held it. Off by default; see LockProfiler.
+		void set_lock_profiling(bool const enabled) {
+			lock_profiler.set_enabled(enabled);
+		}
+
+		//! The lock times counted while profiling was on, per operation; see write_lock_profile().
+		std::vector<LockSiteProfile> get_lock_profile() const {
+			return lock_profiler.profile();
+		}
+
+		void clear_lock_profile() {
+			lock_profiler.clear();
+		}
+
+		//! Number of requests now waiting for a pooled connection with the given priority.
+		size_t number_of_waiting(Priority const priority) {
+			ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Inspect);
+			return waiting[size_t(priority)].size();
+		}
+
+		//! Number of requests that failed with PoolOverloaded so far.
+		unsigned long long number_of_rejected() {
+			ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Inspect);
+			return rejected;
+		}
+
+		//! Inserts the rows written by source into the given columns of table, using LOAD DATA LOCAL INFILE: the
+		//! fastest way to insert many rows. Cells are formatted and escaped through type_traits, no temporary files
+		//! are involved. The load runs on a connection of its own, so the pool stays available while it runs.
+		//! Returns the number of rows loaded.
+		unsigned long long bulk_load(std::string const& table, std::vector<std::string> const& columns, BulkSource source) {
+			Connection connection(shared_from_this());
+			return connection.bulk_load(table, columns, bulk_reader(source));
+		}
+
+		//! Like bulk_load() above, for data that already is in LOAD DATA's default format (e.g. read from a file).
+		unsigned long long bulk_load(std::string const& table, std::vector<std::string> const& columns, std::istream& input) {
+			Connection connection(shared_from_this());
+			return connection.bulk_load(table, columns, bulk_reader(input));
 		}
 
 		ThreadHandle get_thread_handle() {
 			return ThreadHandle();
 		}
 
+		//! Runs the statement on one of the Database's worker threads and returns immediately. The future
+		//! holds all result rows (or the insert id) once the statement is done, or the exception it threw.
+		//! Independent statements submitted together run in parallel, each on the worker's own connection.
+		template <typename ... T>
+		std::future<MaterializedResult> async_execute(std::string const q, T const& ... args) {
+			return get_executor().submit([q, args ...](Connection& connection) {
+				PreparedStatement statement = connection.execute(q, args ...);
+				return materialize(statement);
+			});
+		}
+
+		//! Runs f(Connection&) on one of the worker threads of async_execute(); see Executor::submit().
+		template <typename F>
+		std::future<typename std::result_of<F(Connection&)>::type> submit(F f) {
+			return get_executor().submit(f);
+		}
+
+		//! Sets the number of worker threads used by async_execute(). Only has effect before its first call;
+		//! the default is the number of hardware threads.
+		void set_async_workers(size_t const workers) {
+			ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Configure);
+			async_workers = std::max<size_t>(1, workers);
+		}
+
 	private:
 		friend struct Connection;
 		ConstructionInfo const info;
+		//! Shared with every connection.
+		std::shared_ptr<mysql::ObserverSlot> const observers;
+		//! Where the Acquire stage finds its observer. Guarded by connections_mutex.
+		mysql::CachedObserver acquire_observer;
+		//! What's installed in observers, from set_query_observer() and start_recording().
+		boost::mutex observer_mutex;
+		std::shared_ptr<mysql::QueryObserver> query_observer;
+		std::shared_ptr<WorkloadRecorder> workload_recorder;
 
 		std::vector<std::shared_ptr<Connection>> connections;
-		boost::mutex connections_mutex;
+		//! Mutable, so const observers like number_of_active_connections() can take it too.
+		mutable boost::mutex connections_mutex;
+		mutable LockProfiler lock_profiler;
+		std::vector<std::string> hot_statements;
+		//! Notified by the Tokens of pooled connections, so waiting requests can look for a free one.
+		std::shared_ptr<boost::condition_variable> connection_released;
+
+		AdmissionPolicy admission;
+		//! Tickets of the waiting requests per Priority, in order of arrival.
+		std::deque<uint64_t> waiting[2];
+		uint64_t next_ticket;
+		unsigned long long rejected;
+		uint64_t connections_created;
+		uint64_t connections_closed;
+		//! Counts of the connections that were closed.
+		ConnectionCounters retired_counters;
+		//! Time taken by get_free_connection().
+		LatencyHistogram checkout_wait;
+		std::atomic<int64_t> checkout_wait_ns;
+
+		CircuitBreaker breaker;
+
+		GradientController pool_controller;
+		//! Requests inside measured()
+		std::atomic<size_t> in_flight;
+		boost::mutex listener_mutex;
+		std::function<void(PoolSizeDecision const&)> pool_size_listener;
+
+		//! Times f, which sends a request to the server, and reports the outcome to the circuit breaker and the
+		//! adaptive pool.
+		template <typename F>
+		auto measured(F f) -> decltype(f()) {
+			breaker.admit();
+			Measurement measurement(*this);
+			try {
+				return f();
+			} catch(PoolOverloaded&) {
+				measurement.outcome = Measurement::Abandoned;
+				throw;
+			} catch(mysql::SQLError&) {
+				measurement.outcome = Measurement::Failed;
+				throw;
+			} catch(...) {
+				measurement.outcome = Measurement::Abandoned;
+				throw;
+			}
+		}
+
+		struct Measurement {
+			enum Outcome { Succeeded, Failed, Abandoned };
+
+			Measurement(Database& database_)
+			: database(database_)
+			, start(CircuitBreaker::Clock::now())
+			, concurrency(++database.in_flight)
+			, outcome(Succeeded)
+			{}
+
+			~Measurement() {
+				--database.in_flight;
+				if(outcome == Abandoned) {
+					database.breaker.abandon();
+					return;
+				}
+				auto const now = CircuitBreaker::Clock::now();
+				database.breaker.record(outcome == Failed, now - start);
+				database.pool_controller.record(now - start, concurrency);
+				if(auto decision = database.pool_controller.update(now)) {
+					database.resize_pool(*decision);
+				}
+			}
+
+			Database& database;
+			CircuitBreaker::Clock::time_point const start;
+			size_t const concurrency;
+			Outcome outcome;
+		};
+
+		//! Applies a decision of the adaptive pool: closes free connections beyond the new size, or wakes waiting
+		//! requests that may now open one.
+		void resize_pool(PoolSizeDecision const& decision) {
+			{
+				ProfiledLock lock(connections_mutex, lock_profiler, LockSite::ResizePool);
+				for(size_t i = connections.size(); i > 0 && connections.size() > decision.new_limit; --i) {
+					if(connections[i - 1]->is_free()) {
+						close_connection(connections[i - 1]);
+					}
+				}
+			}
+			connection_released->notify_all();
+
+			std::function<void(PoolSizeDecision const&)> listener;
+			{
+				boost::mutex::scoped_lock lock(listener_mutex);
+				listener = pool_size_listener;
+			}
+			if(listener) {
+				listener(decision);
+			}
+		}
+
+		//! Takes connection out of the pool, keeping its counters. Call with connections_mutex held.
+		void close_connection(std::shared_ptr<Connection> const connection) {
+			auto const it = std::find(connections.begin(), connections.end(), connection);
+			if(it == connections.end()) {
+				return;
+			}
+			auto const counters = connection->get_counters();
+			retired_counters.statement_cache_hits += counters.statement_cache_hits;
+			retired_counters.statement_cache_misses += counters.statement_cache_misses;
+			retired_counters.reconnects += counters.reconnects;
+			++connections_closed;
+			connections.erase(it);
+		}
 
-		Connection& get_connection() {
+		//! Installs query_observer and workload_recorder, both or either. Call with observer_mutex held.
+		void install_observers() {
+			if(query_observer && workload_recorder) {
+				observers->set(std::make_shared<mysql::ObserverPair>(query_observer, workload_recorder));
+			} else if(workload_recorder) {
+				observers->set(workload_recorder);
+			} else {
+				observers->set(query_observer);
+			}
+		}
+
+		//! The most connections the pool may have; 0 for no limit. Call with connections_mutex held.
+		size_t pool_limit() {
+			return pool_controller.is_enabled() ? pool_controller.get_limit() : admission.max_connections;
+		}
+
+		PreparedStatement prepare_pooled(std::string const q) {
+			ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Execute);
+			return get_connection(lock).prepare(q);
+		}
+
+		Connection& get_connection(ProfiledLock& lock) {
+			return *get_free_connection(lock);
+		}
+
+		//! A free connection, or a new one if the pool may grow. Otherwise waits in the queue of this thread's
+		//! Priority, releasing the lock, until a connection is free and all requests before it were served.
+		std::shared_ptr<Connection> get_free_connection(ProfiledLock& lock) {
+			auto const start = LatencyHistogram::Clock::now();
+			std::shared_ptr<Connection> connection;
+			std::shared_ptr<mysql::QueryObserver> const observer = acquire_observer.get(*observers);
+			if(observer == nullptr) {
+				connection = wait_for_free_connection(lock);
+			} else {
+				static std::string const no_sql;
+				mysql::ObservedStage stage(*observer, mysql::QueryStage::Acquire, no_sql, 0);
+				connection = wait_for_free_connection(lock);
+				stage.set_connection_id(connection->thread_id());
+				stage.finish();
+			}
+			auto const wait = LatencyHistogram::Clock::now() - start;
+			checkout_wait.record(wait);
+			checkout_wait_ns += boost::chrono::duration_cast<boost::chrono::nanoseconds>(wait).count();
+			return connection;
+		}
+
+		std::shared_ptr<Connection> wait_for_free_connection(ProfiledLock& lock) {
+			size_t const limit = pool_limit();
+			if(limit == 0) {
+				return find_or_create_connection(limit);
+			}
+
+			size_t const priority = size_t(current_priority());
+			auto &queue = waiting[priority];
+			auto const my_turn = [&]() {
+				return waiting[size_t(Priority::Interactive)].empty() || priority == size_t(Priority::Interactive);
+			};
+			if(queue.empty() && my_turn()) {
+				if(auto c = find_or_create_connection(pool_limit())) {
+					return c;
+				}
+			}
+
+			size_t const max_queue = priority == size_t(Priority::Interactive) ? admission.max_interactive_queue : admission.max_batch_queue;
+			if(queue.size() >= max_queue) {
+				++rejected;
+				throw PoolOverloaded("All " + std::to_string(limit) + " connections are busy and the wait queue is full");
+			}
+
+			typedef AdmissionPolicy::Clock Clock;
+			auto const wait_start = Clock::now();
+			auto const give_up = wait_start + admission.max_wait;
+			uint64_t const ticket = next_ticket++;
+			queue.push_back(ticket);
+			// Leaves the queue however this ends, and lets the next request check whether it's its turn
+			struct Leave {
+				~Leave() {
+					queue.erase(std::find(queue.begin(), queue.end(), ticket));
+					signal.notify_all();
+					controller.record_wait(Clock::now() - start);
+				}
+				std::deque<uint64_t> &queue;
+				uint64_t const ticket;
+				boost::condition_variable &signal;
+				GradientController &controller;
+				Clock::time_point const start;
+			} leave{queue, ticket, *connection_released, pool_controller, wait_start};
+
+			while(true) {
+				if(queue.front() == ticket && my_turn()) {
+					if(auto c = find_or_create_connection(pool_limit())) {
+						return c;
+					}
+				}
+				auto const now = Clock::now();
+				if(now >= give_up) {
+					++rejected;
+					throw PoolOverloaded("Waited too long for one of " + std::to_string(pool_limit()) + " busy connections");
+				}
+				// Tokens are released without holding the lock, so a notification can come just before we wait;
+				// don't rely on it
+				lock.wait_until(*connection_released, std::min(give_up, now + boost::chrono::milliseconds(5)));
+			}
+		}
+
+		//! A free connection, or a new one if the pool is below limit (0 for none), or nullptr.
+		std::shared_ptr<Connection> find_or_create_connection(size_t const limit) {
 			for (auto & c : connections) {
-				if (c->is_free()) return *c;
+				if (c->is_free()) return c;
 			}
 
+			if(limit != 0 && connections.size() >= limit) {
+				return nullptr;
+			}
 			return create_connection();
 		}
 
-		Connection& create_connection() {
-			connections.emplace_back (std::make_shared<Connection> (shared_from_this()));
-			return *connections.back();
+		std::shared_ptr<Connection> create_connection() {
+			auto connection = std::make_shared<Connection> (shared_from_this());
+			for(auto const &q : hot_statements) {
+				connection->cached_statement(q);
+			}
+			add_connection(connection);
+			return connection;
+		}
+
+		void add_connection(std::shared_ptr<Connection> const& connection) {
+			++connections_created;
+			connection->set_release_signal(connection_released);
+			connections.emplace_back(connection);
 		}
+
+		Executor& get_executor() {
+			ProfiledLock lock(connections_mutex, lock_profiler, LockSite::Executor);
+			if(!executor) {
+				executor.reset(new Executor(shared_from_this(), async_workers));
+			}
+			return *executor;
+		}
+
+		//! Kills statements that run past their Interruption; made on first use.
+		Watchdog& get_watchdog() {
+			boost::mutex::scoped_lock lock(watchdog_mutex);
+			if(!watchdog) {
+				watchdog.reset(new Watchdog(shared_from_this()));
+			}
+			return *watchdog;
+		}
+
+		boost::mutex watchdog_mutex;
+		std::unique_ptr<Watchdog> watchdog;
+
+		size_t async_workers;
+		// Last member: its workers are joined before the rest of the Database goes away.
+		std::unique_ptr<Executor> executor;
 	};
 }
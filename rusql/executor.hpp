@@ -0,0 +1,121 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "connection.hpp"
+#include "thread_handle.hpp"
+
+namespace rusql {
+	struct Database;
+
+	//! A fixed pool of worker threads that run jobs against a Database. Every worker holds its own ThreadHandle
+	//! and its own Connection, which is not part of the Database's pool, so jobs never contend for pooled
+	//! connections. The Connection is made on the first job a worker runs.
+	//!
+	//! A job may end up holding the last reference to the Database, e.g. while connecting, so the Database and
+	//! this Executor can be destroyed on one of its own workers. That worker is then detached rather than
+	//! joined; the queue lives on with it until it stops.
+	struct Executor : boost::noncopyable {
+		typedef std::function<void(std::unique_ptr<Connection>&)> Job;
+
+		Executor(std::weak_ptr<Database> database_, size_t const number_of_workers)
+		: database(database_)
+		, queue(std::make_shared<Queue>())
+		{
+			for(size_t i = 0; i < number_of_workers; ++i) {
+				std::shared_ptr<Queue> const shared = queue;
+				workers.emplace_back(std::make_shared<boost::thread>([shared]() { run(*shared); }));
+			}
+		}
+
+		//! Runs all jobs that were already submitted, then stops the workers.
+		~Executor() {
+			{
+				boost::mutex::scoped_lock lock(queue->mutex);
+				queue->stopping = true;
+			}
+			queue->available.notify_all();
+			for(auto &worker : workers) {
+				if(worker->get_id() == boost::this_thread::get_id()) {
+					worker->detach();
+				} else {
+					worker->join();
+				}
+			}
+		}
+
+		size_t number_of_workers() const {
+			return workers.size();
+		}
+
+		//! Queues f(Connection&) on the next free worker. Its return value, or the exception it threw, is delivered
+		//! through the future.
+		template <typename F>
+		std::future<typename std::result_of<F(Connection&)>::type> submit(F f) {
+			typedef typename std::result_of<F(Connection&)>::type Result;
+			std::weak_ptr<Database> db = database;
+			// connecting happens inside the task, so a failure to connect ends up in the future as well
+			auto task = std::make_shared<std::packaged_task<Result(std::unique_ptr<Connection>&)>>(
+				[db, f](std::unique_ptr<Connection>& connection) {
+					if(!connection) {
+						connection.reset(new Connection(db));
+					}
+					return f(*connection);
+				});
+			auto future = task->get_future();
+			{
+				boost::mutex::scoped_lock lock(queue->mutex);
+				queue->jobs.emplace_back([task](std::unique_ptr<Connection>& connection) { (*task)(connection); });
+			}
+			queue->available.notify_one();
+			return future;
+		}
+
+	private:
+		//! Shared with the workers, so one that outlives the Executor still has it.
+		struct Queue {
+			Queue()
+			: stopping(false)
+			{}
+
+			std::deque<Job> jobs;
+			boost::mutex mutex;
+			boost::condition_variable available;
+			bool stopping;
+		};
+
+		std::weak_ptr<Database> database;
+		std::shared_ptr<Queue> const queue;
+		std::vector<std::shared_ptr<boost::thread>> workers;
+
+		static void run(Queue& queue) {
+			ThreadHandle handle;
+			std::unique_ptr<Connection> connection;
+
+			while(true) {
+				Job job;
+				{
+					boost::mutex::scoped_lock lock(queue.mutex);
+					while(queue.jobs.empty() && !queue.stopping) {
+						queue.available.wait(lock);
+					}
+					if(queue.jobs.empty()) {
+						return;
+					}
+					job = std::move(queue.jobs.front());
+					queue.jobs.pop_front();
+				}
+
+				job(connection);
+			}
+		}
+	};
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace rusql {
+	//! Counts durations in log-linear buckets: every power of two of microseconds is split into sub_buckets equal
+	//! parts, so any percentile is accurate to within 1/sub_buckets of its value. Recording is lock-free and may
+	//! happen from any thread; reads are a snapshot that can be slightly behind concurrent records.
+	struct LatencyHistogram : boost::noncopyable {
+		typedef boost::chrono::steady_clock Clock;
+
+		static size_t const sub_buckets = 8;
+		static size_t const sub_bucket_bits = 3;
+		//! Enough to count any 64-bit number of microseconds.
+		static size_t const number_of_buckets = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+		LatencyHistogram()
+		: total(0)
+		{
+			for(auto &bucket : buckets) {
+				bucket = 0;
+			}
+		}
+
+		void record(Clock::duration const d) {
+			auto const us = boost::chrono::duration_cast<boost::chrono::microseconds>(d).count();
+			record_microseconds(us < 0 ? 0 : uint64_t(us));
+		}
+
+		void record_microseconds(uint64_t const us) {
+			buckets[bucket_for(us)].fetch_add(1, std::memory_order_relaxed);
+			total.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		uint64_t count() const {
+			return total.load(std::memory_order_relaxed);
+		}
+
+		//! The smallest duration that at least the fraction p (0 to 1) of all recorded durations does not exceed,
+		//! rounded up to its bucket. Zero when nothing was recorded.
+		Clock::duration percentile(double const p) const {
+			uint64_t counts[number_of_buckets];
+			uint64_t sum = 0;
+			for(size_t i = 0; i < number_of_buckets; ++i) {
+				counts[i] = buckets[i].load(std::memory_order_relaxed);
+				sum += counts[i];
+			}
+			if(sum == 0) {
+				return Clock::duration::zero();
+			}
+
+			uint64_t const wanted = p <= 0 ? 1 : p >= 1 ? sum : uint64_t(p * double(sum) + 0.999999);
+			uint64_t seen = 0;
+			size_t i = 0;
+			for(; i < number_of_buckets - 1; ++i) {
+				seen += counts[i];
+				if(seen >= wanted) {
+					break;
+				}
+			}
+			return boost::chrono::duration_cast<Clock::duration>(boost::chrono::microseconds(bucket_upper_bound(i)));
+		}
+
+		//! How many recorded durations fall in buckets that end at or below us.
+		uint64_t count_at_most(uint64_t const us) const {
+			uint64_t sum = 0;
+			for(size_t i = 0; i < number_of_buckets && bucket_upper_bound(i) <= us; ++i) {
+				sum += buckets[i].load(std::memory_order_relaxed);
+			}
+			return sum;
+		}
+
+		//! Halves every count, so older samples weigh less than newer ones.
+		void decay() {
+			for(auto &bucket : buckets) {
+				uint64_t old = bucket.load(std::memory_order_relaxed);
+				while(!bucket.compare_exchange_weak(old, old / 2, std::memory_order_relaxed)) {}
+				total.fetch_sub(old - old / 2, std::memory_order_relaxed);
+			}
+		}
+
+		void clear() {
+			for(auto &bucket : buckets) {
+				total.fetch_sub(bucket.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+		}
+
+		static size_t bucket_for(uint64_t const us) {
+			if(us < sub_buckets) {
+				return size_t(us);
+			}
+			size_t highest_bit = 0;
+			for(uint64_t x = us; x > 1; x >>= 1) {
+				++highest_bit;
+			}
+			size_t const shift = highest_bit - sub_bucket_bits;
+			return (shift + 1) * sub_buckets + size_t(us >> shift) - sub_buckets;
+		}
+
+		//! The largest number of microseconds that falls in the bucket.
+		static uint64_t bucket_upper_bound(size_t const bucket) {
+			if(bucket < sub_buckets) {
+				return bucket;
+			}
+			size_t const shift = bucket / sub_buckets - 1;
+			uint64_t const mantissa = bucket % sub_buckets + sub_buckets;
+			return ((mantissa + 1) << shift) - 1;
+		}
+
+	private:
+		std::atomic<uint64_t> buckets[number_of_buckets];
+		std::atomic<uint64_t> total;
+	};
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <future>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "database.hpp"
+
+namespace rusql {
+	//! Collects single-row INSERTs from many threads and writes them as one multi-row INSERT.
+	//!
+	//! Construct it with an INSERT template that has one row of placeholders, e.g.
+	//! "INSERT INTO events VALUES (?, ?, ?)" with Columns = <int, int, std::string>. Every insert() is buffered;
+	//! the buffer is written on a dedicated connection as soon as it holds max_rows rows, or max_delay after the
+	//! oldest buffered row arrived, whichever comes first. The future of every row in a batch completes when the
+	//! batch is written, or carries the exception if writing it failed.
+	//!
+	//! Columns are copied into the buffer, so use owning types (std::string rather than char const*).
+	template <typename... Columns>
+	struct InsertCoalescer : boost::noncopyable {
+		typedef std::tuple<Columns...> Row;
+
+		InsertCoalescer(std::shared_ptr<Database> database_, std::string const insert_template, size_t const max_rows_ = 128, boost::chrono::microseconds const max_delay_ = boost::chrono::milliseconds(2))
+		: database(database_)
+		, max_rows(max_rows_)
+		, max_delay(max_delay_)
+		, stopping(false)
+		, flush_requested(false)
+		{
+			split_template(insert_template);
+			if(max_rows == 0 || max_rows * sizeof...(Columns) > 65535) {
+				throw std::runtime_error("InsertCoalescer: max_rows must be at least 1 and max_rows * columns may not exceed 65535 placeholders");
+			}
+			flusher = boost::thread([this]() { run(); });
+		}
+
+		//! Writes everything that is still buffered, then stops.
+		~InsertCoalescer() {
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				stopping = true;
+			}
+			changed.notify_all();
+			flusher.join();
+		}
+
+		//! Buffers one row. The future completes once the row is written.
+		std::future<void> insert(Columns const&... values) {
+			std::promise<void> promise;
+			auto future = promise.get_future();
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				if(rows.empty()) {
+					oldest = boost::chrono::steady_clock::now();
+				}
+				rows.emplace_back(values...);
+				promises.emplace_back(std::move(promise));
+				// the flusher only needs to know when a batch starts (to set its timer) and when it is full
+				if(rows.size() != 1 && rows.size() < max_rows) {
+					return future;
+				}
+			}
+			changed.notify_all();
+			return future;
+		}
+
+		//! Writes the current buffer without waiting for it to fill up or time out. Does nothing when it is empty, so
+		//! the next row still waits for a batch.
+		void flush() {
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				if(rows.empty()) {
+					return;
+				}
+				flush_requested = true;
+			}
+			changed.notify_all();
+		}
+
+	private:
+		std::weak_ptr<Database> database;
+		size_t const max_rows;
+		boost::chrono::microseconds const max_delay;
+
+		// The template, split around its row of placeholders: prefix + "(?, ?)" + suffix
+		std::string prefix;
+		std::string row_placeholders;
+		std::string suffix;
+
+		std::vector<Row> rows;
+		std::vector<std::promise<void>> promises;
+		boost::chrono::steady_clock::time_point oldest;
+		boost::mutex mutex;
+		boost::condition_variable changed;
+		bool stopping;
+		bool flush_requested;
+
+		boost::thread flusher;
+
+		//! Prepared multi-row statements by number of rows, all on the flusher's connection.
+		typedef std::map<size_t, std::unique_ptr<PreparedStatement>> Statements;
+
+		void split_template(std::string const& insert_template) {
+			std::string upper = insert_template;
+			std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return char(std::toupper(c)); });
+
+			size_t const values = upper.find("VALUES");
+			size_t const open = values == std::string::npos ? values : insert_template.find('(', values);
+			size_t const close = open == std::string::npos ? open : insert_template.find(')', open);
+			if(close == std::string::npos) {
+				throw std::runtime_error("InsertCoalescer: template must have the form INSERT ... VALUES (?, ...): " + insert_template);
+			}
+
+			prefix = insert_template.substr(0, open);
+			row_placeholders = insert_template.substr(open, close - open + 1);
+			suffix = insert_template.substr(close + 1);
+
+			if(size_t(std::count(row_placeholders.begin(), row_placeholders.end(), '?')) != sizeof...(Columns)) {
+				throw std::runtime_error("InsertCoalescer: the template's number of placeholders does not match its number of columns: " + insert_template);
+			}
+		}
+
+		std::string query_for(size_t const number_of_rows) const {
+			std::string q = prefix;
+			for(size_t i = 0; i < number_of_rows; ++i) {
+				if(i != 0) {
+					q += ", ";
+				}
+				q += row_placeholders;
+			}
+			return q + suffix;
+		}
+
+		PreparedStatement& statement_for(Statements& statements, Connection& connection, size_t const number_of_rows) {
+			auto &statement = statements[number_of_rows];
+			if(!statement) {
+				statement.reset(new PreparedStatement(connection.prepare(query_for(number_of_rows))));
+			}
+			return *statement;
+		}
+
+		void run() {
+			ThreadHandle handle;
+			std::unique_ptr<Connection> connection;
+			// declared after the connection, so they are closed before it
+			Statements statements;
+
+			while(true) {
+				std::vector<Row> batch;
+				std::vector<std::promise<void>> batch_promises;
+				{
+					boost::mutex::scoped_lock lock(mutex);
+					while(rows.empty() && !stopping) {
+						changed.wait(lock);
+					}
+					if(rows.empty()) {
+						return;
+					}
+
+					auto const deadline = oldest + max_delay;
+					while(rows.size() < max_rows && !stopping && !flush_requested) {
+						if(changed.wait_until(lock, deadline) == boost::cv_status::timeout) {
+							break;
+						}
+					}
+					flush_requested = false;
+
+					size_t const n = std::min(rows.size(), max_rows);
+					batch.assign(std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.begin() + n));
+					rows.erase(rows.begin(), rows.begin() + n);
+					for(size_t i = 0; i < n; ++i) {
+						batch_promises.emplace_back(std::move(promises[i]));
+					}
+					promises.erase(promises.begin(), promises.begin() + n);
+					// the rows left over start a new batch now
+					oldest = boost::chrono::steady_clock::now();
+				}
+
+				try {
+					if(!connection) {
+						connection.reset(new Connection(database));
+					}
+					statement_for(statements, *connection, batch.size()).bind_parameters(batch).execute();
+				} catch(...) {
+					// a broken connection also invalidates its prepared statements
+					statements.clear();
+					connection.reset();
+					for(auto &promise : batch_promises) {
+						promise.set_exception(std::current_exception());
+					}
+					continue;
+				}
+				for(auto &promise : batch_promises) {
+					promise.set_value();
+				}
+			}
+		}
+	};
+}
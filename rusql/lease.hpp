@@ -0,0 +1,170 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "connection.hpp"
+#include "token.hpp"
+#include "transaction.hpp"
+
+namespace rusql {
+	struct LeaseError : mysql::SQLError { LeaseError(std::string const msg) : mysql::SQLError(msg) {} };
+
+	//! Exclusive use of one pooled Connection, from Database::acquire() until release() or destruction.
+	//! Everything run through a lease goes to the same connection without touching the pool again, so session
+	//! state (temporary tables, user variables, SET statements) carries over between statements.
+	//! Move-only.
+	struct Lease {
+		Lease(std::shared_ptr<Connection> connection_, std::shared_ptr<Token> pin_)
+		: connection(connection_)
+		, pin(pin_)
+		{}
+
+		Lease(Lease&& x)
+		: connection(std::move(x.connection))
+		, pin(std::move(x.pin))
+		, used_statements(std::move(x.used_statements))
+		{}
+
+		Lease& operator=(Lease&& x) {
+			release();
+			connection = std::move(x.connection);
+			pin = std::move(x.pin);
+			used_statements = std::move(x.used_statements);
+			return *this;
+		}
+
+		Lease(Lease const&) = delete;
+		Lease& operator=(Lease const&) = delete;
+
+		~Lease() {
+			try {
+				release();
+			} catch(const mysql::SQLError& e) {
+				std::cerr << "Exception when releasing Lease, ignoring: " << e.what() << std::endl;
+			}
+		}
+
+		//! Gives the connection back to the pool. Unfetched rows of cached statements are discarded first, and a
+		//! session changed through the lease is reset, see Connection::reset_session(). ResultSets and
+		//! PreparedStatements obtained through the lease keep the connection busy until they are gone, as they
+		//! always do.
+		void release() {
+			if(!connection) {
+				return;
+			}
+			std::shared_ptr<Connection> c = std::move(connection);
+			std::shared_ptr<Token> released = std::move(pin);
+			std::vector<PreparedStatement*> statements = std::move(used_statements);
+			used_statements.clear();
+			for(auto *statement : statements) {
+				statement->free_result();
+			}
+			// a Transaction may still be using the session
+			if(released.use_count() == 1) {
+				c->reset_session();
+			}
+		}
+
+		bool is_released() const {
+			return !connection;
+		}
+
+		ResultSet select_query(std::string const q) {
+			return get_connection().select_query(q);
+		}
+
+		void query(std::string const q) {
+			get_connection().query(q);
+		}
+
+		PreparedStatement prepare(std::string const q) {
+			return get_connection().prepare(q);
+		}
+
+		template <typename ... T>
+		PreparedStatement execute(std::string const q, T const& ... args) {
+			return get_connection().execute(q, args ...);
+		}
+
+		template <typename T>
+		PreparedStatement execute(std::string const q, std::vector<T> const &args) {
+			return get_connection().execute(q, args);
+		}
+
+		//! The connection's cached statement for q: prepared only the first time any lease of this connection asks
+		//! for it. The reference is valid until the lease is released.
+		PreparedStatement& prepare_cached(std::string const q) {
+			PreparedStatement &statement = get_connection().cached_statement(q);
+			for(auto *used : used_statements) {
+				if(used == &statement) {
+					return statement;
+				}
+			}
+			used_statements.push_back(&statement);
+			return statement;
+		}
+
+		template <typename ... T>
+		PreparedStatement& execute_cached(std::string const q, T const& ... args) {
+			PreparedStatement &statement = prepare_cached(q);
+			statement.bind_parameters(args ...).execute();
+			return statement;
+		}
+
+		//! Starts a transaction on the leased connection. The connection stays pinned until both the transaction
+		//! and the lease are gone.
+		Transaction begin() {
+			return Transaction(connection_ptr(), pin);
+		}
+
+		//! Session changes that are skipped when they wouldn't change anything; see Connection.
+		template <typename T>
+		void set_session_variable(std::string const& name, T const& value) {
+			get_connection().set_session_variable(name, value);
+		}
+
+		void use_database(std::string const& schema) {
+			get_connection().use_database(schema);
+		}
+
+		void set_names(std::string const& charset) {
+			get_connection().set_names(charset);
+		}
+
+		SessionState const& get_session_state() {
+			return get_connection().get_session_state();
+		}
+
+		bool is_session_dirty() {
+			return get_connection().is_session_dirty();
+		}
+
+		unsigned long long insert_id() {
+			return get_connection().insert_id();
+		}
+
+		void ping() {
+			get_connection().ping();
+		}
+
+	private:
+		std::shared_ptr<Connection> connection;
+		std::shared_ptr<Token> pin;
+		//! Cached statements handed out during this lease, their results are discarded on release.
+		std::vector<PreparedStatement*> used_statements;
+
+		std::shared_ptr<Connection> const& connection_ptr() {
+			if(!connection) {
+				throw LeaseError("Lease was already released");
+			}
+			return connection;
+		}
+
+		Connection& get_connection() {
+			return *connection_ptr();
+		}
+	};
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "histogram.hpp"
+
+namespace rusql {
+	//! What a Database was doing while it held the lock of its pool.
+	enum class LockSite {
+		//! select_query(), with or without an Interruption; the lock is held while the statement runs.
+		SelectQuery,
+		//! query(), with or without an Interruption; the lock is held while the statement runs.
+		Query,
+		Prepare,
+		//! Preparing the statement of execute(); the lock is held while it's prepared.
+		Execute,
+		Ping,
+		//! Getting the connection of a Lease.
+		Acquire,
+		WarmUp,
+		//! Closing connections for the adaptive pool.
+		ResizePool,
+		//! Changing settings, such as the admission policy or the hot statements.
+		Configure,
+		//! Reading the pool's state, such as get_pool_metrics().
+		Inspect,
+		//! Making the Executor of async_execute().
+		Executor,
+	};
+
+	static size_t const number_of_lock_sites = size_t(LockSite::Executor) + 1;
+
+	inline char const* lock_site_name(LockSite const site) {
+		switch(site) {
+			case LockSite::SelectQuery: return "select_query";
+			case LockSite::Query: return "query";
+			case LockSite::Prepare: return "prepare";
+			case LockSite::Execute: return "execute";
+			case LockSite::Ping: return "ping";
+			case LockSite::Acquire: return "acquire";
+			case LockSite::WarmUp: return "warm_up";
+			case LockSite::ResizePool: return "resize_pool";
+			case LockSite::Configure: return "configure";
+			case LockSite::Inspect: return "inspect";
+			case LockSite::Executor: return "executor";
+			default: return "unknown";
+		}
+	}
+
+	//! How one LockSite used the lock; see Database::get_lock_profile(). Wait is the time from asking for the
+	//! lock until getting it; hold is the time from getting it until letting go, not counting time spent waiting
+	//! for a free connection, when the lock is released.
+	struct LockSiteProfile {
+		typedef boost::chrono::steady_clock Clock;
+
+		LockSite site;
+		uint64_t acquisitions;
+		//! Acquisitions that found the lock taken and had to wait for it.
+		uint64_t contended;
+		Clock::duration total_wait;
+		Clock::duration p50_wait;
+		Clock::duration p99_wait;
+		Clock::duration max_wait;
+		Clock::duration total_hold;
+		Clock::duration p50_hold;
+		Clock::duration p99_hold;
+		Clock::duration max_hold;
+
+		double contention_rate() const {
+			return acquisitions == 0 ? 0.0 : double(contended) / double(acquisitions);
+		}
+	};
+
+	//! Counts, per LockSite, how long threads waited for and held a lock. Off by default; while off, a
+	//! ProfiledLock pays a single check. Recording is lock-free. Percentiles are rounded up to the
+	//! LatencyHistogram's buckets, with a resolution of a microsecond; totals are exact.
+	struct LockProfiler : boost::noncopyable {
+		typedef LockSiteProfile::Clock Clock;
+
+		LockProfiler()
+		: enabled(false)
+		{}
+
+		void set_enabled(bool const enabled_) {
+			enabled.store(enabled_, std::memory_order_relaxed);
+		}
+
+		bool is_enabled() const {
+			return enabled.load(std::memory_order_relaxed);
+		}
+
+		void record(LockSite const site, bool const contended, Clock::duration const wait, Clock::duration const hold) {
+			auto &s = sites[size_t(site)];
+			s.acquisitions.fetch_add(1, std::memory_order_relaxed);
+			if(contended) {
+				s.contended.fetch_add(1, std::memory_order_relaxed);
+			}
+			s.wait.record(wait);
+			s.hold.record(hold);
+			s.wait_ns.fetch_add(boost::chrono::duration_cast<boost::chrono::nanoseconds>(wait).count(), std::memory_order_relaxed);
+			s.hold_ns.fetch_add(boost::chrono::duration_cast<boost::chrono::nanoseconds>(hold).count(), std::memory_order_relaxed);
+		}
+
+		//! The sites that took the lock at least once, in the order of LockSite.
+		std::vector<LockSiteProfile> profile() const {
+			auto const from_ns = [](int64_t const ns) {
+				return boost::chrono::duration_cast<Clock::duration>(boost::chrono::nanoseconds(ns));
+			};
+			std::vector<LockSiteProfile> result;
+			for(size_t i = 0; i < number_of_lock_sites; ++i) {
+				auto const &s = sites[i];
+				LockSiteProfile p;
+				p.site = LockSite(i);
+				p.acquisitions = s.acquisitions.load(std::memory_order_relaxed);
+				if(p.acquisitions == 0) {
+					continue;
+				}
+				p.contended = s.contended.load(std::memory_order_relaxed);
+				p.total_wait = from_ns(s.wait_ns.load(std::memory_order_relaxed));
+				p.p50_wait = s.wait.percentile(0.5);
+				p.p99_wait = s.wait.percentile(0.99);
+				p.max_wait = s.wait.percentile(1);
+				p.total_hold = from_ns(s.hold_ns.load(std::memory_order_relaxed));
+				p.p50_hold = s.hold.percentile(0.5);
+				p.p99_hold = s.hold.percentile(0.99);
+				p.max_hold = s.hold.percentile(1);
+				result.push_back(p);
+			}
+			return result;
+		}
+
+		//! Forgets everything so far.
+		void clear() {
+			for(auto &s : sites) {
+				s.acquisitions = 0;
+				s.contended = 0;
+				s.wait.clear();
+				s.hold.clear();
+				s.wait_ns = 0;
+				s.hold_ns = 0;
+			}
+		}
+
+	private:
+		struct Site {
+			Site()
+			: acquisitions(0)
+			, contended(0)
+			, wait_ns(0)
+			, hold_ns(0)
+			{}
+
+			std::atomic<uint64_t> acquisitions;
+			std::atomic<uint64_t> contended;
+			LatencyHistogram wait;
+			LatencyHistogram hold;
+			std::atomic<int64_t> wait_ns;
+			std::atomic<int64_t> hold_ns;
+		};
+
+		std::atomic<bool> enabled;
+		Site sites[number_of_lock_sites];
+	};
+
+	//! A scoped_lock that reports its wait and hold time to a LockProfiler, if that was enabled when it was made.
+	struct ProfiledLock : boost::mutex::scoped_lock {
+		typedef LockProfiler::Clock Clock;
+
+		ProfiledLock(boost::mutex& mutex, LockProfiler& profiler_, LockSite const site_)
+		: boost::mutex::scoped_lock(mutex, boost::defer_lock)
+		, profiler(profiler_.is_enabled() ? &profiler_ : nullptr)
+		, site(site_)
+		, contended(false)
+		{
+			if(profiler == nullptr) {
+				lock();
+				return;
+			}
+			auto const start = Clock::now();
+			if(!try_lock()) {
+				contended = true;
+				lock();
+			}
+			acquired = Clock::now();
+			wait = acquired - start;
+			held = Clock::duration::zero();
+		}
+
+		~ProfiledLock() {
+			if(profiler != nullptr && owns_lock()) {
+				profiler->record(site, contended, wait, held + (Clock::now() - acquired));
+			}
+		}
+
+		//! Waits on signal like boost::condition_variable::wait_until(); the lock isn't held meanwhile, so that
+		//! time doesn't count as held.
+		template <typename TimePoint>
+		void wait_until(boost::condition_variable& signal, TimePoint const& until) {
+			if(profiler == nullptr) {
+				signal.wait_until(*this, until);
+				return;
+			}
+			held += Clock::now() - acquired;
+			signal.wait_until(*this, until);
+			acquired = Clock::now();
+		}
+
+	private:
+		LockProfiler* const profiler;
+		LockSite const site;
+		bool contended;
+		Clock::time_point acquired;
+		Clock::duration wait;
+		Clock::duration held;
+	};
+
+	//! Writes profile as a table, one site per line, times in milliseconds.
+	inline void write_lock_profile(std::ostream& os, std::vector<LockSiteProfile> const& profile) {
+		auto const ms = [](LockSiteProfile::Clock::duration const d) {
+			return boost::chrono::duration<double, boost::milli>(d).count();
+		};
+		std::ostringstream out;
+		out << std::fixed << std::setprecision(3);
+		out << "acquisitions\tcontended\twait_ms\tp50_wait_ms\tp99_wait_ms\tmax_wait_ms\thold_ms\tp50_hold_ms\tp99_hold_ms\tmax_hold_ms\tsite\n";
+		for(auto const &p : profile) {
+			out << p.acquisitions << '\t' << p.contended << '\t'
+				<< ms(p.total_wait) << '\t' << ms(p.p50_wait) << '\t' << ms(p.p99_wait) << '\t' << ms(p.max_wait) << '\t'
+				<< ms(p.total_hold) << '\t' << ms(p.p50_hold) << '\t' << ms(p.p99_hold) << '\t' << ms(p.max_hold) << '\t'
+				<< lock_site_name(p.site) << '\n';
+		}
+		os << out.str();
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
+
+#include "mysql/mysql.hpp"
+#include "prepared_statement.hpp"
+
+namespace rusql {
+	//! One fully fetched row, independent of the Connection it came from. Cells are kept in their text form
+	//! (NULL is boost::none) and converted on get(), like the cells of a ResultSet.
+	struct Row {
+		Row(std::shared_ptr<std::vector<std::string> const> columns_, std::vector<boost::optional<std::string>> cells_)
+		: columns(std::move(columns_))
+		, cells(std::move(cells_))
+		{}
+
+		//! Column names, shared by all rows of the same result.
+		std::shared_ptr<std::vector<std::string> const> columns;
+		std::vector<boost::optional<std::string>> cells;
+
+		size_t size() const {
+			return cells.size();
+		}
+
+		size_t get_index(std::string const& column_name) const {
+			for(size_t i = 0; i < columns->size(); ++i) {
+				if((*columns)[i] == column_name) {
+					return i;
+				}
+			}
+			throw mysql::ColumnNotFound("Column '" + column_name + "' not found");
+		}
+
+		bool is_null(size_t const index) const {
+			return !cells.at(index);
+		}
+
+		bool is_null(std::string const& column_name) const {
+			return is_null(get_index(column_name));
+		}
+
+		template <typename T>
+		struct Getter {
+			static T get(boost::optional<std::string> const& cell) {
+				if(!cell) {
+					throw std::runtime_error("Fetching a NULL cell into a non-optional variable");
+				}
+				return boost::lexical_cast<T>(*cell);
+			}
+		};
+
+		template <typename T>
+		struct Getter<boost::optional<T>> {
+			static boost::optional<T> get(boost::optional<std::string> const& cell) {
+				if(!cell) {
+					return boost::none;
+				}
+				return boost::lexical_cast<T>(*cell);
+			}
+		};
+
+		template <typename T>
+		T get(size_t const index) const {
+			return Getter<T>::get(cells.at(index));
+		}
+
+		template <typename T>
+		T get(std::string const& column_name) const {
+			return get<T>(get_index(column_name));
+		}
+	};
+
+	//! The complete outcome of a statement: every result row, or the insert id for statements that return no rows.
+	struct MaterializedResult {
+		MaterializedResult()
+		: columns(std::make_shared<std::vector<std::string>>())
+		, insert_id(0)
+		{}
+
+		std::shared_ptr<std::vector<std::string> const> columns;
+		std::vector<Row> rows;
+		unsigned long long insert_id;
+	};
+
+	//! Fetches all remaining rows of an executed statement. This rebinds the statement's results.
+	inline MaterializedResult materialize(PreparedStatement& statement) {
+		MaterializedResult result;
+		result.insert_id = statement.insert_id();
+
+		size_t const fields = statement.field_count();
+		if(fields == 0) {
+			return result;
+		}
+
+		result.columns = std::make_shared<std::vector<std::string> const>(statement.column_names());
+
+		// every column is fetched as text, MySQL does the conversion
+		std::vector<boost::optional<std::string>> cells(fields);
+		statement.bind_results(cells);
+		while(statement.fetch()) {
+			result.rows.emplace_back(result.columns, cells);
+		}
+		return result;
+	}
+}
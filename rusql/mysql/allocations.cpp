@@ -0,0 +1,19 @@
+#include "allocations.hpp"
+
+#include <atomic>
+
+namespace rusql { namespace mysql {
+	thread_local AllocationCount thread_allocation_count = {0, 0};
+
+	namespace {
+		std::atomic<bool> counting(false);
+	}
+
+	bool is_counting_allocations() {
+		return counting.load(std::memory_order_relaxed);
+	}
+
+	void set_counting_allocations() {
+		counting.store(true, std::memory_order_relaxed);
+	}
+}}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+//! \file allocations.hpp Counts of the heap allocations of every thread, kept by the operator new of the
+//! rusql_count_allocations library. A program that links it gets the allocations of each stage of a statement
+//! in its QueryEvent, and through that in StatementStatistics; other programs pay nothing and read zeros.
+//! Only operator new is counted, not malloc() calls of the MySQL client library.
+
+namespace rusql { namespace mysql {
+	struct AllocationCount {
+		uint64_t allocations;
+		uint64_t bytes;
+	};
+
+	//! The calling thread's count, kept by operator new; only touched by its own thread.
+	extern thread_local AllocationCount thread_allocation_count;
+
+	//! Whether rusql_count_allocations is linked, i.e. whether thread_allocations() counts anything.
+	bool is_counting_allocations();
+
+	//! Called by rusql_count_allocations when the program starts.
+	void set_counting_allocations();
+
+	//! What the calling thread allocated so far.
+	inline AllocationCount thread_allocations() {
+		return thread_allocation_count;
+	}
+
+	//! What the calling thread allocated since the given snapshot of thread_allocations().
+	inline AllocationCount allocations_since(AllocationCount const since) {
+		AllocationCount const now = thread_allocation_count;
+		return AllocationCount{now.allocations - since.allocations, now.bytes - since.bytes};
+	}
+}}
@@ -0,0 +1,241 @@
+#include "backend.hpp"
+
+#include <atomic>
+
+namespace rusql { namespace mysql {
+	namespace {
+		struct ClientLibrary : Backend {
+			int thread_init() override {
+				return mysql_thread_init();
+			}
+
+			void thread_end() override {
+				mysql_thread_end();
+			}
+
+			MYSQL* init(MYSQL* connection) override {
+				return mysql_init(connection);
+			}
+
+			void close(MYSQL* connection) override {
+				mysql_close(connection);
+			}
+
+			unsigned int error_number(MYSQL* connection) override {
+				return mysql_errno(connection);
+			}
+
+			char const* error(MYSQL* connection) override {
+				return mysql_error(connection);
+			}
+
+			int options(MYSQL* connection, enum mysql_option option, void const* value) override {
+				return mysql_options(connection, option, value);
+			}
+
+			MYSQL* real_connect(MYSQL* connection, char const* host, char const* user, char const* password, char const* database, unsigned int port, char const* unix_socket, unsigned long client_flags) override {
+				return mysql_real_connect(connection, host, user, password, database, port, unix_socket, client_flags);
+			}
+
+			int ping(MYSQL* connection) override {
+				return mysql_ping(connection);
+			}
+
+			int real_query(MYSQL* connection, char const* query, unsigned long length) override {
+				return mysql_real_query(connection, query, length);
+			}
+
+			void set_local_infile_handler(
+				MYSQL* connection,
+				int (*local_infile_init)(void **, char const *, void *),
+				int (*local_infile_read)(void *, char *, unsigned int),
+				void (*local_infile_end)(void *),
+				int (*local_infile_error)(void *, char *, unsigned int),
+				void *userdata
+			) override {
+				mysql_set_local_infile_handler(connection, local_infile_init, local_infile_read, local_infile_end, local_infile_error, userdata);
+			}
+
+			unsigned int field_count(MYSQL* connection) override {
+				return mysql_field_count(connection);
+			}
+
+			unsigned long long insert_id(MYSQL* connection) override {
+				return mysql_insert_id(connection);
+			}
+
+			unsigned long long affected_rows(MYSQL* connection) override {
+				return mysql_affected_rows(connection);
+			}
+
+			unsigned long thread_id(MYSQL* connection) override {
+				return mysql_thread_id(connection);
+			}
+
+			int select_db(MYSQL* connection, char const* database) override {
+				return mysql_select_db(connection, database);
+			}
+
+			int set_character_set(MYSQL* connection, char const* charset) override {
+				return mysql_set_character_set(connection, charset);
+			}
+
+			char const* character_set_name(MYSQL* connection) override {
+				return mysql_character_set_name(connection);
+			}
+
+			int reset_connection(MYSQL* connection) override {
+			#if MYSQL_VERSION_ID >= 50703
+				return mysql_reset_connection(connection);
+			#else
+				(void)connection;
+				return 1;
+			#endif
+			}
+
+			SessionChanges session_track(MYSQL* connection) override {
+				SessionChanges changes;
+			// the session tracker arrived with MySQL 5.7.7
+			#if MYSQL_VERSION_ID >= 50707
+				char const *data = nullptr;
+				size_t length = 0;
+				if(mysql_session_track_get_first(connection, SESSION_TRACK_SCHEMA, &data, &length) == 0) {
+					changes.schema = std::string(data, length);
+				}
+				// names and values alternate
+				std::string name;
+				bool is_value = false;
+				for(int more = mysql_session_track_get_first(connection, SESSION_TRACK_SYSTEM_VARIABLES, &data, &length); more == 0; more = mysql_session_track_get_next(connection, SESSION_TRACK_SYSTEM_VARIABLES, &data, &length)) {
+					if(is_value) {
+						changes.variables.push_back(std::make_pair(name, std::string(data, length)));
+					} else {
+						name.assign(data, length);
+					}
+					is_value = !is_value;
+				}
+			#else
+				(void)connection;
+			#endif
+				return changes;
+			}
+
+			MYSQL_RES* use_result(MYSQL* connection) override {
+				return mysql_use_result(connection);
+			}
+
+			MYSQL_FIELD* fetch_field(MYSQL_RES* result) override {
+				return mysql_fetch_field(result);
+			}
+
+			MYSQL_FIELD_OFFSET field_seek(MYSQL_RES* result, MYSQL_FIELD_OFFSET offset) override {
+				return mysql_field_seek(result, offset);
+			}
+
+			unsigned long* fetch_lengths(MYSQL_RES* result) override {
+				return mysql_fetch_lengths(result);
+			}
+
+			unsigned int num_fields(MYSQL_RES* result) override {
+				return mysql_num_fields(result);
+			}
+
+			MYSQL_ROW fetch_row(MYSQL_RES* result) override {
+				return mysql_fetch_row(result);
+			}
+
+			unsigned long long num_rows(MYSQL_RES* result) override {
+				return mysql_num_rows(result);
+			}
+
+			void free_result(MYSQL_RES* result) override {
+				mysql_free_result(result);
+			}
+
+			MYSQL_STMT* stmt_init(MYSQL* connection) override {
+				return mysql_stmt_init(connection);
+			}
+
+			unsigned int stmt_errno(MYSQL_STMT* statement) override {
+				return mysql_stmt_errno(statement);
+			}
+
+			char const* stmt_error(MYSQL_STMT* statement) override {
+				return mysql_stmt_error(statement);
+			}
+
+			int stmt_prepare(MYSQL_STMT* statement, char const* query, unsigned long length) override {
+				return mysql_stmt_prepare(statement, query, length);
+			}
+
+			unsigned long stmt_param_count(MYSQL_STMT* statement) override {
+				return mysql_stmt_param_count(statement);
+			}
+
+			unsigned int stmt_field_count(MYSQL_STMT* statement) override {
+				return mysql_stmt_field_count(statement);
+			}
+
+			my_bool stmt_bind_param(MYSQL_STMT* statement, MYSQL_BIND* binds) override {
+				return mysql_stmt_bind_param(statement, binds);
+			}
+
+			my_bool stmt_bind_result(MYSQL_STMT* statement, MYSQL_BIND* binds) override {
+				return mysql_stmt_bind_result(statement, binds);
+			}
+
+			int stmt_execute(MYSQL_STMT* statement) override {
+				return mysql_stmt_execute(statement);
+			}
+
+			int stmt_fetch(MYSQL_STMT* statement) override {
+				return mysql_stmt_fetch(statement);
+			}
+
+			int stmt_fetch_column(MYSQL_STMT* statement, MYSQL_BIND* bind, unsigned int column, unsigned long offset) override {
+				return mysql_stmt_fetch_column(statement, bind, column, offset);
+			}
+
+			int stmt_store_result(MYSQL_STMT* statement) override {
+				return mysql_stmt_store_result(statement);
+			}
+
+			my_bool stmt_free_result(MYSQL_STMT* statement) override {
+				return mysql_stmt_free_result(statement);
+			}
+
+			unsigned long long stmt_num_rows(MYSQL_STMT* statement) override {
+				return mysql_stmt_num_rows(statement);
+			}
+
+			unsigned long long stmt_insert_id(MYSQL_STMT* statement) override {
+				return mysql_stmt_insert_id(statement);
+			}
+
+			MYSQL_RES* stmt_result_metadata(MYSQL_STMT* statement) override {
+				return mysql_stmt_result_metadata(statement);
+			}
+
+			my_bool stmt_close(MYSQL_STMT* statement) override {
+				return mysql_stmt_close(statement);
+			}
+		};
+
+		std::atomic<Backend*>& current() {
+			static std::atomic<Backend*> backend(&client_library());
+			return backend;
+		}
+	}
+
+	Backend& client_library() {
+		static ClientLibrary library;
+		return library;
+	}
+
+	Backend& backend() {
+		return *current().load(std::memory_order_acquire);
+	}
+
+	Backend& set_backend(Backend& backend_) {
+		return *current().exchange(&backend_, std::memory_order_acq_rel);
+	}
+}}
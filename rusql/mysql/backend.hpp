@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mysql.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+
+namespace rusql { namespace mysql {
+	//! Session state changes the server reported for the last statement.
+	struct SessionChanges {
+		//! The new default database, if it changed.
+		boost::optional<std::string> schema;
+		//! Changed system variables, as name and value.
+		std::vector<std::pair<std::string, std::string>> variables;
+
+		bool empty() const {
+			return !schema && variables.empty();
+		}
+	};
+
+	//! The part of the MySQL C API that rusql uses, one function per C function and with the same meaning. The
+	//! functions in error_checked.hpp call through the current backend instead of calling libmysqlclient
+	//! directly, so another implementation can take its place, such as FakeBackend. Handles stay MYSQL,
+	//! MYSQL_STMT and MYSQL_RES pointers; what they point to is up to the backend that handed them out, except
+	//! for MYSQL, which the caller owns.
+	struct Backend : boost::noncopyable {
+		virtual ~Backend() {}
+
+		virtual int thread_init() = 0;
+		virtual void thread_end() = 0;
+
+		virtual MYSQL* init(MYSQL* connection) = 0;
+		virtual void close(MYSQL* connection) = 0;
+		virtual unsigned int error_number(MYSQL* connection) = 0;
+		virtual char const* error(MYSQL* connection) = 0;
+		virtual int options(MYSQL* connection, enum mysql_option option, void const* value) = 0;
+		virtual MYSQL* real_connect(MYSQL* connection, char const* host, char const* user, char const* password, char const* database, unsigned int port, char const* unix_socket, unsigned long client_flags) = 0;
+		virtual int ping(MYSQL* connection) = 0;
+		virtual int real_query(MYSQL* connection, char const* query, unsigned long length) = 0;
+		virtual void set_local_infile_handler(
+			MYSQL* connection,
+			int (*local_infile_init)(void **, char const *, void *),
+			int (*local_infile_read)(void *, char *, unsigned int),
+			void (*local_infile_end)(void *),
+			int (*local_infile_error)(void *, char *, unsigned int),
+			void *userdata
+		) = 0;
+		virtual unsigned int field_count(MYSQL* connection) = 0;
+		virtual unsigned long long insert_id(MYSQL* connection) = 0;
+		virtual unsigned long long affected_rows(MYSQL* connection) = 0;
+		virtual unsigned long thread_id(MYSQL* connection) = 0;
+		virtual int select_db(MYSQL* connection, char const* database) = 0;
+		virtual int set_character_set(MYSQL* connection, char const* charset) = 0;
+		virtual char const* character_set_name(MYSQL* connection) = 0;
+		//! Non-zero with error() set when it failed, also when the backend can't.
+		virtual int reset_connection(MYSQL* connection) = 0;
+		//! mysql_session_track_get_first/next in one go.
+		virtual SessionChanges session_track(MYSQL* connection) = 0;
+
+		virtual MYSQL_RES* use_result(MYSQL* connection) = 0;
+		virtual MYSQL_FIELD* fetch_field(MYSQL_RES* result) = 0;
+		virtual MYSQL_FIELD_OFFSET field_seek(MYSQL_RES* result, MYSQL_FIELD_OFFSET offset) = 0;
+		virtual unsigned long* fetch_lengths(MYSQL_RES* result) = 0;
+		virtual unsigned int num_fields(MYSQL_RES* result) = 0;
+		virtual MYSQL_ROW fetch_row(MYSQL_RES* result) = 0;
+		virtual unsigned long long num_rows(MYSQL_RES* result) = 0;
+		virtual void free_result(MYSQL_RES* result) = 0;
+
+		virtual MYSQL_STMT* stmt_init(MYSQL* connection) = 0;
+		virtual unsigned int stmt_errno(MYSQL_STMT* statement) = 0;
+		virtual char const* stmt_error(MYSQL_STMT* statement) = 0;
+		virtual int stmt_prepare(MYSQL_STMT* statement, char const* query, unsigned long length) = 0;
+		virtual unsigned long stmt_param_count(MYSQL_STMT* statement) = 0;
+		virtual unsigned int stmt_field_count(MYSQL_STMT* statement) = 0;
+		virtual my_bool stmt_bind_param(MYSQL_STMT* statement, MYSQL_BIND* binds) = 0;
+		virtual my_bool stmt_bind_result(MYSQL_STMT* statement, MYSQL_BIND* binds) = 0;
+		virtual int stmt_execute(MYSQL_STMT* statement) = 0;
+		virtual int stmt_fetch(MYSQL_STMT* statement) = 0;
+		virtual int stmt_fetch_column(MYSQL_STMT* statement, MYSQL_BIND* bind, unsigned int column, unsigned long offset) = 0;
+		virtual int stmt_store_result(MYSQL_STMT* statement) = 0;
+		virtual my_bool stmt_free_result(MYSQL_STMT* statement) = 0;
+		virtual unsigned long long stmt_num_rows(MYSQL_STMT* statement) = 0;
+		virtual unsigned long long stmt_insert_id(MYSQL_STMT* statement) = 0;
+		virtual MYSQL_RES* stmt_result_metadata(MYSQL_STMT* statement) = 0;
+		virtual my_bool stmt_close(MYSQL_STMT* statement) = 0;
+	};
+
+	//! libmysqlclient (or libmysqld, whichever is linked in); the default backend.
+	Backend& client_library();
+
+	//! The backend all of rusql currently uses.
+	Backend& backend();
+
+	//! Makes all of rusql use backend from now on and returns the previous one. Only switch while no
+	//! connections, statements or results exist: those stay tied to the backend that made them.
+	Backend& set_backend(Backend& backend);
+
+	//! Uses a backend for as long as it lives, e.g. for a test.
+	struct BackendScope : boost::noncopyable {
+		BackendScope(Backend& backend)
+		: previous(set_backend(backend))
+		{}
+
+		~BackendScope() {
+			set_backend(previous);
+		}
+
+	private:
+		Backend& previous;
+	};
+}}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include <cstring>
@@ -7,17 +8,26 @@
 #include <boost/noncopyable.hpp>
 
 #include "error_checked.hpp"
+#include "local_infile.hpp"
+#include "observer.hpp"
 
 namespace rusql { namespace mysql {
 	//! A wrapper around MYSQL (the struct), symbolizing a connection.
 	struct Connection : boost::noncopyable {
-		Connection() {
+		Connection()
+		: observers(std::make_shared<ObserverSlot>())
+		{
 			memset(&database, 0, sizeof(MYSQL));
 			init();
+			// LOAD DATA LOCAL INFILE is only ever served from memory, see LocalInfile
+			unsigned int const local_infile = 1;
+			options(MYSQL_OPT_LOCAL_INFILE, &local_infile);
+			LocalInfile::refuse(&database);
 		}
 		
 		Connection(MYSQL&& database_)
 		: database(std::move(database_))
+		, observers(std::make_shared<ObserverSlot>())
 		{}
 
 		~Connection() {
@@ -31,6 +41,20 @@ namespace rusql { namespace mysql {
 		}
 		
 		MYSQL database;
+
+		//! Whom to tell about the statements on this connection; a Database shares its own with its connections.
+		std::shared_ptr<ObserverSlot> observers;
+
+		//! The observer of observers, as far as this connection has seen; see observer().
+		mutable CachedObserver cached_observer;
+
+		//! The text of the last query(), for the result's events. Only kept while observed.
+		std::string last_query;
+
+		//! The observer to report to, or nullptr.
+		inline QueryObserver* observer() const {
+			return cached_observer.get(*observers).get();
+		}
 		
 		inline MYSQL* init(){
 			return rusql::mysql::init(&database);
@@ -52,6 +76,38 @@ namespace rusql { namespace mysql {
 			return rusql::mysql::insert_id(&database);
 		}
 
+		inline unsigned long long affected_rows() {
+			return rusql::mysql::affected_rows(&database);
+		}
+
+		inline unsigned long thread_id() {
+			return rusql::mysql::thread_id(&database);
+		}
+
+		inline void select_db(std::string const database_) {
+			rusql::mysql::select_db(&database, database_);
+		}
+
+		inline void set_character_set(std::string const charset) {
+			rusql::mysql::set_character_set(&database, charset);
+		}
+
+		inline std::string character_set_name() {
+			return rusql::mysql::character_set_name(&database);
+		}
+
+		inline void reset_connection() {
+			rusql::mysql::reset_connection(&database);
+		}
+
+		inline SessionChanges session_track() {
+			return rusql::mysql::session_track(&database);
+		}
+
+		inline void options(enum mysql_option option, void const* value) {
+			rusql::mysql::options(&database, option, value);
+		}
+
 		inline MYSQL_STMT* stmt_init(){
 			return rusql::mysql::stmt_init(&database);
 		}
@@ -69,7 +125,30 @@ namespace rusql { namespace mysql {
 		}
 		
 		inline void query(std::string const query_string) {
-			return rusql::mysql::query(&database, query_string);
+			QueryObserver* const observer_ = observer();
+			if(observer_ == nullptr) {
+				return rusql::mysql::query(&database, query_string);
+			}
+			last_query = query_string;
+			ObservedStage stage(*observer_, QueryStage::Query, last_query, thread_id());
+			rusql::mysql::query(&database, query_string);
+			stage.finish();
+		}
+
+		//! Runs a LOAD DATA LOCAL INFILE query whose data is read from infile. If reading threw, that exception
+		//! is rethrown instead of the query's error.
+		inline void load_local_infile(std::string const query_string, LocalInfile& infile) {
+			infile.install(&database);
+			try {
+				query(query_string);
+			} catch(...) {
+				LocalInfile::refuse(&database);
+				if(infile.error) {
+					std::rethrow_exception(infile.error);
+				}
+				throw;
+			}
+			LocalInfile::refuse(&database);
 		}
 	};
 }}
@@ -0,0 +1,72 @@
+#include "allocations.hpp"
+
+#include <cstdlib>
+#include <new>
+
+//! \file count_allocations.cpp The rusql_count_allocations library: replaces the global operator new and
+//! delete with ones that count every allocation in thread_allocation_count, then use malloc() and free() like
+//! the default ones do. Link it into a program to see its allocations per statement; see allocations.hpp.
+
+namespace {
+	void* allocate(std::size_t const size) {
+		auto &count = rusql::mysql::thread_allocation_count;
+		++count.allocations;
+		count.bytes += size;
+		while(true) {
+			if(void* const p = std::malloc(size == 0 ? 1 : size)) {
+				return p;
+			}
+			std::new_handler const handler = std::get_new_handler();
+			if(handler == nullptr) {
+				throw std::bad_alloc();
+			}
+			handler();
+		}
+	}
+
+	void* allocate(std::size_t const size, std::nothrow_t const&) noexcept {
+		try {
+			return allocate(size);
+		} catch(std::bad_alloc &) {
+			return nullptr;
+		}
+	}
+
+	struct Announce {
+		Announce() {
+			rusql::mysql::set_counting_allocations();
+		}
+	} const announce;
+}
+
+void* operator new(std::size_t const size) {
+	return allocate(size);
+}
+
+void* operator new[](std::size_t const size) {
+	return allocate(size);
+}
+
+void* operator new(std::size_t const size, std::nothrow_t const& nothrow) noexcept {
+	return allocate(size, nothrow);
+}
+
+void* operator new[](std::size_t const size, std::nothrow_t const& nothrow) noexcept {
+	return allocate(size, nothrow);
+}
+
+void operator delete(void* const p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* const p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* const p, std::nothrow_t const&) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* const p, std::nothrow_t const&) noexcept {
+	std::free(p);
+}
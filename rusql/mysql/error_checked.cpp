@@ -1,25 +1,25 @@
 #include "error_checked.hpp"
+#include "trace.hpp"
 
 #include <string>
 #include <iostream>
 
-constexpr static bool output_calls = false;
-
-#define BARK do { if(output_calls) std::cerr << __FUNCTION__ << std::endl; } while(false)
+#define TRACE(call) TraceScope const trace_scope(TracedCall::call)
 
 namespace rusql { namespace mysql {
 	void clear_mysql_error(MYSQL *connection) {
 		// If the MySQL server is available, ping() clears the error
 		// If not, the current error is "MySQL server is not available"
 		// So this is our best guess:
-		mysql_ping(connection);
+		backend().ping(connection);
 	}
 
 	void check_and_throw_conn(MYSQL* connection, std::string f)
 	{
-		if(mysql_errno(connection)){
-			std::string error = mysql_error(connection);
+		if(backend().error_number(connection)){
+			std::string error = backend().error(connection);
 			if(!error.empty()){
+				note_trace_error(backend().error_number(connection));
 				clear_mysql_error(connection);
 				throw SQLError(f, error);
 			}
@@ -28,23 +28,24 @@ namespace rusql { namespace mysql {
 
 	void check_and_throw_stmt(MYSQL_STMT* statement, std::string f)
 	{
-		auto const error_code = mysql_stmt_errno(statement);
-		char const * const error = mysql_stmt_error(statement);
+		auto const error_code = backend().stmt_errno(statement);
+		char const * const error = backend().stmt_error(statement);
 		if(error_code != 0 || error[0]){
+			note_trace_error(error_code);
 			throw SQLError(f, error);
 		}
 	}
 
 	void thread_init(void) {
-		BARK;
-		if(mysql_thread_init() != 0) {
+		TRACE(thread_init);
+		if(backend().thread_init() != 0) {
 			throw SQLError("mysql_thread_init failed");
 		}
 	}
 
 	void thread_end(void) {
-		BARK;
-		mysql_thread_end();
+		TRACE(thread_end);
+		backend().thread_end();
 	}
 	
 	#define CHECK(prefix) check_and_throw_conn(connection, std::string(prefix) + __FUNCTION__)
@@ -54,35 +55,34 @@ namespace rusql { namespace mysql {
 	#define SAFE_RETURN(stmt) { CHECK_BEFORE; auto result_ = stmt; CHECK_AFTER; return result_; }
 
 	MYSQL* init(MYSQL* connection){
-		BARK;
-		SAFE_RETURN(mysql_init(connection));
+		TRACE(init);
+		SAFE_RETURN(backend().init(connection));
 	}
 
 	void close(MYSQL* connection) {
-		BARK;
+		TRACE(close);
 		CHECK_BEFORE;
-		mysql_close(connection);
+		backend().close(connection);
 		CHECK_AFTER;
 	}
 	
 	int ping(MYSQL* connection){
-		BARK;
-		SAFE_RETURN(mysql_ping(connection));
+		TRACE(ping);
+		SAFE_RETURN(backend().ping(connection));
 	}
 	
 	MYSQL_RES* use_result(MYSQL* connection) {
-		BARK;
-		SAFE_RETURN(mysql_use_result(connection));
+		TRACE(use_result);
+		SAFE_RETURN(backend().use_result(connection));
 	}
 	
 	size_t field_count(MYSQL* connection){
-		BARK;
-		SAFE_RETURN(mysql_field_count(connection));
+		SAFE_RETURN(backend().field_count(connection));
 	}
 	
 	MYSQL_STMT* stmt_init(MYSQL* connection){
-		BARK;
-		SAFE_RETURN(mysql_stmt_init(connection));
+		TRACE(stmt_init);
+		SAFE_RETURN(backend().stmt_init(connection));
 	}
 	
 	MYSQL* connect(
@@ -95,18 +95,18 @@ namespace rusql { namespace mysql {
 		boost::optional<std::string const> unix_socket,
 		unsigned long client_flags
 	) {
-		BARK;
+		TRACE(connect);
 		auto char_ptr = [](boost::optional<std::string const> x) { return (x ? x->c_str() : nullptr); };
 
-		SAFE_RETURN(mysql_real_connect(connection, char_ptr(host), char_ptr(user), char_ptr(password), char_ptr(database), port, char_ptr(unix_socket), client_flags));
+		SAFE_RETURN(backend().real_connect(connection, char_ptr(host), char_ptr(user), char_ptr(password), char_ptr(database), port, char_ptr(unix_socket), client_flags));
 	}
 	
 	void query(MYSQL* connection, std::string const query){
-		BARK;
+		TRACE(query);
 		int result;
 		{
 			CHECK_BEFORE;
-			result = mysql_real_query(connection, query.c_str(), query.length());
+			result = backend().real_query(connection, query.c_str(), query.length());
 			CHECK_AFTER;
 		}
 
@@ -115,19 +115,39 @@ namespace rusql { namespace mysql {
 		}
 	}
 	
+	void options(MYSQL* connection, enum mysql_option option, void const* value) {
+		TRACE(options);
+		CHECK_BEFORE;
+		int result = backend().options(connection, option, value);
+		CHECK_AFTER;
+
+		if(result != 0) {
+			throw SQLError(std::string(__FUNCTION__) + " failed: unknown option");
+		}
+	}
+
+	void set_local_infile_handler(
+		MYSQL* connection,
+		int (*local_infile_init)(void **, char const *, void *),
+		int (*local_infile_read)(void *, char *, unsigned int),
+		void (*local_infile_end)(void *),
+		int (*local_infile_error)(void *, char *, unsigned int),
+		void *userdata
+	) {
+		TRACE(set_local_infile_handler);
+		backend().set_local_infile_handler(connection, local_infile_init, local_infile_read, local_infile_end, local_infile_error, userdata);
+	}
+
 	MYSQL_FIELD* fetch_field(MYSQL_RES* result) {
-		BARK;
-		return mysql_fetch_field(result);
+		return backend().fetch_field(result);
 	}
 	
 	MYSQL_FIELD_OFFSET field_seek(MYSQL_RES* result, MYSQL_FIELD_OFFSET offset){
-		BARK;
-		return mysql_field_seek(result, offset);
+		return backend().field_seek(result, offset);
 	}
 	
 	unsigned long* fetch_lengths(MYSQL_RES* result){
-		BARK;
-		auto const r = mysql_fetch_lengths(result);
+		auto const r = backend().fetch_lengths(result);
 		if(r == nullptr){
 			throw SQLError(__FUNCTION__, "Failed to fetch field lengths (probably no current row: forgot to call fetch_row or no more rows)");
 		}
@@ -136,96 +156,159 @@ namespace rusql { namespace mysql {
 	}
 	
 	unsigned int num_fields(MYSQL_RES* result) {
-		BARK;
-		return mysql_num_fields(result);
+		return backend().num_fields(result);
 	}
 	
 	void free_result(MYSQL_RES* result){
-		BARK;
-		mysql_free_result(result);
+		TRACE(free_result);
+		backend().free_result(result);
 	}
 	
 	MYSQL_ROW fetch_row(MYSQL* connection, MYSQL_RES* result){
-		BARK;
-		SAFE_RETURN(mysql_fetch_row(result));
+		TRACE(fetch_row);
+		SAFE_RETURN(backend().fetch_row(result));
 	}
 
 	unsigned long long num_rows(MYSQL *connection, MYSQL_RES *result) {
-		BARK;
-		SAFE_RETURN(mysql_num_rows(result));
+		SAFE_RETURN(backend().num_rows(result));
 	}
 
 	unsigned long long insert_id(MYSQL *connection) {
-		BARK;
-		SAFE_RETURN(mysql_insert_id(connection));
+		SAFE_RETURN(backend().insert_id(connection));
+	}
+
+	unsigned long long affected_rows(MYSQL *connection) {
+		SAFE_RETURN(backend().affected_rows(connection));
+	}
+
+	unsigned long thread_id(MYSQL *connection) {
+		SAFE_RETURN(backend().thread_id(connection));
+	}
+
+	void select_db(MYSQL *connection, std::string const database) {
+		TRACE(select_db);
+		int result;
+		{
+			CHECK_BEFORE;
+			result = backend().select_db(connection, database.c_str());
+			CHECK_AFTER;
+		}
+		if(result != 0) {
+			throw SQLError(std::string(__FUNCTION__) + " failed");
+		}
+	}
+
+	void set_character_set(MYSQL *connection, std::string const charset) {
+		TRACE(set_character_set);
+		int result;
+		{
+			CHECK_BEFORE;
+			result = backend().set_character_set(connection, charset.c_str());
+			CHECK_AFTER;
+		}
+		if(result != 0) {
+			throw SQLError(std::string(__FUNCTION__) + " failed: unknown character set " + charset);
+		}
+	}
+
+	std::string character_set_name(MYSQL *connection) {
+		CHECK_BEFORE;
+		char const *name = backend().character_set_name(connection);
+		CHECK_AFTER;
+		return name ? name : "";
+	}
+
+	void reset_connection(MYSQL *connection) {
+		TRACE(reset_connection);
+		int result;
+		{
+			CHECK_BEFORE;
+			result = backend().reset_connection(connection);
+			CHECK_AFTER;
+		}
+		if(result != 0) {
+			throw SQLError(std::string(__FUNCTION__) + " failed; it needs MySQL 5.7.3 or later");
+		}
+	}
+
+	SessionChanges session_track(MYSQL *connection) {
+		TRACE(session_track);
+		return backend().session_track(connection);
 	}
 
 	#undef CHECK
 	#define CHECK(prefix) check_and_throw_stmt(statement, std::string(prefix) + __FUNCTION__)
 
 	unsigned long stmt_param_count(MYSQL_STMT* statement){
-		BARK;
-		SAFE_RETURN(mysql_stmt_param_count(statement));
+		SAFE_RETURN(backend().stmt_param_count(statement));
 	}
 
 	unsigned long stmt_field_count(MYSQL_STMT* statement){
-		BARK;
-		SAFE_RETURN(mysql_stmt_field_count(statement));
+		SAFE_RETURN(backend().stmt_field_count(statement));
 	}
 
 	my_bool stmt_bind_param(MYSQL_STMT* statement, MYSQL_BIND* binds){
-		BARK;
-		SAFE_RETURN(mysql_stmt_bind_param(statement, binds));
+		TRACE(stmt_bind_param);
+		SAFE_RETURN(backend().stmt_bind_param(statement, binds));
 	}
 	
 	my_bool stmt_bind_result(MYSQL_STMT* statement, MYSQL_BIND* binds){
-		BARK;
-		SAFE_RETURN(mysql_stmt_bind_result(statement, binds));
+		TRACE(stmt_bind_result);
+		SAFE_RETURN(backend().stmt_bind_result(statement, binds));
 	}
 
 	void stmt_fetch_column(MYSQL_STMT* statement, MYSQL_BIND* bind, unsigned int column, unsigned long offset) {
-		BARK;
+		TRACE(stmt_fetch_column);
 		CHECK_BEFORE;
-		if(mysql_stmt_fetch_column(statement, bind, column, offset) != 0) {
+		if(backend().stmt_fetch_column(statement, bind, column, offset) != 0) {
 			throw SQLError(std::string(__FUNCTION__) + " failed, but mysql didn't notice");
 		}
 		CHECK_AFTER;
 	}
 	
 	my_bool stmt_close(MYSQL_STMT* statement){
-		BARK;
-		SAFE_RETURN(mysql_stmt_close(statement));
+		TRACE(stmt_close);
+		// An error left by the statement's last call (e.g. a killed execute) doesn't keep it from closing, and
+		// afterwards there is no statement left to check
+		return backend().stmt_close(statement);
 	}
 	
 	int stmt_prepare(MYSQL_STMT* statement, std::string q){
-		BARK;
-		SAFE_RETURN(mysql_stmt_prepare(statement, q.c_str(), q.length()));
+		TRACE(stmt_prepare);
+		SAFE_RETURN(backend().stmt_prepare(statement, q.c_str(), q.length()));
 	}
 	
 	unsigned long long stmt_insert_id(MYSQL_STMT* statement) {
-		BARK;
-		return mysql_stmt_insert_id(statement);
+		return backend().stmt_insert_id(statement);
 	}
 
 	void stmt_store_result(MYSQL_STMT *statement) {
-		BARK;
+		TRACE(stmt_store_result);
+		CHECK_BEFORE;
+		if(backend().stmt_store_result(statement) != 0) {
+			throw SQLError(std::string(__FUNCTION__) + " failed, but mysql didn't notice");
+		}
+		CHECK_AFTER;
+	}
+
+	void stmt_free_result(MYSQL_STMT *statement) {
+		TRACE(stmt_free_result);
 		CHECK_BEFORE;
-		if(mysql_stmt_store_result(statement) != 0) {
+		if(backend().stmt_free_result(statement) != 0) {
 			throw SQLError(std::string(__FUNCTION__) + " failed, but mysql didn't notice");
 		}
 		CHECK_AFTER;
 	}
 
 	unsigned long long stmt_num_rows(MYSQL_STMT *statement) {
-		BARK;
-		return mysql_stmt_num_rows(statement);
+		return backend().stmt_num_rows(statement);
 	}
 
 	int stmt_execute(MYSQL_STMT* statement){
-		BARK;
+		TRACE(stmt_execute);
 
 		CHECK_BEFORE;
-		int result = mysql_stmt_execute(statement);
+		int result = backend().stmt_execute(statement);
 		CHECK_AFTER;
 
 		if(result != 0){
@@ -235,10 +318,10 @@ namespace rusql { namespace mysql {
 	}
 
 	int stmt_fetch(MYSQL_STMT* statement){
-		BARK;
+		TRACE(stmt_fetch);
 
 		CHECK_BEFORE;
-		int result = mysql_stmt_fetch(statement);
+		int result = backend().stmt_fetch(statement);
 		CHECK_AFTER;
 
 		if(!(result == 0 || result == MYSQL_NO_DATA || result == MYSQL_DATA_TRUNCATED)){
@@ -249,10 +332,10 @@ namespace rusql { namespace mysql {
 	}
 
 	MYSQL_RES *stmt_result_metadata(MYSQL_STMT *statement){
-		BARK;
+		TRACE(stmt_result_metadata);
 
 		CHECK_BEFORE;
-		MYSQL_RES *result = mysql_stmt_result_metadata(statement);
+		MYSQL_RES *result = backend().stmt_result_metadata(statement);
 		CHECK_AFTER;
 
 		if(result == NULL) {
@@ -263,4 +346,5 @@ namespace rusql { namespace mysql {
 	}
 
 	#undef CHECK
+	#undef TRACE
 }}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <stdexcept>
+#include <string>
 
 #include <mysql.h>
 
+#include "backend.hpp"
+
 #include <boost/optional.hpp>
 
 namespace rusql { namespace mysql {
@@ -63,6 +66,19 @@ namespace rusql { namespace mysql {
 	);
 	
 	void query(MYSQL* connection, std::string const query);
+
+	//! Must be called after init and before connect.
+	void options(MYSQL* connection, enum mysql_option option, void const* value);
+
+	//! Doesn't return errors
+	void set_local_infile_handler(
+		MYSQL* connection,
+		int (*local_infile_init)(void **, char const *, void *),
+		int (*local_infile_read)(void *, char *, unsigned int),
+		void (*local_infile_end)(void *),
+		int (*local_infile_error)(void *, char *, unsigned int),
+		void *userdata
+	);
 	
 	//! Doesn't return errors
 	MYSQL_FIELD* fetch_field(MYSQL_RES* result);
@@ -84,6 +100,25 @@ namespace rusql { namespace mysql {
 	
 	unsigned long long insert_id(MYSQL *connection);
 
+	unsigned long long affected_rows(MYSQL *connection);
+
+	//! The server's id for this connection, as used by KILL
+	unsigned long thread_id(MYSQL *connection);
+
+	void select_db(MYSQL *connection, std::string const database);
+
+	void set_character_set(MYSQL *connection, std::string const charset);
+
+	std::string character_set_name(MYSQL *connection);
+
+	//! Clears the session like a reconnect would, without one: session variables, user variables, temporary
+	//! tables and prepared statements. Needs MySQL 5.7.3 or later.
+	void reset_connection(MYSQL *connection);
+
+	//! Empty when nothing changed, but also when the server doesn't track the session (session_track_schema and
+	//! session_track_system_variables) or the client library predates it.
+	SessionChanges session_track(MYSQL *connection);
+
 	unsigned long long num_rows(MYSQL *connection, MYSQL_RES *result);
 
 	//! Doesn't return errors
@@ -107,6 +142,9 @@ namespace rusql { namespace mysql {
 
 	void stmt_store_result(MYSQL_STMT *statement);
 
+	//! Discards the statement's current result set, including rows not fetched yet, without a server round trip.
+	void stmt_free_result(MYSQL_STMT *statement);
+
 	unsigned long long stmt_num_rows(MYSQL_STMT* statement);
 
 	//! Returns non-zero when there are no more rows to fetch
@@ -0,0 +1,622 @@
+#include "fake_backend.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "error_checked.hpp"
+
+namespace rusql { namespace mysql {
+	//! A scripted result, laid out the way the C API hands it out, so serving it copies nothing.
+	struct FakeBackend::Table {
+		Table(Result const& result)
+		: rows(result.rows)
+		, affected_rows(result.affected_rows)
+		, insert_id(result.insert_id)
+		, session_changes(result.session_changes)
+		{
+			names = result.columns;
+			fields.resize(names.size());
+			for(size_t i = 0; i < names.size(); ++i) {
+				MYSQL_FIELD &field = fields[i];
+				std::memset(&field, 0, sizeof(field));
+				field.name = const_cast<char*>(names[i].c_str());
+				field.type = i < result.types.size() ? result.types[i] : MYSQL_TYPE_VAR_STRING;
+			}
+
+			cells.resize(rows.size());
+			lengths.resize(rows.size());
+			for(size_t r = 0; r < rows.size(); ++r) {
+				if(rows[r].size() != names.size()) {
+					throw SQLError(__FUNCTION__, "scripted row has a different number of values than there are columns");
+				}
+				for(auto const &value : rows[r]) {
+					cells[r].push_back(value ? const_cast<char*>(value->c_str()) : nullptr);
+					lengths[r].push_back(value ? value->size() : 0);
+				}
+			}
+		}
+
+		std::vector<std::string> names;
+		std::vector<MYSQL_FIELD> fields;
+		std::vector<std::vector<Value>> const rows;
+		std::vector<std::vector<char*>> cells;
+		std::vector<std::vector<unsigned long>> lengths;
+		unsigned long long const affected_rows;
+		unsigned long long const insert_id;
+		SessionChanges const session_changes;
+		boost::optional<std::string> error;
+	};
+
+	struct FakeBackend::Session {
+		Session()
+		: error_number(0)
+		, thread_id(0)
+		, charset("utf8mb4")
+		{}
+
+		unsigned int error_number;
+		std::string error;
+		unsigned long thread_id;
+		std::string schema;
+		std::string charset;
+		//! Of the last plain query.
+		std::shared_ptr<Table const> last;
+
+		void clear() {
+			error_number = 0;
+			error.clear();
+		}
+	};
+
+	//! MYSQL_RES comes first, so the pointer handed out converts back.
+	struct FakeBackend::ResultHandle {
+		MYSQL_RES result;
+		std::shared_ptr<Table const> table;
+		size_t next_row;
+		size_t field;
+
+		//! Without rows for just the metadata of a prepared statement.
+		ResultHandle(std::shared_ptr<Table const> const& table_, bool const with_rows)
+		: table(table_)
+		, next_row(with_rows ? 0 : table->rows.size())
+		, field(0)
+		{
+			std::memset(&result, 0, sizeof(result));
+		}
+
+		static ResultHandle& get(MYSQL_RES* result) {
+			return *reinterpret_cast<ResultHandle*>(result);
+		}
+	};
+
+	struct FakeBackend::StatementHandle {
+		MYSQL_STMT statement;
+		MYSQL* connection;
+		unsigned int error_number;
+		std::string error;
+		unsigned long param_count;
+		std::string query;
+		std::shared_ptr<Table const> table;
+		bool executed;
+		size_t next_row;
+		std::vector<MYSQL_BIND> parameters;
+		std::vector<MYSQL_BIND> results;
+
+		StatementHandle(MYSQL* connection_)
+		: connection(connection_)
+		, error_number(0)
+		, param_count(0)
+		, executed(false)
+		, next_row(0)
+		{
+			std::memset(&statement, 0, sizeof(statement));
+		}
+
+		static StatementHandle& get(MYSQL_STMT* statement) {
+			return *reinterpret_cast<StatementHandle*>(statement);
+		}
+
+		Value const& cell(unsigned int const column) {
+			return table->rows.at(next_row - 1).at(column);
+		}
+	};
+
+	namespace {
+		uint64_t const magic = 0x72757371666b6521ull;
+		unsigned int const query_interrupted = 1317;
+		char const* const query_interrupted_message = "Query execution was interrupted";
+
+		template <typename T>
+		void store(MYSQL_BIND const& bind, T const value) {
+			std::memcpy(bind.buffer, &value, sizeof(value));
+		}
+
+		//! Converts value to what bind asks for, like the client library converts the binary protocol. Returns
+		//! whether it was truncated.
+		bool write(MYSQL_BIND const& bind, FakeBackend::Value const& value, unsigned long const offset) {
+			if(bind.is_null) {
+				*bind.is_null = !value;
+			}
+			if(!value) {
+				return false;
+			}
+			std::string const &s = *value;
+
+			bool truncated = false;
+			if(bind.buffer != nullptr) {
+				bool const is_unsigned = bind.is_unsigned;
+				switch(bind.buffer_type) {
+				case MYSQL_TYPE_NULL:
+					break;
+				case MYSQL_TYPE_TINY:
+					is_unsigned ? store(bind, uint8_t(std::strtoull(s.c_str(), nullptr, 10))) : store(bind, int8_t(std::strtoll(s.c_str(), nullptr, 10)));
+					break;
+				case MYSQL_TYPE_SHORT:
+					is_unsigned ? store(bind, uint16_t(std::strtoull(s.c_str(), nullptr, 10))) : store(bind, int16_t(std::strtoll(s.c_str(), nullptr, 10)));
+					break;
+				case MYSQL_TYPE_LONG:
+				case MYSQL_TYPE_INT24:
+					is_unsigned ? store(bind, uint32_t(std::strtoull(s.c_str(), nullptr, 10))) : store(bind, int32_t(std::strtoll(s.c_str(), nullptr, 10)));
+					break;
+				case MYSQL_TYPE_LONGLONG:
+					is_unsigned ? store(bind, uint64_t(std::strtoull(s.c_str(), nullptr, 10))) : store(bind, int64_t(std::strtoll(s.c_str(), nullptr, 10)));
+					break;
+				case MYSQL_TYPE_FLOAT:
+					store(bind, float(std::strtod(s.c_str(), nullptr)));
+					break;
+				case MYSQL_TYPE_DOUBLE:
+					store(bind, std::strtod(s.c_str(), nullptr));
+					break;
+				case MYSQL_TYPE_DECIMAL:
+				case MYSQL_TYPE_TIMESTAMP:
+				case MYSQL_TYPE_DATE:
+				case MYSQL_TYPE_TIME:
+				case MYSQL_TYPE_DATETIME:
+				case MYSQL_TYPE_YEAR:
+				case MYSQL_TYPE_NEWDATE:
+				case MYSQL_TYPE_VARCHAR:
+				case MYSQL_TYPE_BIT:
+				case MYSQL_TYPE_NEWDECIMAL:
+				case MYSQL_TYPE_ENUM:
+				case MYSQL_TYPE_SET:
+				case MYSQL_TYPE_TINY_BLOB:
+				case MYSQL_TYPE_MEDIUM_BLOB:
+				case MYSQL_TYPE_LONG_BLOB:
+				case MYSQL_TYPE_BLOB:
+				case MYSQL_TYPE_VAR_STRING:
+				case MYSQL_TYPE_STRING:
+				case MYSQL_TYPE_GEOMETRY:
+				default: {
+					size_t const begin = std::min<size_t>(offset, s.size());
+					size_t const available = s.size() - begin;
+					std::memcpy(bind.buffer, s.data() + begin, std::min<size_t>(available, bind.buffer_length));
+					if(available < bind.buffer_length) {
+						static_cast<char*>(bind.buffer)[available] = '\0';
+					}
+					truncated = available > bind.buffer_length;
+				}
+				}
+			} else {
+				truncated = !s.empty();
+			}
+
+			if(bind.length) {
+				*bind.length = s.size();
+			}
+			if(bind.error) {
+				*bind.error = truncated;
+			}
+			return truncated;
+		}
+
+		//! Placeholders outside of quotes.
+		unsigned long count_placeholders(std::string const& q) {
+			unsigned long count = 0;
+			char quote = 0;
+			for(size_t i = 0; i < q.size(); ++i) {
+				char const c = q[i];
+				if(quote) {
+					if(c == '\\') {
+						++i;
+					} else if(c == quote) {
+						quote = 0;
+					}
+				} else if(c == '\'' || c == '"' || c == '`') {
+					quote = c;
+				} else if(c == '?') {
+					++count;
+				}
+			}
+			return count;
+		}
+	}
+
+	FakeBackend::FakeBackend()
+	: next_thread_id(1)
+	, statements(0)
+	, kills(0)
+	, resets(0)
+	{}
+
+	FakeBackend::~FakeBackend() {}
+
+	void FakeBackend::script(std::string const& q, Result const& result) {
+		auto table = std::make_shared<Table>(result);
+		boost::mutex::scoped_lock lock(mutex);
+		scripts[q] = table;
+	}
+
+	void FakeBackend::script_error(std::string const& q, std::string const& message) {
+		auto table = std::make_shared<Table>(Result());
+		table->error = message;
+		boost::mutex::scoped_lock lock(mutex);
+		scripts[q] = table;
+	}
+
+	void FakeBackend::stall(std::string const& q, size_t const count, boost::chrono::steady_clock::duration const timeout) {
+		boost::mutex::scoped_lock lock(mutex);
+		stalls[q] = Stall{count, timeout};
+	}
+
+	bool FakeBackend::stall_unless_killed(std::string const& q, unsigned long const thread_id) {
+		boost::mutex::scoped_lock lock(mutex);
+		auto const it = stalls.find(q);
+		if(it == stalls.end() || it->second.count == 0) {
+			return true;
+		}
+		--it->second.count;
+		auto const deadline = boost::chrono::steady_clock::now() + it->second.timeout;
+		while(killed.count(thread_id) == 0) {
+			if(killed_changed.wait_until(lock, deadline) == boost::cv_status::timeout) {
+				return true;
+			}
+		}
+		killed.erase(thread_id);
+		return false;
+	}
+
+	std::shared_ptr<FakeBackend::Table const> FakeBackend::lookup(std::string const& q, std::string& error) {
+		boost::mutex::scoped_lock lock(mutex);
+		auto const it = scripts.find(q);
+		if(it == scripts.end()) {
+			error = "FakeBackend has nothing scripted for: " + q;
+			return nullptr;
+		}
+		if(it->second->error) {
+			error = *it->second->error;
+			return nullptr;
+		}
+		return it->second;
+	}
+
+	FakeBackend::Session* FakeBackend::session(MYSQL* connection) {
+		uint64_t m;
+		std::memcpy(&m, connection, sizeof(m));
+		if(m != magic) {
+			return nullptr;
+		}
+		Session* s;
+		std::memcpy(&s, reinterpret_cast<char*>(connection) + sizeof(m), sizeof(s));
+		return s;
+	}
+
+	int FakeBackend::thread_init() {
+		return 0;
+	}
+
+	void FakeBackend::thread_end() {}
+
+	MYSQL* FakeBackend::init(MYSQL* connection) {
+		static_assert(sizeof(MYSQL) >= sizeof(uint64_t) + sizeof(Session*), "MYSQL is too small to keep a session in");
+		if(connection == nullptr || session(connection)) {
+			return nullptr;
+		}
+		Session* s = new Session;
+		std::memcpy(connection, &magic, sizeof(magic));
+		std::memcpy(reinterpret_cast<char*>(connection) + sizeof(magic), &s, sizeof(s));
+		return connection;
+	}
+
+	void FakeBackend::close(MYSQL* connection) {
+		delete session(connection);
+		std::memset(connection, 0, sizeof(uint64_t) + sizeof(Session*));
+	}
+
+	unsigned int FakeBackend::error_number(MYSQL* connection) {
+		Session* s = session(connection);
+		return s ? s->error_number : 0;
+	}
+
+	char const* FakeBackend::error(MYSQL* connection) {
+		Session* s = session(connection);
+		return s ? s->error.c_str() : "";
+	}
+
+	int FakeBackend::options(MYSQL*, enum mysql_option, void const*) {
+		return 0;
+	}
+
+	MYSQL* FakeBackend::real_connect(MYSQL* connection, char const*, char const*, char const*, char const* database, unsigned int, char const*, unsigned long) {
+		Session* s = session(connection);
+		if(!s) {
+			return nullptr;
+		}
+		s->clear();
+		s->schema = database ? database : "";
+		boost::mutex::scoped_lock lock(mutex);
+		s->thread_id = next_thread_id++;
+		return connection;
+	}
+
+	int FakeBackend::ping(MYSQL* connection) {
+		Session* s = session(connection);
+		if(!s || s->thread_id == 0) {
+			return 1;
+		}
+		s->clear();
+		return 0;
+	}
+
+	int FakeBackend::real_query(MYSQL* connection, char const* query, unsigned long length) {
+		Session* s = session(connection);
+		std::string const q(query, length);
+		static std::string const kill = "KILL QUERY ";
+		if(q.compare(0, kill.size(), kill) == 0) {
+			static auto const nothing = std::make_shared<Table const>(Result());
+			s->last = nothing;
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				killed.insert(std::strtoul(q.c_str() + kill.size(), nullptr, 10));
+			}
+			killed_changed.notify_all();
+			++kills;
+			++statements;
+			return 0;
+		}
+
+		s->last = lookup(q, s->error);
+		if(!s->last) {
+			s->error_number = 1064;
+			return 1;
+		}
+		if(!stall_unless_killed(q, s->thread_id)) {
+			s->last = nullptr;
+			s->error_number = query_interrupted;
+			s->error = query_interrupted_message;
+			return 1;
+		}
+		++statements;
+		return 0;
+	}
+
+	void FakeBackend::set_local_infile_handler(
+		MYSQL*,
+		int (*)(void **, char const *, void *),
+		int (*)(void *, char *, unsigned int),
+		void (*)(void *),
+		int (*)(void *, char *, unsigned int),
+		void *
+	) {
+		// LOAD DATA LOCAL INFILE fails like any statement that wasn't scripted
+	}
+
+	unsigned int FakeBackend::field_count(MYSQL* connection) {
+		Session* s = session(connection);
+		return s->last ? (unsigned int)s->last->fields.size() : 0;
+	}
+
+	unsigned long long FakeBackend::insert_id(MYSQL* connection) {
+		Session* s = session(connection);
+		return s->last ? s->last->insert_id : 0;
+	}
+
+	unsigned long long FakeBackend::affected_rows(MYSQL* connection) {
+		Session* s = session(connection);
+		return s->last ? s->last->affected_rows : 0;
+	}
+
+	unsigned long FakeBackend::thread_id(MYSQL* connection) {
+		return session(connection)->thread_id;
+	}
+
+	int FakeBackend::select_db(MYSQL* connection, char const* database) {
+		session(connection)->schema = database;
+		return 0;
+	}
+
+	int FakeBackend::set_character_set(MYSQL* connection, char const* charset) {
+		session(connection)->charset = charset;
+		return 0;
+	}
+
+	char const* FakeBackend::character_set_name(MYSQL* connection) {
+		return session(connection)->charset.c_str();
+	}
+
+	int FakeBackend::reset_connection(MYSQL*) {
+		++resets;
+		return 0;
+	}
+
+	SessionChanges FakeBackend::session_track(MYSQL* connection) {
+		Session* s = session(connection);
+		return s->last ? s->last->session_changes : SessionChanges();
+	}
+
+	MYSQL_RES* FakeBackend::use_result(MYSQL* connection) {
+		Session* s = session(connection);
+		if(!s->last || s->last->fields.empty()) {
+			return nullptr;
+		}
+		auto *handle = new ResultHandle(s->last, true);
+		return &handle->result;
+	}
+
+	MYSQL_FIELD* FakeBackend::fetch_field(MYSQL_RES* result) {
+		auto &handle = ResultHandle::get(result);
+		if(handle.field >= handle.table->fields.size()) {
+			return nullptr;
+		}
+		return const_cast<MYSQL_FIELD*>(&handle.table->fields[handle.field++]);
+	}
+
+	MYSQL_FIELD_OFFSET FakeBackend::field_seek(MYSQL_RES* result, MYSQL_FIELD_OFFSET offset) {
+		auto &handle = ResultHandle::get(result);
+		MYSQL_FIELD_OFFSET const previous = MYSQL_FIELD_OFFSET(handle.field);
+		handle.field = offset;
+		return previous;
+	}
+
+	unsigned long* FakeBackend::fetch_lengths(MYSQL_RES* result) {
+		auto &handle = ResultHandle::get(result);
+		if(handle.next_row == 0 || handle.next_row > handle.table->rows.size()) {
+			return nullptr;
+		}
+		return const_cast<unsigned long*>(handle.table->lengths[handle.next_row - 1].data());
+	}
+
+	unsigned int FakeBackend::num_fields(MYSQL_RES* result) {
+		return (unsigned int)ResultHandle::get(result).table->fields.size();
+	}
+
+	MYSQL_ROW FakeBackend::fetch_row(MYSQL_RES* result) {
+		auto &handle = ResultHandle::get(result);
+		if(handle.next_row >= handle.table->rows.size()) {
+			handle.next_row = handle.table->rows.size() + 1;
+			return nullptr;
+		}
+		return const_cast<MYSQL_ROW>(handle.table->cells[handle.next_row++].data());
+	}
+
+	unsigned long long FakeBackend::num_rows(MYSQL_RES* result) {
+		auto &handle = ResultHandle::get(result);
+		return std::min(handle.next_row, handle.table->rows.size());
+	}
+
+	void FakeBackend::free_result(MYSQL_RES* result) {
+		delete &ResultHandle::get(result);
+	}
+
+	MYSQL_STMT* FakeBackend::stmt_init(MYSQL* connection) {
+		return &(new StatementHandle(connection))->statement;
+	}
+
+	unsigned int FakeBackend::stmt_errno(MYSQL_STMT* statement) {
+		return StatementHandle::get(statement).error_number;
+	}
+
+	char const* FakeBackend::stmt_error(MYSQL_STMT* statement) {
+		return StatementHandle::get(statement).error.c_str();
+	}
+
+	int FakeBackend::stmt_prepare(MYSQL_STMT* statement, char const* query, unsigned long length) {
+		auto &handle = StatementHandle::get(statement);
+		std::string const q(query, length);
+		handle.table = lookup(q, handle.error);
+		if(!handle.table) {
+			handle.error_number = 1064;
+			return 1;
+		}
+		handle.error_number = 0;
+		handle.error.clear();
+		handle.param_count = count_placeholders(q);
+		handle.query = q;
+		handle.executed = false;
+		return 0;
+	}
+
+	unsigned long FakeBackend::stmt_param_count(MYSQL_STMT* statement) {
+		return StatementHandle::get(statement).param_count;
+	}
+
+	unsigned int FakeBackend::stmt_field_count(MYSQL_STMT* statement) {
+		auto &handle = StatementHandle::get(statement);
+		return handle.table ? (unsigned int)handle.table->fields.size() : 0;
+	}
+
+	my_bool FakeBackend::stmt_bind_param(MYSQL_STMT* statement, MYSQL_BIND* binds) {
+		auto &handle = StatementHandle::get(statement);
+		handle.parameters.assign(binds, binds + handle.param_count);
+		return 0;
+	}
+
+	my_bool FakeBackend::stmt_bind_result(MYSQL_STMT* statement, MYSQL_BIND* binds) {
+		auto &handle = StatementHandle::get(statement);
+		handle.results.assign(binds, binds + stmt_field_count(statement));
+		return 0;
+	}
+
+	int FakeBackend::stmt_execute(MYSQL_STMT* statement) {
+		auto &handle = StatementHandle::get(statement);
+		if(!stall_unless_killed(handle.query, thread_id(handle.connection))) {
+			handle.executed = false;
+			handle.error_number = query_interrupted;
+			handle.error = query_interrupted_message;
+			return 1;
+		}
+		handle.error_number = 0;
+		handle.error.clear();
+		handle.executed = true;
+		handle.next_row = 0;
+		++statements;
+		return 0;
+	}
+
+	int FakeBackend::stmt_fetch(MYSQL_STMT* statement) {
+		auto &handle = StatementHandle::get(statement);
+		if(!handle.executed || handle.next_row >= handle.table->rows.size()) {
+			return MYSQL_NO_DATA;
+		}
+		++handle.next_row;
+		bool truncated = false;
+		for(size_t i = 0; i < handle.results.size(); ++i) {
+			truncated |= write(handle.results[i], handle.cell((unsigned int)i), 0);
+		}
+		return truncated ? MYSQL_DATA_TRUNCATED : 0;
+	}
+
+	int FakeBackend::stmt_fetch_column(MYSQL_STMT* statement, MYSQL_BIND* bind, unsigned int column, unsigned long offset) {
+		auto &handle = StatementHandle::get(statement);
+		if(!handle.executed || handle.next_row == 0 || handle.next_row > handle.table->rows.size()) {
+			handle.error_number = 2051;
+			handle.error = "Attempt to read column without prior row fetch";
+			return 1;
+		}
+		write(*bind, handle.cell(column), offset);
+		return 0;
+	}
+
+	int FakeBackend::stmt_store_result(MYSQL_STMT*) {
+		return 0;
+	}
+
+	my_bool FakeBackend::stmt_free_result(MYSQL_STMT* statement) {
+		auto &handle = StatementHandle::get(statement);
+		handle.executed = false;
+		return 0;
+	}
+
+	unsigned long long FakeBackend::stmt_num_rows(MYSQL_STMT* statement) {
+		auto &handle = StatementHandle::get(statement);
+		return handle.executed ? handle.table->rows.size() : 0;
+	}
+
+	unsigned long long FakeBackend::stmt_insert_id(MYSQL_STMT* statement) {
+		auto &handle = StatementHandle::get(statement);
+		return handle.table ? handle.table->insert_id : 0;
+	}
+
+	MYSQL_RES* FakeBackend::stmt_result_metadata(MYSQL_STMT* statement) {
+		auto &handle = StatementHandle::get(statement);
+		if(!handle.table || handle.table->fields.empty()) {
+			return nullptr;
+		}
+		return &(new ResultHandle(handle.table, false))->result;
+	}
+
+	my_bool FakeBackend::stmt_close(MYSQL_STMT* statement) {
+		delete &StatementHandle::get(statement);
+		return 0;
+	}
+}}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "backend.hpp"
+
+namespace rusql { namespace mysql {
+	//! A Backend without a server: every statement gets the result scripted for its exact text, served from
+	//! memory, through plain queries and prepared statements alike; anything else fails. Bound parameters are
+	//! accepted but not looked at. Meant for measuring and testing rusql's own overhead per row and per bind,
+	//! without a server's noise. Use it through BackendScope; it may be used from several threads at once.
+	struct FakeBackend : Backend {
+		typedef boost::optional<std::string> Value;
+
+		//! What a statement returns: rows of text like the text protocol has them, which prepared statements
+		//! convert to the types bound to them. No columns means a statement without a result set.
+		struct Result {
+			Result(std::vector<std::string> const& columns_ = std::vector<std::string>())
+			: columns(columns_)
+			, affected_rows(0)
+			, insert_id(0)
+			{}
+
+			//! Appends a row without NULLs.
+			Result& row(std::vector<std::string> const& values) {
+				rows.emplace_back(values.begin(), values.end());
+				return *this;
+			}
+
+			Result& row_with_nulls(std::vector<Value> const& values) {
+				rows.push_back(values);
+				return *this;
+			}
+
+			std::vector<std::string> columns;
+			//! Per column; columns without one are MYSQL_TYPE_VAR_STRING.
+			std::vector<enum_field_types> types;
+			std::vector<std::vector<Value>> rows;
+			unsigned long long affected_rows;
+			unsigned long long insert_id;
+			//! What session_track() reports after a plain query of it, as if the server tracked the session.
+			SessionChanges session_changes;
+		};
+
+		FakeBackend();
+		~FakeBackend();
+
+		//! What q returns from now on.
+		void script(std::string const& q, Result const& result);
+
+		//! Makes q fail with message from now on.
+		void script_error(std::string const& q, std::string const& message);
+
+		//! Makes the next count runs of q hang like on a busy server, until their connection is told to KILL QUERY
+		//! (which any connection takes, scripted or not) or timeout has passed. Killed ones fail with
+		//! ER_QUERY_INTERRUPTED; the others go on as scripted.
+		void stall(std::string const& q, size_t const count, boost::chrono::steady_clock::duration const timeout);
+
+		//! Statements run so far, plain queries and executions of prepared statements.
+		uint64_t number_of_statements() const {
+			return statements;
+		}
+
+		//! KILL QUERY statements run so far.
+		uint64_t number_of_kills() const {
+			return kills;
+		}
+
+		//! Calls of reset_connection() so far.
+		uint64_t number_of_resets() const {
+			return resets;
+		}
+
+		int thread_init() override;
+		void thread_end() override;
+
+		MYSQL* init(MYSQL* connection) override;
+		void close(MYSQL* connection) override;
+		unsigned int error_number(MYSQL* connection) override;
+		char const* error(MYSQL* connection) override;
+		int options(MYSQL* connection, enum mysql_option option, void const* value) override;
+		MYSQL* real_connect(MYSQL* connection, char const* host, char const* user, char const* password, char const* database, unsigned int port, char const* unix_socket, unsigned long client_flags) override;
+		int ping(MYSQL* connection) override;
+		int real_query(MYSQL* connection, char const* query, unsigned long length) override;
+		void set_local_infile_handler(
+			MYSQL* connection,
+			int (*local_infile_init)(void **, char const *, void *),
+			int (*local_infile_read)(void *, char *, unsigned int),
+			void (*local_infile_end)(void *),
+			int (*local_infile_error)(void *, char *, unsigned int),
+			void *userdata
+		) override;
+		unsigned int field_count(MYSQL* connection) override;
+		unsigned long long insert_id(MYSQL* connection) override;
+		unsigned long long affected_rows(MYSQL* connection) override;
+		unsigned long thread_id(MYSQL* connection) override;
+		int select_db(MYSQL* connection, char const* database) override;
+		int set_character_set(MYSQL* connection, char const* charset) override;
+		char const* character_set_name(MYSQL* connection) override;
+		int reset_connection(MYSQL* connection) override;
+		SessionChanges session_track(MYSQL* connection) override;
+
+		MYSQL_RES* use_result(MYSQL* connection) override;
+		MYSQL_FIELD* fetch_field(MYSQL_RES* result) override;
+		MYSQL_FIELD_OFFSET field_seek(MYSQL_RES* result, MYSQL_FIELD_OFFSET offset) override;
+		unsigned long* fetch_lengths(MYSQL_RES* result) override;
+		unsigned int num_fields(MYSQL_RES* result) override;
+		MYSQL_ROW fetch_row(MYSQL_RES* result) override;
+		unsigned long long num_rows(MYSQL_RES* result) override;
+		void free_result(MYSQL_RES* result) override;
+
+		MYSQL_STMT* stmt_init(MYSQL* connection) override;
+		unsigned int stmt_errno(MYSQL_STMT* statement) override;
+		char const* stmt_error(MYSQL_STMT* statement) override;
+		int stmt_prepare(MYSQL_STMT* statement, char const* query, unsigned long length) override;
+		unsigned long stmt_param_count(MYSQL_STMT* statement) override;
+		unsigned int stmt_field_count(MYSQL_STMT* statement) override;
+		my_bool stmt_bind_param(MYSQL_STMT* statement, MYSQL_BIND* binds) override;
+		my_bool stmt_bind_result(MYSQL_STMT* statement, MYSQL_BIND* binds) override;
+		int stmt_execute(MYSQL_STMT* statement) override;
+		int stmt_fetch(MYSQL_STMT* statement) override;
+		int stmt_fetch_column(MYSQL_STMT* statement, MYSQL_BIND* bind, unsigned int column, unsigned long offset) override;
+		int stmt_store_result(MYSQL_STMT* statement) override;
+		my_bool stmt_free_result(MYSQL_STMT* statement) override;
+		unsigned long long stmt_num_rows(MYSQL_STMT* statement) override;
+		unsigned long long stmt_insert_id(MYSQL_STMT* statement) override;
+		MYSQL_RES* stmt_result_metadata(MYSQL_STMT* statement) override;
+		my_bool stmt_close(MYSQL_STMT* statement) override;
+
+	private:
+		struct Table;
+		struct Session;
+		struct ResultHandle;
+		struct StatementHandle;
+
+		mutable boost::mutex mutex;
+		std::map<std::string, std::shared_ptr<Table const>> scripts;
+		unsigned long next_thread_id;
+		std::atomic<uint64_t> statements;
+
+		struct Stall {
+			size_t count;
+			boost::chrono::steady_clock::duration timeout;
+		};
+		std::map<std::string, Stall> stalls;
+		//! Connections told to KILL QUERY whose stalled statement hasn't noticed yet.
+		std::set<unsigned long> killed;
+		boost::condition_variable killed_changed;
+		std::atomic<uint64_t> kills;
+		std::atomic<uint64_t> resets;
+
+		//! The scripted table for q, or nullptr after setting error.
+		std::shared_ptr<Table const> lookup(std::string const& q, std::string& error);
+		//! Hangs if q is to stall; whether it may go on, i.e. wasn't killed.
+		bool stall_unless_killed(std::string const& q, unsigned long const thread_id);
+		//! Kept inside the MYSQL itself, so looking it up takes no lock; nullptr for connections that weren't
+		//! init()ed through this backend.
+		static Session* session(MYSQL* connection);
+	};
+}}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <string>
+
+#include "error_checked.hpp"
+
+namespace rusql { namespace mysql {
+	//! Feeds the data of a LOAD DATA LOCAL INFILE from a callback instead of a client-side file.
+	//! The file name in the query is ignored. Install it right before the query and refuse() right after.
+	//! Outside of such a load, every connection refuses LOCAL INFILE requests, so a server can never make the
+	//! client read one of its files.
+	struct LocalInfile {
+		//! Writes at most the given number of bytes into the buffer and returns how many it wrote; 0 means the end
+		//! of the data.
+		typedef std::function<size_t(char*, size_t)> Reader;
+
+		LocalInfile(Reader reader_)
+		: reader(reader_)
+		{}
+
+		Reader reader;
+		//! What the reader threw, if anything. The load fails with a generic error, rethrow this instead.
+		std::exception_ptr error;
+
+		void install(MYSQL* connection) {
+			rusql::mysql::set_local_infile_handler(connection, &init, &read, &end, &report, this);
+		}
+
+		static void refuse(MYSQL* connection) {
+			rusql::mysql::set_local_infile_handler(connection, &init, &read, &end, &report, nullptr);
+		}
+
+	private:
+		static int init(void **handle, char const *, void *userdata) {
+			*handle = userdata;
+			return userdata == nullptr ? 1 : 0;
+		}
+
+		static int read(void *handle, char *buffer, unsigned int length) {
+			auto *self = static_cast<LocalInfile*>(handle);
+			if(self == nullptr) {
+				return -1;
+			}
+			try {
+				return int(self->reader(buffer, length));
+			} catch(...) {
+				self->error = std::current_exception();
+				return -1;
+			}
+		}
+
+		static void end(void *) {
+		}
+
+		static int report(void *handle, char *message, unsigned int length) {
+			std::string const text = handle == nullptr
+				? "LOAD DATA LOCAL INFILE is only allowed through bulk_load()"
+				: "reading bulk load data failed";
+			std::strncpy(message, text.c_str(), length);
+			message[length - 1] = 0;
+			return 2000; // CR_UNKNOWN_ERROR
+		}
+	};
+}}
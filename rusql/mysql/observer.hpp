@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <mysql.h>
+
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "allocations.hpp"
+
+namespace rusql { namespace mysql {
+	//! The stages a statement goes through, each reported as one QueryEvent.
+	enum class QueryStage {
+		//! Getting a connection from a Database's pool, including waiting for one. Has no SQL text.
+		Acquire,
+		//! Running a plain text statement.
+		Query,
+		Prepare,
+		//! Executing a prepared statement.
+		Execute,
+		//! Fetching one row of a prepared statement.
+		Fetch,
+		//! Fetching one row of a plain text statement.
+		FetchRow,
+		//! Closing the result of a plain text statement, which reads whatever rows were left.
+		Close,
+	};
+
+	struct QueryEvent {
+		typedef boost::chrono::steady_clock Clock;
+
+		QueryStage stage;
+		Clock::time_point start;
+		Clock::duration duration;
+		//! The statement's text; empty when it ran before the observer was installed.
+		std::string const& sql;
+		//! The server's id for the connection, as in SHOW PROCESSLIST.
+		unsigned long connection_id;
+		//! For Fetch and FetchRow: whether there was a row, rather than the end of the result.
+		bool row;
+		//! For Fetch and FetchRow: the length of the row's values together, as the server sent them.
+		unsigned long long bytes;
+		//! Whether the stage ended by an exception.
+		bool failed;
+		//! Heap allocations made by the stage, and their size together; zero unless the program links
+		//! rusql_count_allocations, see allocations.hpp.
+		uint64_t allocations;
+		uint64_t allocated_bytes;
+		//! For Execute: the parameters the statement was executed with, pointing at the caller's values; only
+		//! valid during on_event().
+		MYSQL_BIND const* parameters;
+		size_t number_of_parameters;
+	};
+
+	//! Receives an event for every stage of every statement on the connections it's installed on, on the thread
+	//! that ran it, right after the stage ended. Events of one connection come in order. on_event() may be
+	//! called from several threads at once, for Acquire while the Database's pool is locked, so keep it short;
+	//! it must not throw.
+	struct QueryObserver {
+		virtual ~QueryObserver() {}
+		virtual void on_event(QueryEvent const& event) = 0;
+	};
+
+	//! Where connections find their observer: one per Database, shared with its connections. Each of them looks
+	//! it up through a CachedObserver of its own, which holds on to the observer it found; a replaced observer
+	//! lives on until every one of those has seen the change, or is gone.
+	struct ObserverSlot : boost::noncopyable {
+		ObserverSlot()
+		: generation(0)
+		{}
+
+		//! Changes with every set().
+		uint64_t get_generation() const {
+			return generation.load(std::memory_order_acquire);
+		}
+
+		std::shared_ptr<QueryObserver> get() const {
+			boost::mutex::scoped_lock lock(mutex);
+			return observer;
+		}
+
+		//! Installs observer_; nullptr for none.
+		void set(std::shared_ptr<QueryObserver> const& observer_) {
+			boost::mutex::scoped_lock lock(mutex);
+			observer = observer_;
+			generation.fetch_add(1, std::memory_order_release);
+		}
+
+	private:
+		std::atomic<uint64_t> generation;
+		mutable boost::mutex mutex;
+		std::shared_ptr<QueryObserver> observer;
+	};
+
+	//! A reference to the observer of an ObserverSlot, taken anew only when the slot changed, so that while it
+	//! doesn't, looking it up costs a single check. Not thread safe, and a lookup lets go of the previous
+	//! observer: give every connection one of its own, whose stages don't overlap.
+	struct CachedObserver {
+		CachedObserver()
+		: slot(nullptr)
+		, generation(0)
+		{}
+
+		std::shared_ptr<QueryObserver> const& get(ObserverSlot const& slot_) {
+			uint64_t const now = slot_.get_generation();
+			if(&slot_ != slot || now != generation) {
+				// a set() in between is seen the next time
+				observer = slot_.get();
+				slot = &slot_;
+				generation = now;
+			}
+			return observer;
+		}
+
+	private:
+		ObserverSlot const* slot;
+		uint64_t generation;
+		std::shared_ptr<QueryObserver> observer;
+	};
+
+	//! Passes every event to two observers, to first before second.
+	struct ObserverPair : QueryObserver {
+		ObserverPair(std::shared_ptr<QueryObserver> const& first_, std::shared_ptr<QueryObserver> const& second_)
+		: first(first_)
+		, second(second_)
+		{}
+
+		void on_event(QueryEvent const& event) override {
+			first->on_event(event);
+			second->on_event(event);
+		}
+
+	private:
+		std::shared_ptr<QueryObserver> const first;
+		std::shared_ptr<QueryObserver> const second;
+	};
+
+	//! Times one stage and reports it to an observer once finish() is called, or as failed if it goes away
+	//! before that, through an exception.
+	struct ObservedStage : boost::noncopyable {
+		ObservedStage(QueryObserver& observer_, QueryStage const stage_, std::string const& sql_, unsigned long const connection_id_)
+		: observer(observer_)
+		, stage(stage_)
+		, sql(sql_)
+		, connection_id(connection_id_)
+		, start(QueryEvent::Clock::now())
+		, allocations_at_start(thread_allocations())
+		, parameters(nullptr)
+		, number_of_parameters(0)
+		, reported(false)
+		{}
+
+		~ObservedStage() {
+			if(!reported) {
+				report(false, 0, true);
+			}
+		}
+
+		void finish(bool const row = false, unsigned long long const bytes = 0) {
+			report(row, bytes, false);
+		}
+
+		//! Sets the parameters of an Execute.
+		void set_parameters(MYSQL_BIND const* const parameters_, size_t const number_of_parameters_) {
+			parameters = parameters_;
+			number_of_parameters = number_of_parameters_;
+		}
+
+		//! Sets the connection id, for stages that only know it at the end.
+		void set_connection_id(unsigned long const connection_id_) {
+			connection_id = connection_id_;
+		}
+
+	private:
+		QueryObserver& observer;
+		QueryStage const stage;
+		std::string const& sql;
+		unsigned long connection_id;
+		QueryEvent::Clock::time_point const start;
+		AllocationCount const allocations_at_start;
+		MYSQL_BIND const* parameters;
+		size_t number_of_parameters;
+		bool reported;
+
+		void report(bool const row, unsigned long long const bytes, bool const failed) {
+			reported = true;
+			auto const duration = QueryEvent::Clock::now() - start;
+			AllocationCount const allocated = allocations_since(allocations_at_start);
+			QueryEvent const event = {stage, start, duration, sql, connection_id, row, bytes, failed, allocated.allocations, allocated.bytes, parameters, number_of_parameters};
+			observer.on_event(event);
+		}
+	};
+}}
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <boost/noncopyable.hpp>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 #include <iostream>
 #include <memory>
 
+#include "connection.hpp"
 #include "error_checked.hpp"
+#include "observer.hpp"
 #include "type_traits.hpp"
 
 inline std::ostream &operator<<(std::ostream &os, MYSQL_BIND const &b) {
@@ -71,6 +75,9 @@ namespace rusql { namespace mysql {
 
 		// Memory for all possible row contents:
 		std::map<std::string, rusql::mysql::field::type::Column> auto_binds;
+
+		//! The prepared text, for the observer's events. Only kept while observed.
+		std::string sql;
 		
 		Statement(Connection& connection_, std::string const query)
 		: connection(connection_)
@@ -85,6 +92,7 @@ namespace rusql { namespace mysql {
 		, parameters(std::move(x.parameters))
 		, output_parameters(std::move(x.output_parameters))
 		, output_helpers(std::move(x.output_helpers))
+		, sql(std::move(x.sql))
 		{
 			x.statement = nullptr;
 		}
@@ -101,7 +109,7 @@ namespace rusql { namespace mysql {
 		}
 		
 		inline void check_and_throw(std::string const & function) {
-			char const * const error = mysql_stmt_error(statement);
+			char const * const error = backend().stmt_error(statement);
 			if(error[0]){
 				throw SQLError(function, error);
 			}
@@ -129,6 +137,27 @@ namespace rusql { namespace mysql {
 			bind_append();
 		}
 
+		//! Bind a vector of rows as one flat parameter list, all elements of the first tuple first. This is the
+		//! shape of a multi-row INSERT ... VALUES (?, ?), (?, ?). Resets already bound parameters first.
+		template <typename... T>
+		void bind(std::vector<std::tuple<T...>> const & rows) {
+			reset_bind();
+			for(auto const &row : rows) {
+				bind_tuple(row);
+			}
+			bind_append();
+		}
+
+		template <size_t I = 0, typename... T>
+		typename std::enable_if<I == sizeof...(T)>::type bind_tuple(std::tuple<T...> const &) {
+		}
+
+		template <size_t I = 0, typename... T>
+		typename std::enable_if<(I < sizeof...(T))>::type bind_tuple(std::tuple<T...> const & row) {
+			bind_parameter(std::get<I>(row));
+			bind_tuple<I + 1>(row);
+		}
+
 		//! Bind parameters. Resets already bound parameters first.
 		template <typename... Args>
 		void bind(Args const &... args) {
@@ -136,6 +165,13 @@ namespace rusql { namespace mysql {
 			bind_append(args ...);
 		}
 
+		//! Bind parameters made by get_mysql_bind(), e.g. of types only known at runtime. Resets already bound
+		//! parameters first. The values they point to must stay alive until execute().
+		void bind_binds(std::vector<MYSQL_BIND> const& binds) {
+			parameters = binds;
+			bind_append();
+		}
+
 		//! Call bind_append to bind parameters without clearing already bound ones.
 		//! Use regular bind() if you do want to reset the currently bound parameters.
 		template<typename T, typename... Tail>
@@ -182,6 +218,17 @@ namespace rusql { namespace mysql {
 			bind_results_append(args ...);
 		}
 
+		//! Bind every element of a vector as a result column, in order. Resets already bound parameters first.
+		//! The vector must not be resized while it is bound.
+		template <typename T>
+		void bind_results(std::vector<T>& args) {
+			reset_result_bind();
+			for(T &t : args) {
+				bind_result_element(t);
+			}
+			bind_results_append();
+		}
+
 		//! Bind new parameters without resetting already bound parameters first.
 		template <typename T, typename ... Tail>
 		void bind_results_append(T& v, Tail& ... tail){
@@ -199,7 +246,15 @@ namespace rusql { namespace mysql {
 		}
 		
 		int prepare(std::string const q){
-			auto res = rusql::mysql::stmt_prepare(statement, q);
+			int res;
+			if(QueryObserver* const observer = connection.observer()) {
+				sql = q;
+				ObservedStage stage(*observer, QueryStage::Prepare, sql, connection.thread_id());
+				res = rusql::mysql::stmt_prepare(statement, q);
+				stage.finish();
+			} else {
+				res = rusql::mysql::stmt_prepare(statement, q);
+			}
 			reset_bind();
 			reset_result_bind();
 			return res;
@@ -226,6 +281,24 @@ namespace rusql { namespace mysql {
 		}
 
 		int fetch(){
+			QueryObserver* const observer = connection.observer();
+			if(observer == nullptr) {
+				return fetch_unobserved();
+			}
+			ObservedStage stage(*observer, QueryStage::Fetch, sql, connection.thread_id());
+			int const res = fetch_unobserved();
+			unsigned long long bytes = 0;
+			if(res != MYSQL_NO_DATA) {
+				for(auto const &helper : output_helpers) {
+					bytes += helper.is_null ? 0 : helper.field_length;
+				}
+			}
+			stage.finish(res != MYSQL_NO_DATA, bytes);
+			return res;
+		}
+
+		//! fetch() without telling the observer.
+		int fetch_unobserved(){
 			int res = rusql::mysql::stmt_fetch(statement);
 			if(res != MYSQL_NO_DATA) {
 				// post-process the bind results
@@ -239,7 +312,15 @@ namespace rusql { namespace mysql {
 		}
 		
 		int execute(){
-			return rusql::mysql::stmt_execute(statement);
+			QueryObserver* const observer = connection.observer();
+			if(observer == nullptr) {
+				return rusql::mysql::stmt_execute(statement);
+			}
+			ObservedStage stage(*observer, QueryStage::Execute, sql, connection.thread_id());
+			stage.set_parameters(parameters.data(), parameters.size());
+			int const res = rusql::mysql::stmt_execute(statement);
+			stage.finish();
+			return res;
 		}
 
 		unsigned long long insert_id() {
@@ -256,6 +337,11 @@ namespace rusql { namespace mysql {
 			return rusql::mysql::stmt_num_rows(statement);
 		}
 
+		//! Discards the current result set, so the connection can be used for something else.
+		void free_result() {
+			rusql::mysql::stmt_free_result(statement);
+		}
+
 		my_bool close(){
 			auto const result = rusql::mysql::stmt_close(statement);
 			statement = nullptr;
@@ -266,6 +352,17 @@ namespace rusql { namespace mysql {
 			return std::shared_ptr<MYSQL_RES>(rusql::mysql::stmt_result_metadata(statement), rusql::mysql::free_result);
 		}
 
+		//! Names of the result columns, in order. Can only be called after
+		//! execute().
+		std::vector<std::string> column_names() {
+			auto mysql_res = result_metadata();
+			std::vector<std::string> names;
+			while(MYSQL_FIELD *field = rusql::mysql::fetch_field(mysql_res.get())) {
+				names.emplace_back(field->name);
+			}
+			return names;
+		}
+
 		//! Get the column number of a column by name. Can only be called
 		//! after execute().
 		int column_number(std::string name) {
@@ -324,9 +421,11 @@ namespace rusql { namespace mysql {
 			}
 		};
 
+		//! Binds every result column to a value of its own type, for get(). Only the result binds are replaced;
+		//! the parameters stay bound, so the statement can be executed with them again.
 		void bind_all_self() {
 			auto_binds.clear();
-			reset_bind();
+			reset_result_bind();
 
 			auto mysql_res = result_metadata();
 			while(MYSQL_FIELD *field = rusql::mysql::fetch_field(mysql_res.get())) {
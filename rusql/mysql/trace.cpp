@@ -0,0 +1,233 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+#include <boost/thread/mutex.hpp>
+
+namespace rusql { namespace mysql {
+	//! A thread's last calls. Only its own thread writes; dump_trace() reads it from any other, which is why
+	//! every field is atomic.
+	struct TraceRing : boost::noncopyable {
+		TraceRing(uint32_t const thread_)
+		: thread(thread_)
+		, head(0)
+		, cleared(0)
+		, ended(false)
+		, pending_error(0)
+		{}
+
+		struct Slot {
+			std::atomic<uint64_t> start;
+			std::atomic<uint64_t> duration;
+			//! The call in the upper half, the error number in the lower.
+			std::atomic<uint64_t> call_and_error;
+		};
+
+		uint32_t const thread;
+		//! Number of calls recorded so far; call i is in slots[i % trace_capacity].
+		std::atomic<uint64_t> head;
+		//! Calls before this one were cleared.
+		std::atomic<uint64_t> cleared;
+		std::atomic<bool> ended;
+		//! Of the call in progress; only touched by the ring's own thread.
+		unsigned int pending_error;
+		Slot slots[trace_capacity];
+	};
+
+	namespace {
+		std::atomic<bool> tracing(true);
+
+		//! Ticks and time at the first traced call, to turn ticks into time with.
+		struct Epoch {
+			Epoch()
+			: ticks(trace_ticks())
+			, time(boost::chrono::steady_clock::now())
+			{}
+
+			uint64_t const ticks;
+			boost::chrono::steady_clock::time_point const time;
+		};
+
+		Epoch const& epoch() {
+			static Epoch const epoch_;
+			return epoch_;
+		}
+
+		struct Registry {
+			Registry()
+			: next_thread(1)
+			{}
+
+			boost::mutex mutex;
+			std::deque<std::shared_ptr<TraceRing>> rings;
+			uint32_t next_thread;
+
+			std::shared_ptr<TraceRing> add() {
+				epoch();
+				boost::mutex::scoped_lock lock(mutex);
+				// keep the rings of the last threads that ended, for threads that come and go
+				size_t ended = 0;
+				for(size_t i = rings.size(); i > 0; --i) {
+					if(rings[i - 1]->ended && ++ended > 64) {
+						rings.erase(rings.begin() + std::ptrdiff_t(i - 1));
+					}
+				}
+				rings.push_back(std::make_shared<TraceRing>(next_thread++));
+				return rings.back();
+			}
+
+			std::vector<std::shared_ptr<TraceRing>> all() {
+				boost::mutex::scoped_lock lock(mutex);
+				return std::vector<std::shared_ptr<TraceRing>>(rings.begin(), rings.end());
+			}
+		};
+
+		Registry& registry() {
+			static Registry registry_;
+			return registry_;
+		}
+
+		//! Owns the ring of a thread and marks it ended when the thread ends; the registry keeps it a while.
+		struct ThreadRing {
+			~ThreadRing() {
+				if(ring) {
+					ring->ended = true;
+				}
+			}
+
+			std::shared_ptr<TraceRing> ring;
+		};
+
+		ThreadRing& thread_ring() {
+			static thread_local ThreadRing ring;
+			return ring;
+		}
+	}
+
+	char const* traced_call_name(TracedCall const call) {
+		static char const* const names[] = {
+		#define RUSQL_TRACED_CALL(name) #name,
+			RUSQL_TRACED_CALLS(RUSQL_TRACED_CALL)
+		#undef RUSQL_TRACED_CALL
+		};
+		size_t const index = size_t(call);
+		return index < sizeof(names) / sizeof(names[0]) ? names[index] : "unknown";
+	}
+
+	void set_tracing(bool const enabled) {
+		tracing.store(enabled, std::memory_order_relaxed);
+	}
+
+	bool is_tracing() {
+		return tracing.load(std::memory_order_relaxed);
+	}
+
+	TraceRing* this_thread_ring() {
+		if(!tracing.load(std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		auto &local = thread_ring();
+		if(!local.ring) {
+			local.ring = registry().add();
+		}
+		return local.ring.get();
+	}
+
+	void trace_record(TraceRing& ring, TracedCall const call, uint64_t const start, uint64_t const end) {
+		uint64_t const index = ring.head.load(std::memory_order_relaxed);
+		auto &slot = ring.slots[index % trace_capacity];
+		// A reader that sees any of the stores below also sees head at index, so it knows this slot is being
+		// overwritten; see dump_trace()
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.start.store(start, std::memory_order_relaxed);
+		slot.duration.store(end - start, std::memory_order_relaxed);
+		slot.call_and_error.store(uint64_t(call) << 32 | ring.pending_error, std::memory_order_relaxed);
+		ring.pending_error = 0;
+		ring.head.store(index + 1, std::memory_order_release);
+	}
+
+	void note_trace_error(unsigned int const error_number) {
+		if(auto const ring = thread_ring().ring.get()) {
+			ring->pending_error = error_number;
+		}
+	}
+
+	std::vector<TraceEvent> dump_trace() {
+		auto const rings = registry().all();
+
+		// microseconds per tick, measured since the first traced call
+		double us_per_tick = 1e-3;
+		uint64_t const now_ticks = trace_ticks();
+		auto const now = boost::chrono::steady_clock::now();
+		if(now_ticks > epoch().ticks) {
+			us_per_tick = boost::chrono::duration<double, boost::micro>(now - epoch().time).count() / double(now_ticks - epoch().ticks);
+		}
+
+		std::vector<TraceEvent> events;
+		for(auto const &ring : rings) {
+			// a thread that ended won't overwrite anything
+			bool const ended = ring->ended.load(std::memory_order_acquire);
+			uint64_t const head = ring->head.load(std::memory_order_acquire);
+			uint64_t const first = std::max(head > trace_capacity ? head - trace_capacity : 0, ring->cleared.load(std::memory_order_relaxed));
+			size_t const begin = events.size();
+			for(uint64_t i = first; i < head; ++i) {
+				auto const &slot = ring->slots[i % trace_capacity];
+				uint64_t const start = slot.start.load(std::memory_order_relaxed);
+				uint64_t const duration = slot.duration.load(std::memory_order_relaxed);
+				uint64_t const call_and_error = slot.call_and_error.load(std::memory_order_relaxed);
+				TraceEvent const event = {
+					TracedCall(call_and_error >> 32),
+					ring->thread,
+					double(int64_t(start - epoch().ticks)) * us_per_tick,
+					double(duration) * us_per_tick,
+					unsigned(call_and_error & 0xffffffff),
+				};
+				events.push_back(event);
+			}
+			// Whatever the thread recorded meanwhile may have overwritten the oldest calls we copied; the slot of
+			// call i is only written while head is at i + trace_capacity or beyond
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t const after = ring->head.load(std::memory_order_relaxed);
+			if(!ended && after >= trace_capacity) {
+				uint64_t const valid = after - trace_capacity + 1;
+				if(valid > first) {
+					size_t const overwritten = size_t(std::min(valid, head) - first);
+					events.erase(events.begin() + std::ptrdiff_t(begin), events.begin() + std::ptrdiff_t(begin + overwritten));
+				}
+			}
+		}
+		std::stable_sort(events.begin(), events.end(), [](TraceEvent const& a, TraceEvent const& b) {
+			return a.start_us < b.start_us;
+		});
+		return events;
+	}
+
+	void clear_trace() {
+		for(auto const &ring : registry().all()) {
+			ring->cleared.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+		}
+	}
+
+	void write_chrome_trace(std::ostream& os, std::vector<TraceEvent> const& events) {
+		std::ostringstream out;
+		out << std::fixed << std::setprecision(3);
+		out << "{\"traceEvents\":[";
+		bool first = true;
+		for(auto const &event : events) {
+			out << (first ? "\n" : ",\n");
+			first = false;
+			out << "{\"name\":\"" << traced_call_name(event.call) << "\",\"cat\":\"mysql\",\"ph\":\"X\",\"pid\":1"
+				<< ",\"tid\":" << event.thread
+				<< ",\"ts\":" << event.start_us
+				<< ",\"dur\":" << event.duration_us
+				<< ",\"args\":{\"errno\":" << event.error_number << "}}";
+		}
+		out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+		os << out.str();
+	}
+}}
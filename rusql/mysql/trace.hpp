@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//! \file trace.hpp A flight recorder for the calls into the MySQL client library: the functions of
+//! error_checked.hpp record their duration and error into a ring buffer of the calling thread, which costs two
+//! timestamps and a few stores per call and takes no lock. When something was slow, dump_trace() gets the last
+//! calls of every thread and write_chrome_trace() turns them into something to look at. Accessors that only
+//! read what the client library already has, like num_fields or insert_id, aren't traced: they take less time
+//! than the timestamps.
+
+namespace rusql { namespace mysql {
+	#define RUSQL_TRACED_CALLS(X) \
+		X(thread_init) X(thread_end) X(init) X(close) X(ping) X(use_result) X(stmt_init) X(connect) X(query) \
+		X(options) X(set_local_infile_handler) X(free_result) X(fetch_row) X(select_db) X(set_character_set) \
+		X(reset_connection) X(session_track) X(stmt_bind_param) X(stmt_bind_result) X(stmt_fetch_column) \
+		X(stmt_close) X(stmt_prepare) X(stmt_store_result) X(stmt_free_result) X(stmt_execute) X(stmt_fetch) \
+		X(stmt_result_metadata)
+
+	//! The traced functions of error_checked.hpp.
+	enum class TracedCall : uint32_t {
+	#define RUSQL_TRACED_CALL(name) name,
+		RUSQL_TRACED_CALLS(RUSQL_TRACED_CALL)
+	#undef RUSQL_TRACED_CALL
+	};
+
+	char const* traced_call_name(TracedCall const call);
+
+	//! How many of its last calls each thread keeps.
+	size_t const trace_capacity = 4096;
+
+	//! One traced call.
+	struct TraceEvent {
+		TracedCall call;
+		//! Threads are numbered from 1, in the order of their first traced call.
+		uint32_t thread;
+		//! Since the first traced call of the process.
+		double start_us;
+		double duration_us;
+		//! The MySQL error number the call threw for, 0 if it didn't.
+		unsigned int error_number;
+	};
+
+	//! Switches tracing on or off for all threads; it is on unless switched off.
+	void set_tracing(bool const enabled);
+	bool is_tracing();
+
+	//! The last trace_capacity calls of every thread, including those of the last 64 threads that ended,
+	//! ordered by start. Can be called at any time from any thread; calls that are overwritten while it runs
+	//! are left out.
+	std::vector<TraceEvent> dump_trace();
+
+	//! Forgets the calls traced so far.
+	void clear_trace();
+
+	//! Writes events in the Trace Event Format, which chrome://tracing and ui.perfetto.dev open: one complete
+	//! event per call, with a thread per rusql thread number.
+	void write_chrome_trace(std::ostream& os, std::vector<TraceEvent> const& events);
+
+	//! The time stamp counter where there is one, which takes a few cycles to read; steady_clock otherwise.
+	//! dump_trace() turns ticks into time.
+	inline uint64_t trace_ticks() {
+	#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+	#else
+		return uint64_t(boost::chrono::duration_cast<boost::chrono::nanoseconds>(boost::chrono::steady_clock::now().time_since_epoch()).count());
+	#endif
+	}
+
+	struct TraceRing;
+
+	//! The calling thread's ring, made on its first call; nullptr while tracing is off.
+	TraceRing* this_thread_ring();
+
+	void trace_record(TraceRing& ring, TracedCall const call, uint64_t const start, uint64_t const end);
+
+	//! Notes the error the current traced call is about to throw for.
+	void note_trace_error(unsigned int const error_number);
+
+	//! Traces the call it lives in.
+	struct TraceScope : boost::noncopyable {
+		TraceScope(TracedCall const call_)
+		: ring(this_thread_ring())
+		, call(call_)
+		, start(ring == nullptr ? 0 : trace_ticks())
+		{}
+
+		~TraceScope() {
+			if(ring != nullptr) {
+				trace_record(*ring, call, start, trace_ticks());
+			}
+		}
+
+	private:
+		TraceRing* const ring;
+		TracedCall const call;
+		uint64_t const start;
+	};
+}}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <string>
+#include <cstring>
 #include <functional>
 
+#include <boost/lexical_cast.hpp>
 #include <boost/optional.hpp>
 #include <boost/variant.hpp>
 
@@ -271,6 +273,58 @@ namespace rusql { namespace mysql {
 			};
 		}
 
+		//! Appends a value as a cell of a LOAD DATA INFILE in its default format: tab-separated, escaped with
+		//! backslashes, \N for NULL. The caller writes the separators.
+		namespace text {
+			struct Number {
+				template <typename T>
+				static void append(std::string& out, T const& x) {
+					out += boost::lexical_cast<std::string>(x);
+				}
+			};
+
+			struct String {
+				static void append(std::string& out, char const* x, size_t const length) {
+					for(size_t i = 0; i < length; ++i) {
+						switch(x[i]) {
+						case '\\':  out += "\\\\"; break;
+						case '\t':  out += "\\t"; break;
+						case '\n':  out += "\\n"; break;
+						case '\r':  out += "\\r"; break;
+						case '\0':  out += "\\0"; break;
+						default:    out += x[i]; break;
+						}
+					}
+				}
+
+				static void append(std::string& out, std::string const& x) {
+					append(out, x.data(), x.size());
+				}
+
+				static void append(std::string& out, char const* x) {
+					append(out, x, std::strlen(x));
+				}
+			};
+
+			struct Optional {
+				template <typename T>
+				static void append(std::string& out, boost::optional<T> const& x) {
+					if(x) {
+						type_traits<T>::text::append(out, *x);
+					} else {
+						out += "\\N";
+					}
+				}
+			};
+
+			struct Null {
+				template <typename T>
+				static void append(std::string& out, T const&) {
+					out += "\\N";
+				}
+			};
+		}
+
 		namespace post_processors {
 			struct Optional;
 			struct String;
@@ -281,7 +335,8 @@ namespace rusql { namespace mysql {
 	struct NoProcessing { typedef field::post_processors::CheckNullPostProcessing output_processor; };
 	struct Primitive : NoProcessing
 	                    { typedef field::buffer::Primitive data;
-	                      typedef data output_data; };
+	                      typedef data output_data;
+	                      typedef field::text::Number text; };
 	struct Fixed        { typedef field::length::Fixed length; };
 	struct Unsigned     { typedef field::is_unsigned::Yes is_unsigned; };
 	struct Signed       { typedef field::is_unsigned::No is_unsigned; };
@@ -337,6 +392,7 @@ namespace rusql { namespace mysql {
 		typedef field::buffer::Null output_data;
 		typedef field::length::String length;
 		typedef field::post_processors::String output_processor;
+		typedef field::text::String text;
 	};
 	
 	template <typename T>
@@ -349,6 +405,7 @@ namespace rusql { namespace mysql {
 		typedef field::length::Optional length;
 		typedef field::is_unsigned::Optional is_unsigned;
 		typedef field::post_processors::Optional output_processor;
+		typedef field::text::Optional text;
 	};
 	
 	template <size_t size>
@@ -358,6 +415,7 @@ namespace rusql { namespace mysql {
 		typedef field::buffer::CharPointer data;
 		typedef data output_data;
 		typedef field::length::String length;
+		typedef field::text::String text;
 	};
 	
 	template <>
@@ -367,6 +425,7 @@ namespace rusql { namespace mysql {
 		typedef field::buffer::CharPointer data;
 		typedef data output_data;
 		typedef field::length::String length;
+		typedef field::text::String text;
 	};
 	
 	template <>
@@ -376,6 +435,7 @@ namespace rusql { namespace mysql {
 		typedef field::buffer::CharPointer data;
 		typedef data output_data;
 		typedef field::length::String length;
+		typedef field::text::String text;
 	};
 	
 	template <>
@@ -385,5 +445,6 @@ namespace rusql { namespace mysql {
 		typedef field::buffer::Null data;
 		typedef data output_data;
 		typedef field::length::Fixed length;
+		typedef field::text::Null text;
 	};
 }}
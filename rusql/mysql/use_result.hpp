@@ -1,6 +1,8 @@
 #pragma once
 
+#include "connection.hpp"
 #include "error_checked.hpp"
+#include "observer.hpp"
 
 #include <boost/lexical_cast.hpp>
 
@@ -58,11 +60,22 @@ namespace rusql { namespace mysql {
 		//! Closes and frees the set.
 		void close(){
 			assert(result != nullptr);
+			QueryObserver* const observer = connection->observer();
+			if(observer == nullptr) {
+				drain_and_free();
+				return;
+			}
+			ObservedStage stage(*observer, QueryStage::Close, connection->last_query, connection->thread_id());
+			drain_and_free();
+			stage.finish();
+		}
+
+		void drain_and_free(){
 			// MySQL use_result documentation says "you must
 			// execute mysql_fetch_row() until a NULL value is
 			// returned, otherwise, the unfetched rows are returned
 			// as part of the result set for your next query."
-			while(fetch_row() != nullptr);
+			while(fetch_row_unobserved() != nullptr);
 			rusql::mysql::free_result(result);
 			result = nullptr;
 		}
@@ -142,6 +155,25 @@ namespace rusql { namespace mysql {
 		}
 		
 		MYSQL_ROW fetch_row() {
+			QueryObserver* const observer = connection->observer();
+			if(observer == nullptr) {
+				return fetch_row_unobserved();
+			}
+			ObservedStage stage(*observer, QueryStage::FetchRow, connection->last_query, connection->thread_id());
+			fetch_row_unobserved();
+			unsigned long long bytes = 0;
+			if(current_row != nullptr) {
+				unsigned long const* const lengths = rusql::mysql::fetch_lengths(result);
+				for(unsigned int i = 0, n = rusql::mysql::num_fields(result); i < n; ++i) {
+					bytes += lengths[i];
+				}
+			}
+			stage.finish(current_row != nullptr, bytes);
+			return current_row;
+		}
+
+		//! fetch_row() without telling the observer.
+		MYSQL_ROW fetch_row_unobserved() {
 			current_row = rusql::mysql::fetch_row(&connection->database, result);
 			
 			// Output the fetched row.
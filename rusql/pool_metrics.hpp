@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/optional.hpp>
+
+#include "adaptive_pool.hpp"
+#include "admission.hpp"
+
+namespace rusql {
+	//! The state of a Database's connection pool at one moment; see Database::get_pool_metrics(). Counters count
+	//! from the Database's construction.
+	struct PoolMetrics {
+		typedef boost::chrono::steady_clock Clock;
+
+		size_t connections;
+		size_t idle;
+		size_t busy;
+		//! The most connections the pool will open now; 0 for no limit.
+		size_t limit;
+		//! Requests running right now.
+		size_t in_flight;
+		size_t waiting_interactive;
+		size_t waiting_batch;
+		//! Requests that failed with PoolOverloaded.
+		uint64_t rejected;
+
+		uint64_t connections_created;
+		//! Closed because the adaptive pool shrank.
+		uint64_t connections_closed;
+		uint64_t reconnects;
+
+		uint64_t statement_cache_hits;
+		uint64_t statement_cache_misses;
+
+		//! Connections handed out by the pool, and how long getting them took, waiting included.
+		uint64_t checkouts;
+		Clock::duration checkout_wait_total;
+		//! For each upper bound, the checkouts that took less than that long, in whole microseconds. The bounds
+		//! are the powers of two from 128 microseconds to about 17 seconds, where the buckets of LatencyHistogram
+		//! end, so none of them is approximated.
+		std::vector<std::pair<Clock::duration, uint64_t>> checkout_wait_buckets;
+
+		CircuitBreaker::State circuit_state;
+		//! The adaptive pool's last decision, if it made any.
+		boost::optional<PoolSizeDecision> last_pool_size_decision;
+
+		double statement_cache_hit_rate() const {
+			uint64_t const lookups = statement_cache_hits + statement_cache_misses;
+			return lookups == 0 ? 0.0 : double(statement_cache_hits) / double(lookups);
+		}
+	};
+
+	//! Renders metrics in the Prometheus text exposition format, every name starting with prefix.
+	inline std::string to_prometheus(PoolMetrics const& metrics, std::string const& prefix = "rusql_pool") {
+		auto const seconds = [](PoolMetrics::Clock::duration const d) {
+			return boost::chrono::duration<double>(d).count();
+		};
+
+		std::ostringstream out;
+		out << std::setprecision(9);
+		auto const metric = [&](std::string const& name, char const* type, char const* help) {
+			out << "# HELP " << prefix << "_" << name << " " << help << "\n";
+			out << "# TYPE " << prefix << "_" << name << " " << type << "\n";
+		};
+		auto const value = [&](std::string const& name, std::string const& labels, double const x) {
+			out << prefix << "_" << name << labels << " " << x << "\n";
+		};
+		auto const gauge = [&](std::string const& name, char const* help, double const x) {
+			metric(name, "gauge", help);
+			value(name, "", x);
+		};
+		auto const counter = [&](std::string const& name, char const* help, double const x) {
+			metric(name, "counter", help);
+			value(name, "", x);
+		};
+
+		gauge("connections", "Connections in the pool.", double(metrics.connections));
+		metric("connections_by_state", "gauge", "Connections in the pool that are idle or busy.");
+		value("connections_by_state", "{state=\"idle\"}", double(metrics.idle));
+		value("connections_by_state", "{state=\"busy\"}", double(metrics.busy));
+		gauge("limit", "The most connections the pool will open now; 0 for no limit.", double(metrics.limit));
+		gauge("in_flight", "Requests running.", double(metrics.in_flight));
+		metric("waiting", "gauge", "Requests waiting for a connection.");
+		value("waiting", "{priority=\"interactive\"}", double(metrics.waiting_interactive));
+		value("waiting", "{priority=\"batch\"}", double(metrics.waiting_batch));
+		counter("rejected_total", "Requests rejected because the pool was overloaded.", double(metrics.rejected));
+
+		counter("connections_created_total", "Connections opened by the pool.", double(metrics.connections_created));
+		counter("connections_closed_total", "Connections closed because the pool shrank.", double(metrics.connections_closed));
+		counter("reconnects_total", "Connections that were connected again.", double(metrics.reconnects));
+
+		metric("statement_cache_lookups_total", "counter", "Lookups in the connections' prepared statement caches.");
+		value("statement_cache_lookups_total", "{result=\"hit\"}", double(metrics.statement_cache_hits));
+		value("statement_cache_lookups_total", "{result=\"miss\"}", double(metrics.statement_cache_misses));
+
+		metric("checkout_wait_seconds", "histogram", "Time taken to get a connection from the pool.");
+		for(auto const &bucket : metrics.checkout_wait_buckets) {
+			std::ostringstream le;
+			le << std::setprecision(9) << seconds(bucket.first);
+			value("checkout_wait_seconds_bucket", "{le=\"" + le.str() + "\"}", double(bucket.second));
+		}
+		value("checkout_wait_seconds_bucket", "{le=\"+Inf\"}", double(metrics.checkouts));
+		value("checkout_wait_seconds_sum", "", seconds(metrics.checkout_wait_total));
+		value("checkout_wait_seconds_count", "", double(metrics.checkouts));
+
+		metric("circuit_state", "gauge", "The circuit breaker's state: 1 for the current one.");
+		value("circuit_state", "{state=\"closed\"}", metrics.circuit_state == CircuitBreaker::State::Closed ? 1 : 0);
+		value("circuit_state", "{state=\"open\"}", metrics.circuit_state == CircuitBreaker::State::Open ? 1 : 0);
+		value("circuit_state", "{state=\"half_open\"}", metrics.circuit_state == CircuitBreaker::State::HalfOpen ? 1 : 0);
+
+		if(metrics.last_pool_size_decision) {
+			auto const &decision = *metrics.last_pool_size_decision;
+			gauge("adaptive_latency_seconds", "Mean latency in the adaptive pool's last interval.", seconds(decision.latency));
+			gauge("adaptive_baseline_latency_seconds", "The adaptive pool's long-term baseline latency.", seconds(decision.baseline_latency));
+			gauge("adaptive_gradient", "Baseline over current latency in the adaptive pool's last decision.", decision.gradient);
+		}
+		return out.str();
+	}
+}
@@ -7,15 +7,26 @@
 #include <boost/variant.hpp>
 
 #include "mysql/mysql.hpp"
+#include "cancellation.hpp"
 #include "token.hpp"
+#include "row_iterator.hpp"
 
 namespace rusql {
+	struct Connection;
+
 	struct PreparedStatement {
-		PreparedStatement (rusql::mysql::Statement&& statement_)
+		PreparedStatement (rusql::mysql::Statement&& statement_, Connection* connection_ = nullptr)
 		: token(std::make_shared<Token>())
 		, statement (std::move(statement_))
+		, connection (connection_)
 		{}
 
+		PreparedStatement(PreparedStatement&&) = default;
+		PreparedStatement& operator=(PreparedStatement&&) = default;
+
+		//! Gives a connection whose session it changed back to the pool clean; see Connection::release_session().
+		~PreparedStatement();
+
 		template <typename T>
 		PreparedStatement execute(std::vector<T> const &args) {
 			bind_parameters(args);
@@ -33,6 +44,18 @@ namespace rusql {
 			return std::move(*this);
 		}
 
+		//! Executes, but stops the statement when the deadline passes or the token is cancelled, throwing a
+		//! QueryInterrupted. Only running the statement is covered, not fetching its rows afterwards.
+		PreparedStatement&& execute(Interruption const& interruption);
+
+		PreparedStatement&& execute(Deadline const& deadline) {
+			return execute(Interruption(deadline));
+		}
+
+		PreparedStatement&& execute(CancellationToken const& cancellation) {
+			return execute(Interruption(cancellation));
+		}
+
 	public:
 		//! Makes all result rows available for named retrieval. Replaces a
 		//! call to bind_results(), i.e. you can choose to call either but
@@ -61,10 +84,32 @@ namespace rusql {
 			return statement.statement == nullptr;
 		}
 
+		typedef RowIterator<PreparedStatement> iterator;
+
+		//! Fetches the first row and iterates over all rows, e.g. for(auto& row : statement). Bind the results
+		//! (bind_results() or bind_all_self()) before calling this; every step is a fetch().
+		iterator begin() {
+			return iterator(fetch() ? this : nullptr);
+		}
+
+		iterator end() {
+			return iterator();
+		}
+
 		unsigned long long insert_id() {
 			return statement.insert_id();
 		}
 
+		//! Number of result columns; 0 for statements that don't return rows.
+		size_t field_count() {
+			return statement.field_count();
+		}
+
+		//! Names of the result columns, in order. Can only be called after execute().
+		std::vector<std::string> column_names() {
+			return statement.column_names();
+		}
+
 		void store_result() {
 			statement.store_result();
 		}
@@ -75,6 +120,11 @@ namespace rusql {
 			return statement.num_rows();
 		}
 
+		//! Discards the rows that were not fetched yet. The statement can be executed again afterwards.
+		void free_result() {
+			statement.free_result();
+		}
+
 		template <typename ... T>
 		PreparedStatement& bind_parameters(T const& ... values) {
 			statement.bind(values ... );
@@ -87,6 +137,13 @@ namespace rusql {
 			return *this;
 		}
 
+		//! Binds parameters made by mysql::get_mysql_bind(), e.g. of types only known at runtime; see
+		//! mysql::Statement::bind_binds().
+		PreparedStatement& bind_parameter_binds(std::vector<MYSQL_BIND> const& binds) {
+			statement.bind_binds(binds);
+			return *this;
+		}
+
 		template <typename ... T>
 		PreparedStatement& bind_parameters_append(T const& ... values) {
 			statement.bind_append(values ...);
@@ -99,6 +156,13 @@ namespace rusql {
 			return *this;
 		}
 
+		//! Binds every element of the vector as a result column. The vector must not be resized while bound.
+		template <typename T>
+		PreparedStatement& bind_results(std::vector<T> &results) {
+			statement.bind_results(results);
+			return *this;
+		}
+
 		template <typename ... T>
 		PreparedStatement & bind_results_append(T& ... results) {
 			statement.bind_results_append(results ...);
@@ -113,5 +177,12 @@ namespace rusql {
 	private:
 		std::shared_ptr<Token> token;
 		rusql::mysql::Statement statement;
+		//! The connection it was prepared on, if known; needed to interrupt it.
+		Connection* connection;
 };
+
+	//! Fetches the next row of a PreparedStatement, returns whether there was one. Used by RowIterator.
+	inline bool next_row(PreparedStatement& statement) {
+		return statement.fetch();
+	}
 }
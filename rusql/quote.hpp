@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+namespace rusql {
+	//! Quotes a table, column or savepoint name for use in a query.
+	inline std::string quote_identifier(std::string const& name) {
+		std::string quoted = "`";
+		for(char c : name) {
+			quoted += c;
+			if(c == '`') {
+				quoted += '`';
+			}
+		}
+		return quoted + "`";
+	}
+
+	//! Quotes text as a string literal for use in a query. Backslashes are escaped too, which assumes the
+	//! sql_mode doesn't have NO_BACKSLASH_ESCAPES; prefer binding parameters where the server allows them.
+	inline std::string quote_string(std::string const& text) {
+		std::string quoted = "'";
+		for(char c : text) {
+			if(c == '\'' || c == '\\') {
+				quoted += c;
+			}
+			quoted += c;
+		}
+		return quoted + "'";
+	}
+}
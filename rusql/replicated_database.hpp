@@ -0,0 +1,460 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <exception>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "database.hpp"
+#include "histogram.hpp"
+#include "materialized_result.hpp"
+#include "statement_statistics.hpp"
+
+namespace rusql {
+	//! Whether a statement only reads, so it can be sent to a replica. Locking reads (FOR UPDATE, FOR SHARE and LOCK
+	//! IN SHARE MODE, with or without NOWAIT or SKIP LOCKED) count as writes: they only make sense on the primary.
+	inline bool is_read_only(std::string const& q) {
+		// upper case, with every run of whitespace made one space
+		std::string upper;
+		upper.reserve(q.size());
+		for(char c : q) {
+			if(std::isspace(static_cast<unsigned char>(c))) {
+				if(!upper.empty() && upper.back() == ' ') {
+					continue;
+				}
+				c = ' ';
+			}
+			upper += char(std::toupper(static_cast<unsigned char>(c)));
+		}
+
+		size_t const start = upper.find_first_not_of(" (");
+		if(start == std::string::npos) {
+			return false;
+		}
+		static char const * const read_keywords[] = {"SELECT", "SHOW", "DESCRIBE", "DESC", "EXPLAIN"};
+		bool read = false;
+		for(char const *keyword : read_keywords) {
+			std::string const k = keyword;
+			if(upper.compare(start, k.size(), k) == 0 && (start + k.size() == upper.size() || !std::isalnum(static_cast<unsigned char>(upper[start + k.size()])))) {
+				read = true;
+				break;
+			}
+		}
+		if(!read) {
+			return false;
+		}
+		for(char const *locking : {"FOR UPDATE", "FOR SHARE", "LOCK IN SHARE MODE"}) {
+			if(upper.find(locking) != std::string::npos) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//! When hedged_select() sends a second copy of a read to another replica.
+	struct HedgePolicy {
+		typedef boost::chrono::steady_clock Clock;
+
+		HedgePolicy()
+		: percentile(0.95)
+		, minimum_delay(boost::chrono::milliseconds(1))
+		, initial_delay(boost::chrono::milliseconds(50))
+		, minimum_samples(100)
+		, window(10000)
+		, max_statements(1000)
+		{}
+
+		//! Hedge a query once it has taken longer than this fraction of its earlier runs.
+		double percentile;
+		//! Never hedge sooner than this, however fast the query usually is.
+		Clock::duration minimum_delay;
+		//! The delay used until a query has minimum_samples latencies recorded.
+		Clock::duration initial_delay;
+		size_t minimum_samples;
+		//! Once a query has this many samples, they are halved, so the threshold follows recent behaviour.
+		size_t window;
+		//! Latencies are kept per fingerprint (see fingerprint()), for this many of them; statements beyond that
+		//! share one set of latencies.
+		size_t max_statements;
+	};
+
+	//! A primary server plus any number of replicas, each with its own connection pool. Writes go to the primary;
+	//! select_query() and read-only statements go to the replica with the fewest requests in flight from this
+	//! process, or to the primary when there are no replicas.
+	//!
+	//! For read-your-writes, run related statements through a Session: after it wrote something, its reads go to
+	//! the primary for the configured stickiness period, so they don't miss the write on a lagging replica.
+	struct ReplicatedDatabase : boost::noncopyable {
+		typedef boost::chrono::steady_clock Clock;
+
+		ReplicatedDatabase(Database::ConstructionInfo const& primary_, std::vector<Database::ConstructionInfo> const& replicas_, Clock::duration const sticky_after_write_ = boost::chrono::seconds(0))
+		: primary(std::make_shared<Database>(primary_))
+		, sticky_after_write(sticky_after_write_)
+		, next_replica(0)
+		, hedges(0)
+		{
+			for(auto const &info : replicas_) {
+				replicas.emplace_back(std::make_shared<Replica>(info));
+			}
+		}
+
+		//! Routes statements like ReplicatedDatabase does, but sends reads to the primary for a while after this
+		//! session wrote something.
+		struct Session {
+			Session(ReplicatedDatabase& database_)
+			: database(database_)
+			, wrote(false)
+			{}
+
+			ResultSet select_query(std::string const q) {
+				if(is_read_only(q)) {
+					return reads_from_primary() ? database.primary->select_query(q) : database.select_query(q);
+				}
+				note_write();
+				return database.primary->select_query(q);
+			}
+
+			void query(std::string const q) {
+				note_write();
+				database.query(q);
+			}
+
+			PreparedStatement prepare(std::string const q) {
+				if(is_read_only(q)) {
+					return reads_from_primary() ? database.primary->prepare(q) : database.prepare(q);
+				}
+				note_write();
+				return database.primary->prepare(q);
+			}
+
+			template <typename ... T>
+			PreparedStatement execute(std::string const q, T const& ... args) {
+				PreparedStatement s = prepare(q);
+				return s.execute(args ...);
+			}
+
+		private:
+			ReplicatedDatabase& database;
+			bool wrote;
+			Clock::time_point last_write;
+
+			void note_write() {
+				wrote = true;
+				last_write = Clock::now();
+			}
+
+			bool reads_from_primary() const {
+				return wrote && Clock::now() - last_write < database.sticky_after_write;
+			}
+		};
+
+		Session session() {
+			return Session(*this);
+		}
+
+		ResultSet select_query(std::string const q) {
+			auto replica = is_read_only(q) ? pick_replica() : nullptr;
+			if(!replica) {
+				return primary->select_query(q);
+			}
+			ResultSet result = replica->database->select_query(q);
+			hold_in_flight(result.get_token(), replica);
+			return result;
+		}
+
+		void query(std::string const q) {
+			primary->query(q);
+		}
+
+		PreparedStatement prepare(std::string const q) {
+			if(is_read_only(q)) {
+				auto replica = pick_replica();
+				if(replica) {
+					PreparedStatement statement = replica->database->prepare(q);
+					hold_in_flight(statement.get_token(), replica);
+					return statement;
+				}
+			}
+			return primary->prepare(q);
+		}
+
+		template <typename ... T>
+		PreparedStatement execute(std::string const q, T const& ... args) {
+			PreparedStatement s = prepare(q);
+			return s.execute(args ...);
+		}
+
+		template <typename T>
+		PreparedStatement execute(std::string const q, std::vector<T> const &args) {
+			PreparedStatement s = prepare(q);
+			return s.execute(args);
+		}
+
+		//! Runs a read-only statement on a replica and returns all its rows. If that replica has not answered when
+		//! the query's hedge delay has passed (see HedgePolicy), the statement is sent to a second replica too. The
+		//! first answer is returned and the other replica is told to KILL QUERY, freeing its worker and connection.
+		//! Only use this for reads that can safely run twice.
+		template <typename ... T>
+		MaterializedResult hedged_select(std::string const q, T const& ... args) {
+			if(!is_read_only(q)) {
+				throw mysql::SQLError("hedged_select() only runs read-only statements: " + q);
+			}
+
+			auto first = pick_replica();
+			if(!first) {
+				return primary->async_execute(q, args ...).get();
+			}
+
+			auto latency = latency_for(q);
+			auto race = std::make_shared<HedgeRace>();
+			boost::mutex::scoped_lock lock(race->mutex);
+			start_attempt(race, first, latency, q, args ...);
+			if(!race->finished_wait(lock, hedge_delay(*latency)) && replicas.size() > 1) {
+				++hedges;
+				start_attempt(race, pick_replica(first), latency, q, args ...);
+			}
+			race->finished_wait(lock);
+
+			// whoever lost is still running; stop it
+			for(auto const &attempt : race->attempts) {
+				if(attempt.running) {
+					try {
+						attempt.database->query("KILL QUERY " + boost::lexical_cast<std::string>(attempt.thread_id));
+					} catch(mysql::SQLError&) {
+						// it finished in the meantime, or we may not kill; either way it will end by itself
+					}
+				}
+			}
+
+			if(race->result) {
+				return std::move(*race->result);
+			}
+			std::rethrow_exception(race->error);
+		}
+
+		void set_hedge_policy(HedgePolicy const& policy) {
+			boost::mutex::scoped_lock lock(latencies_mutex);
+			hedge_policy = policy;
+		}
+
+		//! How long hedged_select() currently waits for q before it sends it to a second replica.
+		Clock::duration hedge_delay(std::string const& q) {
+			return hedge_delay(*latency_for(q));
+		}
+
+		//! How many times hedged_select() sent a statement to a second replica.
+		unsigned long long number_of_hedges() const {
+			return hedges;
+		}
+
+		std::shared_ptr<Database> get_primary() const {
+			return primary;
+		}
+
+		size_t number_of_replicas() const {
+			return replicas.size();
+		}
+
+		std::shared_ptr<Database> get_replica(size_t const index) const {
+			return replicas.at(index)->database;
+		}
+
+		ThreadHandle get_thread_handle() {
+			return ThreadHandle();
+		}
+
+	private:
+		struct Replica {
+			Replica(Database::ConstructionInfo const& info)
+			: database(std::make_shared<Database>(info))
+			, in_flight(std::make_shared<std::atomic<int>>(0))
+			{}
+
+			std::shared_ptr<Database> database;
+			//! Shared with the requests it counts, which may outlive the replica. They mustn't hold the replica
+			//! itself: the last one to go could then destroy its Database from one of that Database's own workers.
+			std::shared_ptr<std::atomic<int>> in_flight;
+		};
+
+		//! Counts a request against a replica for as long as it is being sent and answered.
+		struct InFlight : boost::noncopyable {
+			InFlight(std::shared_ptr<std::atomic<int>> counter_)
+			: counter(counter_)
+			{
+				++*counter;
+			}
+
+			~InFlight() {
+				--*counter;
+			}
+
+			std::shared_ptr<std::atomic<int>> counter;
+		};
+
+		//! Counts a request against replica until the ResultSet or PreparedStatement with token is gone, as its
+		//! rows are still to be fetched or it is still to run.
+		static void hold_in_flight(std::weak_ptr<Token> const& token, std::shared_ptr<Replica> const& replica) {
+			if(auto t = token.lock()) {
+				t->held.push_back(std::make_shared<InFlight>(replica->in_flight));
+			}
+		}
+
+		//! The attempts of one hedged_select(); the first one to finish successfully wins.
+		struct HedgeRace {
+			HedgeRace()
+			: failures(0)
+			{}
+
+			struct Attempt {
+				//! Not owned, for the same reason as Replica::in_flight; only hedged_select() uses it, while the
+				//! replica exists.
+				Database* database;
+				//! The server thread running the statement, valid while running.
+				unsigned long thread_id;
+				bool running;
+			};
+
+			boost::mutex mutex;
+			boost::condition_variable finished;
+			std::vector<Attempt> attempts;
+			boost::optional<MaterializedResult> result;
+			std::exception_ptr error;
+			size_t failures;
+
+			bool is_decided() const {
+				return result || failures == attempts.size();
+			}
+
+			//! Waits until there is a result or every attempt failed, at most for timeout. Returns whether it's decided.
+			bool finished_wait(boost::mutex::scoped_lock& lock, Clock::duration const timeout) {
+				return finished.wait_for(lock, timeout, [this]() { return is_decided(); });
+			}
+
+			void finished_wait(boost::mutex::scoped_lock& lock) {
+				finished.wait(lock, [this]() { return is_decided(); });
+			}
+		};
+
+		//! Submits one attempt to the replica's workers. The caller holds race->mutex.
+		template <typename ... T>
+		void start_attempt(std::shared_ptr<HedgeRace> race, std::shared_ptr<Replica> replica, std::shared_ptr<LatencyHistogram> latency, std::string const& q, T const& ... args) {
+			size_t const index = race->attempts.size();
+			race->attempts.push_back(HedgeRace::Attempt{replica->database.get(), 0, false});
+			size_t const window = hedge_window();
+			auto const counter = replica->in_flight;
+			replica->database->submit([race, counter, latency, window, index, q, args ...](Connection& connection) {
+				InFlight in_flight(counter);
+				{
+					boost::mutex::scoped_lock lock(race->mutex);
+					if(race->is_decided()) {
+						// the other attempt already won while this one was queued
+						++race->failures;
+						return;
+					}
+					race->attempts[index].thread_id = connection.thread_id();
+					race->attempts[index].running = true;
+				}
+
+				auto const start = Clock::now();
+				try {
+					MaterializedResult result;
+					{
+						PreparedStatement statement = connection.execute(q, args ...);
+						result = materialize(statement);
+					}
+					latency->record(Clock::now() - start);
+					if(latency->count() > window) {
+						latency->decay();
+					}
+
+					boost::mutex::scoped_lock lock(race->mutex);
+					race->attempts[index].running = false;
+					if(!race->result) {
+						race->result = std::move(result);
+					}
+					race->finished.notify_all();
+				} catch(...) {
+					boost::mutex::scoped_lock lock(race->mutex);
+					race->attempts[index].running = false;
+					if(!race->error) {
+						race->error = std::current_exception();
+					}
+					++race->failures;
+					race->finished.notify_all();
+				}
+			});
+		}
+
+		std::shared_ptr<LatencyHistogram> latency_for(std::string const& q) {
+			std::string const shape = fingerprint(q);
+			boost::mutex::scoped_lock lock(latencies_mutex);
+			auto it = latencies.find(shape);
+			if(it == latencies.end()) {
+				if(latencies.size() >= hedge_policy.max_statements) {
+					if(!other_latencies) {
+						other_latencies = std::make_shared<LatencyHistogram>();
+					}
+					return other_latencies;
+				}
+				it = latencies.emplace(shape, std::make_shared<LatencyHistogram>()).first;
+			}
+			return it->second;
+		}
+
+		Clock::duration hedge_delay(LatencyHistogram const& latency) {
+			boost::mutex::scoped_lock lock(latencies_mutex);
+			if(latency.count() < hedge_policy.minimum_samples) {
+				return hedge_policy.initial_delay;
+			}
+			return std::max(hedge_policy.minimum_delay, latency.percentile(hedge_policy.percentile));
+		}
+
+		size_t hedge_window() {
+			boost::mutex::scoped_lock lock(latencies_mutex);
+			return hedge_policy.window;
+		}
+
+		std::shared_ptr<Database> primary;
+		std::vector<std::shared_ptr<Replica>> replicas;
+		Clock::duration const sticky_after_write;
+		//! Rotates the starting point of the search, so ties are spread over the replicas.
+		std::atomic<unsigned> next_replica;
+
+		//! Per fingerprint latencies of hedged_select(), and the policy that turns them into hedge delays.
+		std::map<std::string, std::shared_ptr<LatencyHistogram>> latencies;
+		//! Of the statements beyond hedge_policy.max_statements.
+		std::shared_ptr<LatencyHistogram> other_latencies;
+		HedgePolicy hedge_policy;
+		boost::mutex latencies_mutex;
+		std::atomic<unsigned long long> hedges;
+
+		//! The least busy replica other than excluded, or nullptr if there is none.
+		std::shared_ptr<Replica> pick_replica(std::shared_ptr<Replica> const& excluded = nullptr) {
+			if(replicas.empty()) {
+				return nullptr;
+			}
+			size_t const start = next_replica++ % replicas.size();
+			std::shared_ptr<Replica> best;
+			for(size_t i = 0; i < replicas.size(); ++i) {
+				auto const &candidate = replicas[(start + i) % replicas.size()];
+				if(candidate == excluded) {
+					continue;
+				}
+				if(!best || *candidate->in_flight < *best->in_flight) {
+					best = candidate;
+				}
+			}
+			return best;
+		}
+	};
+}
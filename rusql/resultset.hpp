@@ -6,6 +6,7 @@
 
 #include "mysql/mysql.hpp"
 #include "token.hpp"
+#include "row_iterator.hpp"
 
 namespace rusql {
 
@@ -93,6 +94,17 @@ struct Connection;
 		unsigned long long num_rows() {
 			return data.num_rows();
 		}
+
+		typedef RowIterator<ResultSet> iterator;
+
+		//! Iterates over the remaining rows, starting at the current one, e.g. for(auto& row : db->select_query(q)).
+		iterator begin() {
+			return iterator(is_closed() ? nullptr : this);
+		}
+
+		iterator end() {
+			return iterator();
+		}
 		
 		//! Returns a weak pointer that will expire if the ResultSet is released (goes out of scope, or release() is called.
 		//! Note that this doesn't reflect if the resultset is still valid (due to underlying software). Use is_valid() for check that.
@@ -104,4 +116,10 @@ struct Connection;
 		rusql::mysql::UseResult data;
 		std::shared_ptr<Token> token;
 	};
+
+	//! Moves a ResultSet to its next row, returns whether there was one. Used by RowIterator.
+	inline bool next_row(ResultSet& set) {
+		set.next();
+		return !set.is_closed();
+	}
 }
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+
+namespace rusql {
+	//! Input iterator over the rows of a ResultSet or PreparedStatement, so they can be used in a range-based for.
+	//! Dereferencing gives the source itself, positioned at the current row; read the row through it as usual
+	//! (get<T>() on a ResultSet, or the variables bound with bind_results() on a PreparedStatement).
+	//! Advancing calls next_row() on the source, which must return false once there are no rows left.
+	template <typename Source>
+	struct RowIterator {
+		typedef std::input_iterator_tag iterator_category;
+		typedef Source value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef Source* pointer;
+		typedef Source& reference;
+
+		//! Constructs the end iterator, or an iterator at the row the source is currently positioned on.
+		explicit RowIterator(Source* source_ = nullptr)
+		: source(source_)
+		{}
+
+		Source& operator*() const {
+			return *source;
+		}
+
+		Source* operator->() const {
+			return source;
+		}
+
+		RowIterator& operator++() {
+			if(!next_row(*source)) {
+				source = nullptr;
+			}
+			return *this;
+		}
+
+		void operator++(int) {
+			++*this;
+		}
+
+		bool operator==(RowIterator const& x) const {
+			return source == x.source;
+		}
+
+		bool operator!=(RowIterator const& x) const {
+			return source != x.source;
+		}
+
+	private:
+		Source* source;
+	};
+}
@@ -1,3 +1,8 @@
 #pragma once
 
-#include "database.hpp"
\ No newline at end of file
+#include "database.hpp"
+#include "batch_loader.hpp"
+#include "insert_coalescer.hpp"
+#include "replicated_database.hpp"
+#include "sharded_database.hpp"
+#include "statement_statistics.hpp"
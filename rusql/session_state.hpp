@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mysql/mysql.hpp"
+#include "quote.hpp"
+
+namespace rusql {
+	//! What a Connection knows about its session: the system variables set through it, the default database and
+	//! the character set. Names are kept in lower case.
+	struct SessionState {
+		SessionState()
+		: unknown(false)
+		{}
+
+		//! Variable name to value, as text.
+		std::map<std::string, std::string> variables;
+		std::string schema;
+		std::string charset;
+		//! Something changed the session in a way that couldn't be followed, e.g. a SET statement the server
+		//! didn't report.
+		bool unknown;
+
+		bool operator==(SessionState const& x) const {
+			return !unknown && !x.unknown && variables == x.variables && schema == x.schema && charset == x.charset;
+		}
+
+		bool operator!=(SessionState const& x) const {
+			return !(*this == x);
+		}
+	};
+
+	inline std::string to_lower(std::string s) {
+		std::transform(s.begin(), s.end(), s.begin(), [](char c) { return char(std::tolower(static_cast<unsigned char>(c))); });
+		return s;
+	}
+
+	//! Throws unless name can be put into a query as is: letters, digits and underscores only.
+	inline std::string const& check_variable_name(std::string const& name) {
+		if(name.empty() || !std::all_of(name.begin(), name.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; })) {
+			throw mysql::SQLError("Not a valid session variable name: " + name);
+		}
+		return name;
+	}
+
+	//! How a value is remembered by SessionState.
+	inline std::string session_text(std::string const& value) {
+		return value;
+	}
+
+	inline std::string session_text(char const* value) {
+		return value;
+	}
+
+	template <typename T>
+	std::string session_text(T const& value) {
+		std::ostringstream s;
+		s << value;
+		return s.str();
+	}
+
+	//! A remembered value as a literal for SET: numbers as they are, as integer variables refuse strings, and
+	//! anything else quoted.
+	inline std::string session_literal(std::string const& text) {
+		size_t i = !text.empty() && text[0] == '-' ? 1 : 0;
+		size_t digits = 0;
+		bool point = false;
+		for(; i < text.size(); ++i) {
+			if(std::isdigit(static_cast<unsigned char>(text[i]))) {
+				++digits;
+			} else if(text[i] == '.' && !point) {
+				point = true;
+			} else {
+				break;
+			}
+		}
+		return i == text.size() && digits != 0 ? text : quote_string(text);
+	}
+
+	//! How a statement run as plain text may change the session.
+	struct SessionStatement {
+		enum Kind {
+			//! Leaves the session alone, as far as SessionState is concerned.
+			None,
+			//! SET of a session system variable, SET NAMES or SET CHARACTER SET.
+			Set,
+			//! USE; schema is the database it switches to.
+			Use,
+		};
+
+		Kind kind;
+		std::string schema;
+		//! For Set, the session variables it assigns, in lower case; SET NAMES and SET CHARACTER SET count as
+		//! character_set_client, and assignments that can't be made sense of as their text. User variables and
+		//! global ones are left out.
+		std::vector<std::string> variables;
+
+		//! Only looks at the start of q, so it's cheap enough to run for every statement.
+		static SessionStatement classify(std::string const& q) {
+			SessionStatement result;
+			result.kind = None;
+
+			size_t i = skip_space(q, 0);
+			if(starts_with_word(q, i, "set")) {
+				i = skip_space(q, i + 3);
+				// SET TRANSACTION only lasts until the next transaction; SET PASSWORD isn't session state
+				if(!starts_with_word(q, i, "transaction") && !starts_with_word(q, i, "password")) {
+					result.variables = assigned_variables(q, i);
+					result.kind = result.variables.empty() ? None : Set;
+				}
+			} else if(starts_with_word(q, i, "use")) {
+				result.kind = Use;
+				i = skip_space(q, i + 3);
+				if(i < q.size() && q[i] == '`') {
+					for(++i; i < q.size(); ++i) {
+						if(q[i] == '`') {
+							if(i + 1 < q.size() && q[i + 1] == '`') {
+								++i;
+							} else {
+								break;
+							}
+						}
+						result.schema += q[i];
+					}
+				} else {
+					for(; i < q.size() && !std::isspace(static_cast<unsigned char>(q[i])) && q[i] != ';'; ++i) {
+						result.schema += q[i];
+					}
+				}
+			}
+			return result;
+		}
+
+	private:
+		//! The session variables of the assignments of a SET that start at i.
+		static std::vector<std::string> assigned_variables(std::string const& q, size_t i) {
+			std::vector<std::string> names;
+			while(true) {
+				i = skip_space(q, i);
+				size_t const start = i;
+				bool global = false;
+				bool user = false;
+				if(starts_with_word(q, i, "names") || starts_with_word(q, i, "charset") || starts_with_word(q, i, "character")) {
+					names.push_back("character_set_client");
+				} else {
+					if(q.compare(i, 2, "@@") == 0) {
+						i += 2;
+						for(char const* const scope : {"session.", "local.", "global.", "persist.", "persist_only."}) {
+							std::string const prefix = scope;
+							if(to_lower(q.substr(i, prefix.size())) == prefix) {
+								global = prefix != "session." && prefix != "local.";
+								i += prefix.size();
+								break;
+							}
+						}
+					} else if(i < q.size() && q[i] == '@') {
+						user = true;
+					} else {
+						for(char const* const scope : {"session", "local", "global", "persist", "persist_only"}) {
+							if(starts_with_word(q, i, scope)) {
+								global = std::string(scope) != "session" && std::string(scope) != "local";
+								i = skip_space(q, i + std::strlen(scope));
+								break;
+							}
+						}
+					}
+
+					size_t const name_start = i;
+					while(i < q.size() && (std::isalnum(static_cast<unsigned char>(q[i])) || q[i] == '_' || q[i] == '$' || q[i] == '.')) {
+						++i;
+					}
+					std::string const name = to_lower(q.substr(name_start, i - name_start));
+					size_t const assign = skip_space(q, i);
+					bool const assigns = assign < q.size() && (q[assign] == '=' || q.compare(assign, 2, ":=") == 0);
+					if(!assigns || name.empty()) {
+						names.push_back(q.substr(start, assign - start));
+					} else if(!global && !user) {
+						names.push_back(name);
+					}
+				}
+
+				// on to the next assignment, past any quotes and parentheses in the value
+				char quote = 0;
+				int depth = 0;
+				for(; i < q.size(); ++i) {
+					char const c = q[i];
+					if(quote) {
+						if(c == '\\') {
+							++i;
+						} else if(c == quote) {
+							quote = 0;
+						}
+					} else if(c == '\'' || c == '"' || c == '`') {
+						quote = c;
+					} else if(c == '(') {
+						++depth;
+					} else if(c == ')') {
+						--depth;
+					} else if((c == ',' && depth == 0) || c == ';') {
+						break;
+					}
+				}
+				if(i >= q.size() || q[i] == ';') {
+					return names;
+				}
+				++i;
+			}
+		}
+
+		static size_t skip_space(std::string const& q, size_t i) {
+			while(i < q.size() && std::isspace(static_cast<unsigned char>(q[i]))) {
+				++i;
+			}
+			return i;
+		}
+
+		static bool starts_with_word(std::string const& q, size_t const i, std::string const& word) {
+			if(q.size() - std::min(i, q.size()) < word.size() || to_lower(q.substr(i, word.size())) != word) {
+				return false;
+			}
+			size_t const end = i + word.size();
+			return end == q.size() || !(std::isalnum(static_cast<unsigned char>(q[end])) || q[end] == '_');
+		}
+	};
+}
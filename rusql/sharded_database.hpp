@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+
+#include "database.hpp"
+#include "materialized_result.hpp"
+#include "row_iterator.hpp"
+
+namespace rusql {
+	//! Stable 64-bit hash of a byte string (FNV-1a with a final avalanche), identical on every platform and in
+	//! every process, so all clients agree on the shard a key lives on.
+	inline uint64_t stable_hash(std::string const& bytes) {
+		uint64_t h = 14695981039346656037ULL;
+		for(char c : bytes) {
+			h ^= static_cast<unsigned char>(c);
+			h *= 1099511628211ULL;
+		}
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb93e1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	//! Orders rows by one column, NULLs first, the way ORDER BY column does. For use with ShardedDatabase::scatter().
+	template <typename T>
+	std::function<bool(Row const&, Row const&)> order_by(std::string const column, bool const descending = false) {
+		return [column, descending](Row const& a, Row const& b) {
+			auto const x = a.get<boost::optional<T>>(column);
+			auto const y = b.get<boost::optional<T>>(column);
+			return descending ? y < x : x < y;
+		};
+	}
+
+	//! The rows of a statement that ran on every shard. Without an ordering, rows are handed out shard by shard,
+	//! starting while later shards may still be running. With an ordering, and each shard's rows sorted the same
+	//! way (ORDER BY in the query), the shards are merged like a k-way merge sort.
+	//! This merges materialized results, not live cursors: every shard's rows are fetched completely (see
+	//! Database::async_execute) before the first of them is handed out, so memory grows with the total number of
+	//! rows of all shards, not with the number of shards. In return no pooled connection is held while the rows
+	//! are being read. Use LIMIT, or query the shards one by one, for results that don't fit in memory.
+	//! Iterate with next() and row(), or with a range-based for, like a ResultSet.
+	struct MergedRows {
+		typedef std::function<bool(Row const&, Row const&)> Less;
+
+		MergedRows(std::vector<std::future<MaterializedResult>> pending_, Less less_ = Less())
+		: pending(std::move(pending_))
+		, results(pending.size())
+		, less(less_)
+		, shard(0)
+		, position(0)
+		, started(false)
+		, current(nullptr)
+		{}
+
+		MergedRows(MergedRows&&) = default;
+
+		//! Moves to the next row, returns false when all shards are exhausted. Rethrows the error of a failed shard.
+		bool next() {
+			current = less ? next_sorted() : next_unsorted();
+			return current != nullptr;
+		}
+
+		Row const& row() const {
+			return *current;
+		}
+
+		template <typename T>
+		T get(size_t const index) const {
+			return current->get<T>(index);
+		}
+
+		template <typename T>
+		T get(std::string const& column_name) const {
+			return current->get<T>(column_name);
+		}
+
+		typedef RowIterator<MergedRows> iterator;
+
+		iterator begin() {
+			return iterator(next() ? this : nullptr);
+		}
+
+		iterator end() {
+			return iterator();
+		}
+
+	private:
+		typedef std::pair<size_t, size_t> Cursor; // shard, row
+
+		struct HeapOrder {
+			HeapOrder(MergedRows* rows_)
+			: rows(rows_)
+			{}
+
+			// the heap functions put the greatest element on top, so this is "greater than"
+			bool operator()(Cursor const& a, Cursor const& b) const {
+				return rows->less(rows->at(b), rows->at(a));
+			}
+
+			MergedRows* rows;
+		};
+
+		std::vector<std::future<MaterializedResult>> pending;
+		std::vector<MaterializedResult> results;
+		Less less;
+
+		// unsorted: the shard and row we're at
+		size_t shard;
+		size_t position;
+
+		// sorted: a heap of the next unused row of every shard that has one left
+		std::vector<Cursor> heap;
+		bool started;
+
+		Row const* current;
+
+		Row const& at(Cursor const& c) const {
+			return results[c.first].rows[c.second];
+		}
+
+		Row const* next_unsorted() {
+			while(shard < results.size()) {
+				if(pending[shard].valid()) {
+					results[shard] = pending[shard].get();
+					position = 0;
+				}
+				if(position < results[shard].rows.size()) {
+					return &results[shard].rows[position++];
+				}
+				++shard;
+			}
+			return nullptr;
+		}
+
+		Row const* next_sorted() {
+			if(!started) {
+				started = true;
+				for(size_t i = 0; i < pending.size(); ++i) {
+					results[i] = pending[i].get();
+					if(!results[i].rows.empty()) {
+						heap.push_back(Cursor(i, 0));
+					}
+				}
+				std::make_heap(heap.begin(), heap.end(), HeapOrder(this));
+			} else if(current != nullptr) {
+				// the current row was on top; replace it by its successor from the same shard
+				std::pop_heap(heap.begin(), heap.end(), HeapOrder(this));
+				if(++heap.back().second == results[heap.back().first].rows.size()) {
+					heap.pop_back();
+				} else {
+					std::push_heap(heap.begin(), heap.end(), HeapOrder(this));
+				}
+			}
+			return heap.empty() ? nullptr : &at(heap.front());
+		}
+	};
+
+	inline bool next_row(MergedRows& rows) {
+		return rows.next();
+	}
+
+	//! One Database pool per shard, with keys assigned to shards by a consistent-hash ring: every shard owns
+	//! virtual_nodes points on the ring, and a key belongs to the first point at or after its hash. Shards are
+	//! placed on the ring by their endpoint, not their position in the list, so adding or removing a shard only
+	//! moves the keys of that shard.
+	struct ShardedDatabase : boost::noncopyable {
+		ShardedDatabase(std::vector<Database::ConstructionInfo> const& shards_, size_t const virtual_nodes = 128) {
+			if(shards_.empty()) {
+				throw std::runtime_error("ShardedDatabase needs at least one shard");
+			}
+			std::map<std::string, size_t> seen;
+			for(size_t i = 0; i < shards_.size(); ++i) {
+				shards.emplace_back(std::make_shared<Database>(shards_[i]));
+				// shards on the same endpoint (e.g. different schemas behind one default database) still need their own points
+				std::string name = endpoint_name(shards_[i]);
+				name += "@" + boost::lexical_cast<std::string>(seen[name]++);
+				for(size_t v = 0; v < virtual_nodes; ++v) {
+					ring[stable_hash(name + "#" + boost::lexical_cast<std::string>(v))] = i;
+				}
+			}
+		}
+
+		size_t number_of_shards() const {
+			return shards.size();
+		}
+
+		template <typename Key>
+		size_t shard_for(Key const& key) const {
+			auto it = ring.lower_bound(stable_hash(boost::lexical_cast<std::string>(key)));
+			return it == ring.end() ? ring.begin()->second : it->second;
+		}
+
+		std::shared_ptr<Database> get_shard(size_t const index) const {
+			return shards.at(index);
+		}
+
+		template <typename Key>
+		std::shared_ptr<Database> get_shard_for(Key const& key) const {
+			return shards[shard_for(key)];
+		}
+
+		template <typename Key, typename ... T>
+		PreparedStatement execute(Key const& key, std::string const q, T const& ... args) {
+			return get_shard_for(key)->execute(q, args ...);
+		}
+
+		template <typename Key>
+		ResultSet select_query(Key const& key, std::string const q) {
+			return get_shard_for(key)->select_query(q);
+		}
+
+		template <typename Key>
+		void query(Key const& key, std::string const q) {
+			get_shard_for(key)->query(q);
+		}
+
+		template <typename Key>
+		Lease acquire(Key const& key) {
+			return get_shard_for(key)->acquire();
+		}
+
+		//! Runs the statement on all shards in parallel (see Database::async_execute) and returns their rows in
+		//! shard order. Each shard's result is held in memory in full, see MergedRows.
+		template <typename ... T>
+		MergedRows scatter(std::string const q, T const& ... args) {
+			return MergedRows(start_everywhere(q, args ...));
+		}
+
+		//! Like scatter(), but merges the rows into one order. Every shard must return its rows in that order
+		//! already, i.e. the query has a matching ORDER BY. See order_by().
+		template <typename ... T>
+		MergedRows scatter_sorted(MergedRows::Less less, std::string const q, T const& ... args) {
+			return MergedRows(start_everywhere(q, args ...), less);
+		}
+
+	private:
+		std::vector<std::shared_ptr<Database>> shards;
+		std::map<uint64_t, size_t> ring;
+
+		static std::string endpoint_name(Database::ConstructionInfo const& info) {
+			typedef Database::ConstructionInfo::ConstructionInfoType CIType;
+			switch(info.type) {
+			case CIType::TCP:
+				return info.host + ":" + boost::lexical_cast<std::string>(info.port) + "/" + info.database;
+			case CIType::UNIX:
+				return info.unix_path + "/" + info.database;
+			case CIType::Embedded:
+			default:
+				return "embedded/" + info.database;
+			}
+		}
+
+		template <typename ... T>
+		std::vector<std::future<MaterializedResult>> start_everywhere(std::string const q, T const& ... args) {
+			std::vector<std::future<MaterializedResult>> results;
+			for(auto &shard : shards) {
+				results.emplace_back(shard->async_execute(q, args ...));
+			}
+			return results;
+		}
+	};
+}
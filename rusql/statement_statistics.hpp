@@ -0,0 +1,428 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "histogram.hpp"
+#include "mysql/observer.hpp"
+
+namespace rusql {
+	//! The shape of a statement, to tell which statements are the same but for their values: literals become ?,
+	//! comments go, whitespace shrinks to single spaces and everything outside quotes is lower case. Lists of
+	//! values like IN (?, ?, ?) become (?+), and so do the rows of VALUES (?, ?), (?, ?), so their length
+	//! doesn't matter.
+	inline std::string fingerprint(std::string const& sql) {
+		auto const is_word = [](char const c) {
+			return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || static_cast<unsigned char>(c) >= 0x80;
+		};
+
+		std::string out;
+		out.reserve(sql.size());
+		auto const space = [&out]() {
+			if(!out.empty() && out.back() != ' ') {
+				out += ' ';
+			}
+		};
+
+		size_t const n = sql.size();
+		size_t i = 0;
+		while(i < n) {
+			char const c = sql[i];
+			char const next = i + 1 < n ? sql[i + 1] : '\0';
+			if(std::isspace(static_cast<unsigned char>(c))) {
+				space();
+				++i;
+			} else if(c == '\'' || c == '"') {
+				for(++i; i < n; ++i) {
+					if(sql[i] == '\\') {
+						++i;
+					} else if(sql[i] == c) {
+						if(i + 1 < n && sql[i + 1] == c) {
+							++i;
+						} else {
+							++i;
+							break;
+						}
+					}
+				}
+				out += '?';
+			} else if(c == '`') {
+				size_t end = i + 1;
+				while(end < n && !(sql[end] == '`' && (end + 1 >= n || sql[end + 1] != '`'))) {
+					end += sql[end] == '`' ? 2 : 1;
+				}
+				end = std::min(end + 1, n);
+				out.append(sql, i, end - i);
+				i = end;
+			} else if(c == '/' && next == '*') {
+				size_t const end = sql.find("*/", i + 2);
+				i = end == std::string::npos ? n : end + 2;
+				space();
+			} else if(c == '#' || (c == '-' && next == '-' && (i + 2 >= n || std::isspace(static_cast<unsigned char>(sql[i + 2]))))) {
+				size_t const end = sql.find('\n', i);
+				i = end == std::string::npos ? n : end + 1;
+				space();
+			} else if(std::isdigit(static_cast<unsigned char>(c)) && (out.empty() || !is_word(out.back()))) {
+				// 12, 1.5, 1e-3, 0x1F
+				for(++i; i < n; ++i) {
+					char const d = sql[i];
+					bool const exponent_sign = (d == '+' || d == '-') && (sql[i - 1] == 'e' || sql[i - 1] == 'E');
+					if(!is_word(d) && d != '.' && !exponent_sign) {
+						break;
+					}
+				}
+				out += '?';
+			} else {
+				out += char(std::tolower(static_cast<unsigned char>(c)));
+				++i;
+			}
+		}
+		if(!out.empty() && out.back() == ' ') {
+			out.erase(out.size() - 1);
+		}
+
+		// (?, ?, ?) -> (?+)
+		std::string collapsed;
+		collapsed.reserve(out.size());
+		for(size_t j = 0; j < out.size();) {
+			if(out[j] == '(') {
+				size_t k = j + 1;
+				auto const skip_space = [&]() {
+					while(k < out.size() && out[k] == ' ') {
+						++k;
+					}
+				};
+				size_t values = 0;
+				while(true) {
+					skip_space();
+					if(k >= out.size() || out[k] != '?') {
+						break;
+					}
+					++values;
+					++k;
+					skip_space();
+					if(k >= out.size() || out[k] != ',') {
+						break;
+					}
+					++k;
+				}
+				if(values > 0 && k < out.size() && out[k] == ')') {
+					collapsed += "(?+)";
+					j = k + 1;
+					continue;
+				}
+			}
+			collapsed += out[j++];
+		}
+
+		// (?+), (?+) -> (?+)
+		for(std::string const repeated : {"(?+), (?+)", "(?+),(?+)"}) {
+			for(size_t at = collapsed.find(repeated); at != std::string::npos; at = collapsed.find(repeated, at)) {
+				collapsed.erase(at + 4, repeated.size() - 4);
+			}
+		}
+		return collapsed;
+	}
+
+	//! What StatementStatistics knows about the statements with one fingerprint. Latency is the time the server
+	//! took to run a statement, until the first of its result; fetching the rows is counted apart.
+	struct StatementSummary {
+		typedef boost::chrono::steady_clock Clock;
+
+		std::string fingerprint;
+		//! The text of one of the statements.
+		std::string example;
+		uint64_t executions;
+		uint64_t prepares;
+		//! Stages that ended by an exception, of any kind.
+		uint64_t errors;
+		uint64_t rows;
+		uint64_t bytes;
+		Clock::duration total_latency;
+		Clock::duration min_latency;
+		Clock::duration max_latency;
+		Clock::duration p50_latency;
+		Clock::duration p99_latency;
+		//! Spent fetching rows and closing results.
+		Clock::duration fetch_time;
+		//! Heap allocations made by rusql in all stages, and their size; see mysql/allocations.hpp.
+		uint64_t allocations;
+		uint64_t allocated_bytes;
+	};
+
+	//! A statement that took longer than the threshold of StatementStatistics.
+	struct SlowStatement {
+		typedef boost::chrono::steady_clock Clock;
+
+		std::string sql;
+		std::string fingerprint;
+		Clock::duration latency;
+		unsigned long connection_id;
+		bool failed;
+	};
+
+	//! Client-side statement statistics, like performance_schema's statement digests: for every fingerprint, how
+	//! often it ran, how long it took, the rows and bytes it returned, how often it failed and, in programs that
+	//! count them, the allocations it made. Install it with Database::set_query_observer(). Events only take a
+	//! lock to find their fingerprint, striped over the text of the statement; fingerprinting happens once per
+	//! distinct text, of which the most recent max_texts are remembered.
+	struct StatementStatistics : mysql::QueryObserver, boost::noncopyable {
+		typedef boost::chrono::steady_clock Clock;
+
+		StatementStatistics(size_t const max_texts_ = 10000)
+		: max_texts(std::max<size_t>(1, max_texts_ / number_of_stripes))
+		, slow_threshold_ns(-1)
+		{}
+
+		void on_event(mysql::QueryEvent const& event) override {
+			if(event.sql.empty() || event.stage == mysql::QueryStage::Acquire) {
+				return;
+			}
+			auto const entry = lookup(event.sql);
+			if(event.failed) {
+				++entry->errors;
+			}
+			if(event.allocations != 0) {
+				entry->allocations += event.allocations;
+				entry->allocated_bytes += event.allocated_bytes;
+			}
+
+			int64_t const ns = boost::chrono::duration_cast<boost::chrono::nanoseconds>(event.duration).count();
+			switch(event.stage) {
+			case mysql::QueryStage::Prepare:
+				++entry->prepares;
+				break;
+
+			case mysql::QueryStage::Query:
+			case mysql::QueryStage::Execute: {
+				++entry->executions;
+				entry->total_ns += ns;
+				lower(entry->min_ns, ns);
+				raise(entry->max_ns, ns);
+				entry->latencies.record(event.duration);
+				int64_t const threshold = slow_threshold_ns.load(std::memory_order_relaxed);
+				if(threshold >= 0 && ns > threshold) {
+					report_slow(event, entry->fingerprint);
+				}
+				break;
+			}
+
+			case mysql::QueryStage::Fetch:
+			case mysql::QueryStage::FetchRow:
+				if(event.row) {
+					++entry->rows;
+					entry->bytes += event.bytes;
+				}
+				entry->fetch_ns += ns;
+				break;
+
+			case mysql::QueryStage::Close:
+				entry->fetch_ns += ns;
+				break;
+
+			case mysql::QueryStage::Acquire:
+				break;
+
+			default:
+				assert(!"Unreachable code");
+			}
+		}
+
+		//! Calls listener, on the thread that ran it, with every statement that takes longer than threshold
+		//! from now on; an empty listener stops it.
+		void set_slow_threshold(Clock::duration const threshold, std::function<void(SlowStatement const&)> const& listener) {
+			boost::mutex::scoped_lock lock(slow_mutex);
+			slow_listener = listener;
+			slow_threshold_ns = listener ? boost::chrono::duration_cast<boost::chrono::nanoseconds>(threshold).count() : -1;
+		}
+
+		//! Every fingerprint so far, the most total latency first.
+		std::vector<StatementSummary> report() const {
+			std::vector<StatementSummary> summaries;
+			for(auto const &stripe : fingerprints) {
+				boost::mutex::scoped_lock lock(stripe.mutex);
+				for(auto const &it : stripe.entries) {
+					summaries.push_back(it.second->summary());
+				}
+			}
+			std::sort(summaries.begin(), summaries.end(), [](StatementSummary const& a, StatementSummary const& b) {
+				return a.total_latency > b.total_latency;
+			});
+			return summaries;
+		}
+
+		//! The first limit lines of report(), as a table.
+		void write_report(std::ostream& os, size_t const limit = 20) const {
+			auto const ms = [](Clock::duration const d) {
+				return boost::chrono::duration<double, boost::milli>(d).count();
+			};
+			auto const summaries = report();
+			std::ostringstream out;
+			out << std::fixed << std::setprecision(3);
+			out << "executions\terrors\trows\tbytes\ttotal_ms\tmin_ms\tp50_ms\tp99_ms\tmax_ms\tfetch_ms\tallocations\tallocated_bytes\tfingerprint\n";
+			for(size_t i = 0; i < summaries.size() && i < limit; ++i) {
+				auto const &s = summaries[i];
+				out << s.executions << '\t' << s.errors << '\t' << s.rows << '\t' << s.bytes << '\t'
+					<< ms(s.total_latency) << '\t' << ms(s.min_latency) << '\t' << ms(s.p50_latency) << '\t'
+					<< ms(s.p99_latency) << '\t' << ms(s.max_latency) << '\t' << ms(s.fetch_time) << '\t'
+					<< s.allocations << '\t' << s.allocated_bytes << '\t'
+					<< s.fingerprint << '\n';
+			}
+			os << out.str();
+		}
+
+		//! Forgets everything so far.
+		void clear() {
+			for(auto &stripe : texts) {
+				boost::mutex::scoped_lock lock(stripe.mutex);
+				stripe.entries.clear();
+			}
+			for(auto &stripe : fingerprints) {
+				boost::mutex::scoped_lock lock(stripe.mutex);
+				stripe.entries.clear();
+			}
+		}
+
+	private:
+		struct Entry : boost::noncopyable {
+			Entry(std::string const& fingerprint_, std::string const& example_)
+			: fingerprint(fingerprint_)
+			, example(example_)
+			, executions(0)
+			, prepares(0)
+			, errors(0)
+			, rows(0)
+			, bytes(0)
+			, total_ns(0)
+			, min_ns(INT64_MAX)
+			, max_ns(0)
+			, fetch_ns(0)
+			, allocations(0)
+			, allocated_bytes(0)
+			{}
+
+			std::string const fingerprint;
+			std::string const example;
+			std::atomic<uint64_t> executions;
+			std::atomic<uint64_t> prepares;
+			std::atomic<uint64_t> errors;
+			std::atomic<uint64_t> rows;
+			std::atomic<uint64_t> bytes;
+			std::atomic<int64_t> total_ns;
+			std::atomic<int64_t> min_ns;
+			std::atomic<int64_t> max_ns;
+			std::atomic<int64_t> fetch_ns;
+			std::atomic<uint64_t> allocations;
+			std::atomic<uint64_t> allocated_bytes;
+			LatencyHistogram latencies;
+
+			StatementSummary summary() const {
+				auto const duration = [](int64_t const ns) {
+					return boost::chrono::duration_cast<Clock::duration>(boost::chrono::nanoseconds(ns));
+				};
+				StatementSummary s;
+				s.fingerprint = fingerprint;
+				s.example = example;
+				s.executions = executions;
+				s.prepares = prepares;
+				s.errors = errors;
+				s.rows = rows;
+				s.bytes = bytes;
+				s.total_latency = duration(total_ns);
+				s.min_latency = duration(s.executions == 0 ? 0 : min_ns.load());
+				s.max_latency = duration(max_ns);
+				s.p50_latency = latencies.percentile(0.5);
+				s.p99_latency = latencies.percentile(0.99);
+				s.fetch_time = duration(fetch_ns);
+				s.allocations = allocations;
+				s.allocated_bytes = allocated_bytes;
+				return s;
+			}
+		};
+
+		struct Stripe {
+			mutable boost::mutex mutex;
+			std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+		};
+
+		static size_t const number_of_stripes = 16;
+
+		//! Statement text to its fingerprint's entry.
+		Stripe texts[number_of_stripes];
+		//! Fingerprint to its entry.
+		Stripe fingerprints[number_of_stripes];
+		size_t const max_texts;
+
+		std::atomic<int64_t> slow_threshold_ns;
+		boost::mutex slow_mutex;
+		std::function<void(SlowStatement const&)> slow_listener;
+
+		std::shared_ptr<Entry> lookup(std::string const& sql) {
+			auto &text_stripe = texts[std::hash<std::string>()(sql) % number_of_stripes];
+			{
+				boost::mutex::scoped_lock lock(text_stripe.mutex);
+				auto const it = text_stripe.entries.find(sql);
+				if(it != text_stripe.entries.end()) {
+					return it->second;
+				}
+			}
+
+			std::string const shape = fingerprint(sql);
+			std::shared_ptr<Entry> entry;
+			{
+				auto &stripe = fingerprints[std::hash<std::string>()(shape) % number_of_stripes];
+				boost::mutex::scoped_lock lock(stripe.mutex);
+				auto &slot = stripe.entries[shape];
+				if(!slot) {
+					slot = std::make_shared<Entry>(shape, sql);
+				}
+				entry = slot;
+			}
+
+			boost::mutex::scoped_lock lock(text_stripe.mutex);
+			// statements with their values in the text are all different; start over rather than grow forever
+			if(text_stripe.entries.size() >= max_texts) {
+				text_stripe.entries.clear();
+			}
+			text_stripe.entries[sql] = entry;
+			return entry;
+		}
+
+		void report_slow(mysql::QueryEvent const& event, std::string const& shape) {
+			std::function<void(SlowStatement const&)> listener;
+			{
+				boost::mutex::scoped_lock lock(slow_mutex);
+				listener = slow_listener;
+			}
+			if(listener) {
+				SlowStatement const slow = {event.sql, shape, event.duration, event.connection_id, event.failed};
+				listener(slow);
+			}
+		}
+
+		static void lower(std::atomic<int64_t>& x, int64_t const value) {
+			int64_t old = x.load(std::memory_order_relaxed);
+			while(value < old && !x.compare_exchange_weak(old, value, std::memory_order_relaxed)) {}
+		}
+
+		static void raise(std::atomic<int64_t>& x, int64_t const value) {
+			int64_t old = x.load(std::memory_order_relaxed);
+			while(value > old && !x.compare_exchange_weak(old, value, std::memory_order_relaxed)) {}
+		}
+	};
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "mysql/mysql.hpp"
+
+namespace rusql {
+	//! Must be held by every thread (other than the one that initialised the library) for as long as it uses MySQL.
+	struct ThreadHandle {
+		ThreadHandle() {
+			rusql::mysql::thread_init();
+		}
+		ThreadHandle(ThreadHandle&&) = default;
+		~ThreadHandle() {
+			rusql::mysql::thread_end();
+		}
+	};
+}
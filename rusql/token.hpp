@@ -1,9 +1,22 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+
 namespace rusql {
 	//! Is shared between a Connection and a (Statement or ResultSet), so a connection knows when it's still in use
 	struct Token{
 	// Token() { std::cout << "Token CREATED" << std::endl; }
-	// ~Token() { std::cout << "Token DESTROYED" << std::endl; }
+	~Token() {
+		// std::cout << "Token DESTROYED" << std::endl;
+		if(auto signal = released.lock()) signal->notify_all();
+	}
+
+	//! Notified when the token is destroyed, i.e. when its connection may have become free
+	std::weak_ptr<boost::condition_variable> released;
+	//! Kept alive for as long as the token, e.g. to count a request until its results are gone
+	std::vector<std::shared_ptr<void>> held;
 	};
 }
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "connection.hpp"
+#include "quote.hpp"
+#include "token.hpp"
+
+namespace rusql {
+	struct TransactionError : mysql::SQLError { TransactionError(std::string const msg) : mysql::SQLError(msg) {} };
+
+	//! A transaction on one pooled Connection, which stays pinned to it until the Transaction is gone.
+	//! Everything run through it is part of the transaction, so a batch of writes costs a single commit instead
+	//! of one per statement. Rolls back on destruction unless commit() or rollback() was called. Move-only.
+	struct Transaction {
+		Transaction(std::shared_ptr<Connection> connection_, std::shared_ptr<Token> pin_)
+		: connection(connection_)
+		, pin(pin_)
+		, active(false)
+		{
+			connection->query("START TRANSACTION");
+			active = true;
+		}
+
+		Transaction(Transaction&& x)
+		: connection(std::move(x.connection))
+		, pin(std::move(x.pin))
+		, active(x.active)
+		{
+			x.active = false;
+		}
+
+		Transaction(Transaction const&) = delete;
+		Transaction& operator=(Transaction const&) = delete;
+
+		~Transaction() {
+			if(active) {
+				try {
+					rollback();
+				} catch(const mysql::SQLError& e) {
+					std::cerr << "Exception when rolling back Transaction, ignoring: " << e.what() << std::endl;
+				}
+			}
+		}
+
+		bool is_active() const {
+			return active;
+		}
+
+		ResultSet select_query(std::string const q) {
+			return get_connection().select_query(q);
+		}
+
+		void query(std::string const q) {
+			get_connection().query(q);
+		}
+
+		PreparedStatement prepare(std::string const q) {
+			return get_connection().prepare(q);
+		}
+
+		template <typename ... T>
+		PreparedStatement execute(std::string const q, T const& ... args) {
+			return get_connection().execute(q, args ...);
+		}
+
+		template <typename T>
+		PreparedStatement execute(std::string const q, std::vector<T> const &args) {
+			return get_connection().execute(q, args);
+		}
+
+		unsigned long long insert_id() {
+			return get_connection().insert_id();
+		}
+
+		//! Marks a point that rollback_to() can return to without ending the transaction.
+		void savepoint(std::string const name) {
+			get_connection().query("SAVEPOINT " + quote_identifier(name));
+		}
+
+		//! Undoes everything after the savepoint; the savepoint itself remains.
+		void rollback_to(std::string const name) {
+			get_connection().query("ROLLBACK TO SAVEPOINT " + quote_identifier(name));
+		}
+
+		void release_savepoint(std::string const name) {
+			get_connection().query("RELEASE SAVEPOINT " + quote_identifier(name));
+		}
+
+		//! Commits and releases the connection.
+		void commit() {
+			finish("COMMIT");
+		}
+
+		//! Rolls back and releases the connection.
+		void rollback() {
+			finish("ROLLBACK");
+		}
+
+	private:
+		std::shared_ptr<Connection> connection;
+		std::shared_ptr<Token> pin;
+		bool active;
+
+		Connection& get_connection() {
+			if(!active) {
+				throw TransactionError("Transaction was already committed or rolled back");
+			}
+			return *connection;
+		}
+
+		void finish(std::string const q) {
+			Connection &c = get_connection();
+			// whatever happens, this transaction is over and the connection goes back to the pool
+			active = false;
+			std::shared_ptr<Token> released = std::move(pin);
+			c.query(q);
+		}
+	};
+}
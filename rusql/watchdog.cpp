@@ -0,0 +1,118 @@
+#include "rusql.hpp"
+
+#include <iostream>
+
+#include <boost/lexical_cast.hpp>
+
+namespace rusql {
+	Watchdog::Watchdog(std::weak_ptr<Database> database_)
+	: database(database_)
+	, state(std::make_shared<State>())
+	{
+		killer = boost::thread([this]() { run(); });
+	}
+
+	Watchdog::~Watchdog() {
+		{
+			boost::mutex::scoped_lock lock(state->mutex);
+			state->stopping = true;
+		}
+		state->changed.notify_all();
+		killer.join();
+	}
+
+	void Watchdog::run() {
+		ThreadHandle handle;
+		std::unique_ptr<Connection> connection;
+
+		boost::mutex::scoped_lock lock(state->mutex);
+		while(!state->stopping) {
+			auto const now = Deadline::Clock::now();
+			boost::optional<Deadline::Clock::time_point> wake_up;
+			for(auto &entry : state->entries) {
+				Entry &e = entry.second;
+				if(e.killed) {
+					continue;
+				}
+				if(!e.cancel_requested && !e.deadline.expired(now)) {
+					if(!e.deadline.is_never() && (!wake_up || e.deadline.get_time() < *wake_up)) {
+						wake_up = e.deadline.get_time();
+					}
+					continue;
+				}
+
+				// Killed while holding the lock: the Guard can't go away, and its connection can't start
+				// another statement, until the KILL is through.
+				e.killed = true;
+				try {
+					if(!connection) {
+						connection.reset(new Connection(database));
+					}
+					connection->query("KILL QUERY " + boost::lexical_cast<std::string>(e.thread_id));
+				} catch(std::exception const& ex) {
+					std::cerr << "Watchdog could not kill query on thread " << e.thread_id << ", ignoring: " << ex.what() << std::endl;
+					connection.reset();
+				}
+			}
+
+			if(wake_up) {
+				state->changed.wait_until(lock, *wake_up);
+			} else {
+				state->changed.wait(lock);
+			}
+		}
+	}
+
+	Watchdog::Guard::Guard(Watchdog& watchdog_, unsigned long const thread_id, Interruption const& interruption)
+	: watchdog(watchdog_)
+	, token(interruption.token)
+	, callback(0)
+	{
+		{
+			boost::mutex::scoped_lock lock(watchdog.state->mutex);
+			id = watchdog.state->next_id++;
+			watchdog.state->entries.insert(std::make_pair(id, Entry{thread_id, interruption.deadline, false, false}));
+		}
+		if(!interruption.deadline.is_never()) {
+			watchdog.state->changed.notify_all();
+		}
+
+		if(token) {
+			std::weak_ptr<State> weak_state = watchdog.state;
+			uint64_t const entry_id = id;
+			callback = token->on_cancel([weak_state, entry_id]() {
+				auto s = weak_state.lock();
+				if(!s) {
+					return;
+				}
+				{
+					boost::mutex::scoped_lock lock(s->mutex);
+					auto it = s->entries.find(entry_id);
+					if(it == s->entries.end()) {
+						return;
+					}
+					it->second.cancel_requested = true;
+				}
+				s->changed.notify_all();
+			});
+		}
+	}
+
+	Watchdog::Guard::~Guard() {
+		if(token) {
+			token->forget(callback);
+		}
+		boost::mutex::scoped_lock lock(watchdog.state->mutex);
+		watchdog.state->entries.erase(id);
+	}
+
+	bool Watchdog::Guard::killed() const {
+		boost::mutex::scoped_lock lock(watchdog.state->mutex);
+		return watchdog.state->entries.at(id).killed;
+	}
+
+	bool Watchdog::Guard::cancelled() const {
+		boost::mutex::scoped_lock lock(watchdog.state->mutex);
+		return watchdog.state->entries.at(id).cancel_requested;
+	}
+}
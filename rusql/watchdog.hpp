@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "cancellation.hpp"
+
+namespace rusql {
+	struct Database;
+
+	//! Stops statements that passed their Deadline or whose CancellationToken fired, by sending KILL QUERY for
+	//! their connection over a connection of its own. KILL QUERY only ends the statement, so the connection that
+	//! ran it stays usable. One per Database, made on first use; see Database::get_watchdog().
+	struct Watchdog : boost::noncopyable {
+		Watchdog(std::weak_ptr<Database> database);
+		~Watchdog();
+
+		//! Watches the connection with the given server thread id for as long as it lives. Create it right before
+		//! running a statement and destroy it right after: a KILL is never sent once the guard is gone.
+		struct Guard : boost::noncopyable {
+			Guard(Watchdog& watchdog, unsigned long thread_id, Interruption const& interruption);
+			~Guard();
+
+			//! Whether KILL QUERY was sent, and why.
+			bool killed() const;
+			bool cancelled() const;
+
+		private:
+			Watchdog& watchdog;
+			uint64_t id;
+			boost::optional<CancellationToken> token;
+			size_t callback;
+		};
+
+	private:
+		struct Entry {
+			unsigned long thread_id;
+			Deadline deadline;
+			bool cancel_requested;
+			bool killed;
+		};
+
+		//! Shared with cancellation callbacks, which may outlive the watchdog.
+		struct State {
+			State()
+			: next_id(0)
+			, stopping(false)
+			{}
+
+			boost::mutex mutex;
+			boost::condition_variable changed;
+			std::map<uint64_t, Entry> entries;
+			uint64_t next_id;
+			bool stopping;
+		};
+
+		std::weak_ptr<Database> database;
+		std::shared_ptr<State> state;
+		boost::thread killer;
+
+		void run();
+	};
+}
@@ -0,0 +1,476 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "mysql/observer.hpp"
+#include "statement_statistics.hpp"
+
+//! \file workload.hpp Recording the statements a program runs, to run them again later with rusql_replay: see
+//! Database::start_recording(). A recording is a binary file:
+//!
+//!   header:     "RUSQLWL" 0x01
+//!   records:    a byte for the kind, then
+//!     1 define: id, text (length and bytes), fingerprint (length and bytes)
+//!     2 run:    stage (1 Query, 2 Execute), id of the text, start and duration in microseconds, thread,
+//!               connection id, failed (a byte), number of parameters, parameters
+//!     3 forget: the ids defined so far are no longer used
+//!   parameter:  a byte for the type, then nothing for 0 NULL, a zigzag varint for 1 signed, a varint for
+//!               2 unsigned, or length and bytes for 3 string. Floating point, date and time parameters are
+//!               strings, in the text MySQL reads them from; parameters of a type none of these fits are NULL.
+//!
+//! where numbers are LEB128 varints. Texts are defined once and referred to by id afterwards.
+
+namespace rusql {
+	//! A parameter of a recorded statement.
+	struct RecordedValue {
+		enum class Type : uint8_t { Null = 0, Signed = 1, Unsigned = 2, String = 3 };
+
+		RecordedValue()
+		: type(Type::Null)
+		, signed_value(0)
+		, unsigned_value(0)
+		{}
+
+		Type type;
+		int64_t signed_value;
+		uint64_t unsigned_value;
+		std::string string_value;
+	};
+
+	//! A statement read back from a recording.
+	struct RecordedStatement {
+		//! Query or Execute.
+		mysql::QueryStage stage;
+		std::shared_ptr<std::string const> sql;
+		std::shared_ptr<std::string const> fingerprint;
+		//! Since the recording started.
+		uint64_t start_us;
+		uint64_t duration_us;
+		//! Threads are numbered from 1, in the order of their first statement.
+		uint32_t thread;
+		unsigned long connection_id;
+		bool failed;
+		std::vector<RecordedValue> parameters;
+	};
+
+	namespace workload {
+		char const header[] = "RUSQLWL\x01";
+		size_t const header_size = 8;
+
+		enum class Record : uint8_t { Define = 1, Run = 2, Forget = 3 };
+
+		inline void put_varint(std::string& out, uint64_t x) {
+			while(x >= 0x80) {
+				out += char(uint8_t(x) | 0x80);
+				x >>= 7;
+			}
+			out += char(uint8_t(x));
+		}
+
+		inline void put_string(std::string& out, char const* data, size_t const size) {
+			put_varint(out, size);
+			out.append(data, size);
+		}
+
+		//! Throws when the input ends in the middle of a record.
+		inline uint8_t get_byte(std::istream& in) {
+			char c;
+			if(!in.get(c)) {
+				throw std::runtime_error("Workload recording ends in the middle of a record");
+			}
+			return uint8_t(c);
+		}
+
+		inline uint64_t get_varint(std::istream& in) {
+			uint64_t x = 0;
+			for(unsigned shift = 0; shift < 64; shift += 7) {
+				uint8_t const byte = get_byte(in);
+				x |= uint64_t(byte & 0x7f) << shift;
+				if((byte & 0x80) == 0) {
+					return x;
+				}
+			}
+			throw std::runtime_error("Workload recording has a number that is too long");
+		}
+
+		inline std::string get_string(std::istream& in) {
+			uint64_t const size = get_varint(in);
+			std::string s(size, '\0');
+			if(size > 0 && !in.read(&s[0], std::streamsize(size))) {
+				throw std::runtime_error("Workload recording ends in the middle of a record");
+			}
+			return s;
+		}
+
+		//! A DATE, TIME, DATETIME or TIMESTAMP parameter as MySQL reads it from a string, e.g. "2024-02-29 13:05:00.25".
+		inline std::string time_literal(enum_field_types const type, MYSQL_TIME const& t) {
+			char text[48];
+			if(type == MYSQL_TYPE_DATE) {
+				std::snprintf(text, sizeof(text), "%04u-%02u-%02u", t.year, t.month, t.day);
+			} else if(type == MYSQL_TYPE_TIME) {
+				std::snprintf(text, sizeof(text), "%s%02u:%02u:%02u", t.neg ? "-" : "", t.day * 24 + t.hour, t.minute, t.second);
+			} else {
+				std::snprintf(text, sizeof(text), "%04u-%02u-%02u %02u:%02u:%02u", t.year, t.month, t.day, t.hour, t.minute, t.second);
+			}
+			std::string literal = text;
+			if(type != MYSQL_TYPE_DATE && t.second_part != 0) {
+				std::snprintf(text, sizeof(text), ".%06lu", t.second_part);
+				literal += text;
+			}
+			return literal;
+		}
+
+		//! sql with the contents of its quoted strings replaced by as many x's; see WorkloadRecorder::Options.
+		inline std::string redact(std::string const& sql) {
+			std::string out = sql;
+			for(size_t i = 0; i < out.size(); ++i) {
+				char const quote = out[i];
+				if(quote != '\'' && quote != '"') {
+					continue;
+				}
+				for(++i; i < out.size(); ++i) {
+					if(out[i] == '\\' && i + 1 < out.size()) {
+						out[i] = out[i + 1] = 'x';
+						++i;
+					} else if(out[i] == quote) {
+						if(i + 1 < out.size() && out[i + 1] == quote) {
+							out[i] = out[i + 1] = 'x';
+							++i;
+						} else {
+							break;
+						}
+					} else {
+						out[i] = 'x';
+					}
+				}
+			}
+			return out;
+		}
+	}
+
+	//! Writes every plain and prepared statement that runs, with its parameters, timing, thread and connection,
+	//! to a recording that rusql_replay can run again; see workload.hpp for the format. Install it through
+	//! Database::start_recording(). Statements prepared before it was installed are left out, since their text
+	//! isn't known. Takes a lock per statement.
+	struct WorkloadRecorder : mysql::QueryObserver, boost::noncopyable {
+		typedef boost::chrono::steady_clock Clock;
+
+		struct Options {
+			Options()
+			: redact(false)
+			, max_texts(10000)
+			{}
+
+			//! Replaces quoted strings in statements, and string parameters, by as many x's. Numbers are kept, so
+			//! that statements replayed against a copy of the data find the same rows.
+			bool redact;
+			//! Texts remembered to refer to by id; after that many, they're forgotten and defined anew.
+			size_t max_texts;
+		};
+
+		//! Starts a recording in the file at path, replacing it. Throws a std::runtime_error when it can't be
+		//! opened.
+		WorkloadRecorder(std::string const& path, Options const& options_ = Options())
+		: options(options_)
+		, out(path.c_str(), std::ios::binary | std::ios::trunc)
+		, start(Clock::now())
+		, statements(0)
+		, closed(false)
+		{
+			if(!out) {
+				throw std::runtime_error("WorkloadRecorder: can't open " + path);
+			}
+			out.write(workload::header, workload::header_size);
+		}
+
+		~WorkloadRecorder() {
+			close();
+		}
+
+		void on_event(mysql::QueryEvent const& event) override {
+			if((event.stage != mysql::QueryStage::Query && event.stage != mysql::QueryStage::Execute) || event.sql.empty()) {
+				return;
+			}
+			auto const us = [](Clock::duration const d) {
+				auto const count = boost::chrono::duration_cast<boost::chrono::microseconds>(d).count();
+				return count < 0 ? uint64_t(0) : uint64_t(count);
+			};
+
+			boost::mutex::scoped_lock lock(mutex);
+			if(closed) {
+				return;
+			}
+			record.clear();
+			uint64_t const id = define(event.sql);
+			record += char(workload::Record::Run);
+			record += char(event.stage == mysql::QueryStage::Query ? 1 : 2);
+			workload::put_varint(record, id);
+			workload::put_varint(record, us(event.start - start));
+			workload::put_varint(record, us(event.duration));
+			workload::put_varint(record, thread_number());
+			workload::put_varint(record, event.connection_id);
+			record += char(event.failed ? 1 : 0);
+			workload::put_varint(record, event.number_of_parameters);
+			for(size_t i = 0; i < event.number_of_parameters; ++i) {
+				put_parameter(event.parameters[i]);
+			}
+			out.write(record.data(), std::streamsize(record.size()));
+			++statements;
+		}
+
+		//! Statements recorded so far.
+		uint64_t number_of_statements() {
+			boost::mutex::scoped_lock lock(mutex);
+			return statements;
+		}
+
+		void flush() {
+			boost::mutex::scoped_lock lock(mutex);
+			out.flush();
+		}
+
+		//! Ends the recording; statements after this are not recorded.
+		void close() {
+			boost::mutex::scoped_lock lock(mutex);
+			if(!closed) {
+				closed = true;
+				out.close();
+			}
+		}
+
+	private:
+		Options const options;
+		boost::mutex mutex;
+		std::ofstream out;
+		Clock::time_point const start;
+		uint64_t statements;
+		bool closed;
+		//! Texts defined so far, to their id.
+		std::unordered_map<std::string, uint64_t> texts;
+		std::map<boost::thread::id, uint32_t> threads;
+		//! The record being written, kept to reuse its memory.
+		std::string record;
+
+		//! The id of sql, writing its definition first if it has none.
+		uint64_t define(std::string const& sql) {
+			auto const it = texts.find(sql);
+			if(it != texts.end()) {
+				return it->second;
+			}
+			if(texts.size() >= options.max_texts) {
+				texts.clear();
+				char const forget = char(workload::Record::Forget);
+				out.write(&forget, 1);
+			}
+			uint64_t const id = texts.size();
+			texts[sql] = id;
+
+			std::string const text = options.redact ? workload::redact(sql) : sql;
+			std::string const shape = fingerprint(sql);
+			std::string definition(1, char(workload::Record::Define));
+			workload::put_varint(definition, id);
+			workload::put_string(definition, text.data(), text.size());
+			workload::put_string(definition, shape.data(), shape.size());
+			out.write(definition.data(), std::streamsize(definition.size()));
+			return id;
+		}
+
+		uint32_t thread_number() {
+			auto &number = threads[boost::this_thread::get_id()];
+			if(number == 0) {
+				number = uint32_t(threads.size());
+			}
+			return number;
+		}
+
+		void put_parameter(MYSQL_BIND const& b) {
+			typedef RecordedValue::Type Type;
+			if(b.buffer_type == MYSQL_TYPE_NULL || (b.is_null != nullptr && *b.is_null)) {
+				record += char(Type::Null);
+				return;
+			}
+
+			int64_t signed_value = 0;
+			uint64_t unsigned_value = 0;
+			switch(b.buffer_type) {
+			case MYSQL_TYPE_TINY:
+				signed_value = *static_cast<int8_t const*>(b.buffer);
+				unsigned_value = *static_cast<uint8_t const*>(b.buffer);
+				break;
+			case MYSQL_TYPE_SHORT:
+			case MYSQL_TYPE_YEAR:
+				signed_value = *static_cast<int16_t const*>(b.buffer);
+				unsigned_value = *static_cast<uint16_t const*>(b.buffer);
+				break;
+			case MYSQL_TYPE_LONG:
+			case MYSQL_TYPE_INT24:
+				signed_value = *static_cast<int32_t const*>(b.buffer);
+				unsigned_value = *static_cast<uint32_t const*>(b.buffer);
+				break;
+			case MYSQL_TYPE_LONGLONG:
+				signed_value = *static_cast<int64_t const*>(b.buffer);
+				unsigned_value = *static_cast<uint64_t const*>(b.buffer);
+				break;
+			case MYSQL_TYPE_FLOAT:
+			case MYSQL_TYPE_DOUBLE: {
+				std::ostringstream s;
+				s.precision(17);
+				if(b.buffer_type == MYSQL_TYPE_FLOAT) {
+					s << *static_cast<float const*>(b.buffer);
+				} else {
+					s << *static_cast<double const*>(b.buffer);
+				}
+				put_text(s.str());
+				return;
+			}
+			case MYSQL_TYPE_DATE:
+			case MYSQL_TYPE_TIME:
+			case MYSQL_TYPE_DATETIME:
+			case MYSQL_TYPE_TIMESTAMP:
+				put_text(workload::time_literal(b.buffer_type, *static_cast<MYSQL_TIME const*>(b.buffer)));
+				return;
+			case MYSQL_TYPE_DECIMAL:
+			case MYSQL_TYPE_NEWDECIMAL:
+			case MYSQL_TYPE_VARCHAR:
+			case MYSQL_TYPE_BIT:
+			case MYSQL_TYPE_ENUM:
+			case MYSQL_TYPE_SET:
+			case MYSQL_TYPE_TINY_BLOB:
+			case MYSQL_TYPE_MEDIUM_BLOB:
+			case MYSQL_TYPE_LONG_BLOB:
+			case MYSQL_TYPE_BLOB:
+			case MYSQL_TYPE_VAR_STRING:
+			case MYSQL_TYPE_STRING:
+			case MYSQL_TYPE_GEOMETRY: {
+				unsigned long const length = b.length != nullptr ? *b.length : b.buffer_length;
+				char const* const data = length == 0 ? "" : static_cast<char const*>(b.buffer);
+				record += char(Type::String);
+				if(options.redact) {
+					workload::put_string(record, std::string(length, 'x').data(), length);
+				} else {
+					workload::put_string(record, data, length);
+				}
+				return;
+			}
+			case MYSQL_TYPE_NULL:
+			case MYSQL_TYPE_NEWDATE:
+			default:
+				// not a type of bound parameter the recording knows how to write back
+				record += char(Type::Null);
+				return;
+			}
+
+			if(b.is_unsigned) {
+				record += char(Type::Unsigned);
+				workload::put_varint(record, unsigned_value);
+			} else {
+				record += char(Type::Signed);
+				workload::put_varint(record, (uint64_t(signed_value) << 1) ^ uint64_t(signed_value >> 63));
+			}
+		}
+
+		//! A value that is not a string, kept as its text.
+		void put_text(std::string const& text) {
+			record += char(RecordedValue::Type::String);
+			workload::put_string(record, text.data(), text.size());
+		}
+	};
+
+	//! Reads back every statement of a recording made by WorkloadRecorder, in the order they were recorded.
+	//! Throws a std::runtime_error when it isn't one.
+	inline std::vector<RecordedStatement> read_workload(std::istream& in) {
+		char header[workload::header_size];
+		if(!in.read(header, std::streamsize(workload::header_size)) || std::memcmp(header, workload::header, workload::header_size) != 0) {
+			throw std::runtime_error("Not a workload recording");
+		}
+
+		typedef std::pair<std::shared_ptr<std::string const>, std::shared_ptr<std::string const>> Text;
+		std::vector<Text> texts;
+		std::vector<RecordedStatement> statements;
+		for(char kind; in.get(kind);) {
+			switch(workload::Record(kind)) {
+			case workload::Record::Define: {
+				uint64_t const id = workload::get_varint(in);
+				auto const sql = std::make_shared<std::string const>(workload::get_string(in));
+				auto const shape = std::make_shared<std::string const>(workload::get_string(in));
+				if(id != texts.size()) {
+					throw std::runtime_error("Workload recording defines text " + std::to_string(id) + " out of order");
+				}
+				texts.push_back(Text(sql, shape));
+				break;
+			}
+
+			case workload::Record::Run: {
+				RecordedStatement s;
+				s.stage = workload::get_byte(in) == 1 ? mysql::QueryStage::Query : mysql::QueryStage::Execute;
+				uint64_t const id = workload::get_varint(in);
+				if(id >= texts.size()) {
+					throw std::runtime_error("Workload recording refers to undefined text " + std::to_string(id));
+				}
+				s.sql = texts[id].first;
+				s.fingerprint = texts[id].second;
+				s.start_us = workload::get_varint(in);
+				s.duration_us = workload::get_varint(in);
+				s.thread = uint32_t(workload::get_varint(in));
+				s.connection_id = (unsigned long)workload::get_varint(in);
+				s.failed = workload::get_byte(in) != 0;
+				s.parameters.resize(workload::get_varint(in));
+				for(auto &p : s.parameters) {
+					p.type = RecordedValue::Type(workload::get_byte(in));
+					switch(p.type) {
+					case RecordedValue::Type::Null:
+						break;
+					case RecordedValue::Type::Signed: {
+						uint64_t const zigzag = workload::get_varint(in);
+						p.signed_value = int64_t(zigzag >> 1) ^ -int64_t(zigzag & 1);
+						break;
+					}
+					case RecordedValue::Type::Unsigned:
+						p.unsigned_value = workload::get_varint(in);
+						break;
+					case RecordedValue::Type::String:
+						p.string_value = workload::get_string(in);
+						break;
+					default:
+						throw std::runtime_error("Workload recording has a parameter of unknown type");
+					}
+				}
+				statements.push_back(std::move(s));
+				break;
+			}
+
+			case workload::Record::Forget:
+				texts.clear();
+				break;
+
+			default:
+				throw std::runtime_error("Workload recording has a record of unknown kind");
+			}
+		}
+		return statements;
+	}
+
+	inline std::vector<RecordedStatement> read_workload(std::string const& path) {
+		std::ifstream in(path.c_str(), std::ios::binary);
+		if(!in) {
+			throw std::runtime_error("Can't open " + path);
+		}
+		return read_workload(in);
+	}
+}
@@ -0,0 +1,82 @@
+#include <rusql/rusql.hpp>
+#include <atomic>
+#include <boost/thread.hpp>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	test_init(7);
+
+	typedef rusql::GradientController::Clock Clock;
+	auto const ms = [](int n) { return boost::chrono::milliseconds(n); };
+
+	{
+		rusql::AdaptivePoolPolicy policy;
+		policy.enabled = true;
+		policy.min_connections = 2;
+		policy.max_connections = 16;
+		policy.interval = ms(100);
+		policy.minimum_samples = 5;
+		rusql::GradientController controller;
+		controller.set_policy(policy);
+
+		// feeds one interval of requests that each took latency, with the pool fully used
+		Clock::time_point now = Clock::now();
+		auto const interval = [&](int latency) {
+			size_t const limit = controller.get_limit();
+			for(int i = 0; i < 10; ++i) {
+				controller.record(ms(latency), limit);
+			}
+			now += ms(100);
+			return controller.update(now);
+		};
+
+		test(controller.get_limit() == 2, "the limit starts at its minimum");
+		bool decided = true;
+		for(int i = 0; i < 40; ++i) {
+			decided = decided && interval(1);
+		}
+		test(decided && controller.get_limit() == 16, "at steady latency a busy pool grows to its maximum");
+		size_t const grown = controller.get_limit();
+		for(int i = 0; i < 5; ++i) {
+			interval(20);
+		}
+		test(controller.get_limit() < grown, "rising latency shrinks the pool");
+		test(controller.recent_decisions().back().gradient < 1, "the decision says why");
+		test(!controller.update(now), "no decision without new samples");
+	}
+
+	rusql::AdaptivePoolPolicy policy;
+	policy.enabled = true;
+	policy.min_connections = 1;
+	policy.max_connections = 3;
+	policy.interval = ms(10);
+	policy.minimum_samples = 1;
+	db->set_adaptive_pool(policy);
+	std::atomic<size_t> decisions(0);
+	db->set_pool_size_listener([&decisions](rusql::PoolSizeDecision const&) { ++decisions; });
+
+	test_start_try(2);
+	try {
+		std::vector<std::shared_ptr<boost::thread>> threads;
+		for(int t = 0; t < 8; ++t) {
+			threads.emplace_back(std::make_shared<boost::thread>([&db]() {
+				auto handle = db->get_thread_handle();
+				for(int i = 0; i < 20; ++i) {
+					db->query("DO SLEEP(0.002)");
+				}
+			}));
+		}
+		for(auto &thread : threads) {
+			thread->join();
+		}
+		test(db->number_of_connections() <= 3, "the pool stays within its bounds");
+		test(decisions > 0 && !db->recent_pool_size_decisions().empty(), "decisions are reported");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	return 0;
+}
@@ -0,0 +1,99 @@
+#include <rusql/rusql.hpp>
+#include <boost/thread.hpp>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	test_init(9);
+
+	typedef rusql::AdmissionPolicy::Clock Clock;
+
+	rusql::AdmissionPolicy policy;
+	policy.max_connections = 1;
+	policy.max_interactive_queue = 0;
+	policy.max_wait = boost::chrono::milliseconds(50);
+	db->set_admission_policy(policy);
+
+	test_start_try(9);
+	try {
+		{
+			auto lease = db->acquire();
+			try {
+				db->query("DO 1");
+				fail("a full queue fails at once");
+			} catch(rusql::PoolOverloaded&) {
+				pass("a full queue fails at once");
+			}
+
+			policy.max_interactive_queue = 4;
+			db->set_admission_policy(policy);
+			auto const start = Clock::now();
+			try {
+				db->query("DO 1");
+				fail("waiting too long fails");
+			} catch(rusql::PoolOverloaded&) {
+				test(Clock::now() - start >= boost::chrono::milliseconds(50), "waiting too long fails after max_wait");
+			}
+		}
+		test(db->number_of_rejected() == 2, "rejected requests are counted");
+
+		policy.max_wait = boost::chrono::seconds(10);
+		db->set_admission_policy(policy);
+		{
+			auto lease = db->acquire();
+			boost::mutex order_mutex;
+			std::vector<std::string> order;
+			auto waiter = [&db, &order_mutex, &order](rusql::Priority priority, std::string name) {
+				auto handle = db->get_thread_handle();
+				rusql::PriorityScope scope(priority);
+				auto l = db->acquire();
+				boost::mutex::scoped_lock lock(order_mutex);
+				order.push_back(name);
+			};
+			boost::thread batch(waiter, rusql::Priority::Batch, "batch");
+			while(db->number_of_waiting(rusql::Priority::Batch) == 0) {
+				boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+			}
+			boost::thread interactive(waiter, rusql::Priority::Interactive, "interactive");
+			while(db->number_of_waiting(rusql::Priority::Interactive) == 0) {
+				boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+			}
+			test(db->number_of_active_connections() == 1, "the pool doesn't grow beyond max_connections");
+
+			lease.release();
+			batch.join();
+			interactive.join();
+			test(order.size() == 2 && order[0] == "interactive", "interactive requests go before batch requests");
+		}
+
+		rusql::CircuitBreakerPolicy breaker;
+		breaker.enabled = true;
+		breaker.minimum_requests = 4;
+		breaker.open_for = boost::chrono::milliseconds(100);
+		db->set_circuit_breaker(breaker);
+		for(int i = 0; i < 4; ++i) {
+			try {
+				db->query("SELECT * FROM rusql_no_such_table");
+			} catch(rusql::mysql::SQLError&) {}
+		}
+		test(db->get_circuit_state() == rusql::CircuitBreaker::State::Open, "errors open the circuit");
+		try {
+			db->query("DO 1");
+			fail("an open circuit fails requests");
+		} catch(rusql::CircuitOpen&) {
+			pass("an open circuit fails requests");
+		}
+
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(150));
+		db->query("DO 1");
+		test(db->get_circuit_state() == rusql::CircuitBreaker::State::Closed, "a successful probe closes the circuit");
+		db->query("DO 1");
+		pass("requests go through again");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	return 0;
+}
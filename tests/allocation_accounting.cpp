@@ -0,0 +1,96 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/allocations.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include <boost/thread.hpp>
+#include "test.hpp"
+
+#include <sstream>
+
+//! Keeps the events of one stage.
+struct StageObserver : rusql::mysql::QueryObserver {
+	StageObserver(rusql::mysql::QueryStage const stage_)
+	: stage(stage_)
+	, events(0)
+	, allocations(0)
+	, allocated_bytes(0)
+	{}
+
+	void on_event(rusql::mysql::QueryEvent const& event) override {
+		if(event.stage == stage) {
+			++events;
+			allocations += event.allocations;
+			allocated_bytes += event.allocated_bytes;
+		}
+	}
+
+	rusql::mysql::QueryStage const stage;
+	uint64_t events;
+	uint64_t allocations;
+	uint64_t allocated_bytes;
+};
+
+int main(int, char *[]) {
+	test_init(7);
+
+	test(rusql::mysql::is_counting_allocations(), "allocations are counted when rusql_count_allocations is linked");
+
+	{
+		auto const before = rusql::mysql::thread_allocations();
+		void *p = ::operator new(100);
+		auto const allocated = rusql::mysql::allocations_since(before);
+		::operator delete(p);
+		test(allocated.allocations == 1 && allocated.bytes == 100, "operator new is counted");
+	}
+
+	{
+		auto const before = rusql::mysql::thread_allocations();
+		boost::thread thread([]() {
+			for(int i = 0; i < 1000; ++i) {
+				::operator delete(::operator new(10));
+			}
+		});
+		thread.join();
+		test(rusql::mysql::allocations_since(before).allocations < 1000, "allocations are counted per thread");
+	}
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	std::string const people = "SELECT name FROM people WHERE id > ?";
+	fake.script(people, FakeBackend::Result({"name"}).row({"a name too long for the small string buffer"}).row({"bob"}));
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+
+	test_start_try(4);
+	try {
+		auto prepares = std::make_shared<StageObserver>(rusql::mysql::QueryStage::Prepare);
+		db->set_query_observer(prepares);
+		db->execute(people, 0);
+		test(prepares->events == 1 && prepares->allocations > 0 && prepares->allocated_bytes >= prepares->allocations, "stages report their allocations");
+
+		auto statistics = std::make_shared<rusql::StatementStatistics>();
+		db->set_query_observer(statistics);
+		for(int i = 0; i < 3; ++i) {
+			std::string name;
+			auto statement = db->execute(people, i);
+			statement.bind_results(name);
+			while(statement.fetch()) {}
+		}
+		auto const report = statistics->report();
+		test(report.size() == 1 && report.front().allocations > 0 && report.front().allocated_bytes > report.front().allocations, "statement statistics count allocations");
+
+		std::ostringstream table;
+		statistics->write_report(table);
+		test(table.str().find("\tallocations\tallocated_bytes\t") != std::string::npos, "the report has the allocations");
+
+		std::ostringstream row;
+		row << '\t' << report.front().allocations << '\t' << report.front().allocated_bytes << '\t' << report.front().fingerprint;
+		test(table.str().find(row.str()) != std::string::npos, "the report has the allocations of each fingerprint");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.reset();
+	return 0;
+}
@@ -0,0 +1,65 @@
+#include <rusql/rusql.hpp>
+#include <future>
+#include <vector>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	const int NUM_QUERIES = 8;
+	test_init(10);
+
+	db->set_async_workers(4);
+	db->execute("CREATE TABLE rusqltest (`id` INT(10) NOT NULL, `value` VARCHAR(10) NULL)");
+
+	test_start_try(2);
+	try {
+		std::vector<std::future<rusql::MaterializedResult>> inserts;
+		for(int i = 0; i < NUM_QUERIES; ++i) {
+			inserts.emplace_back(db->async_execute("INSERT INTO rusqltest VALUES (?, ?)", i, std::to_string(i * i)));
+		}
+		bool all_empty = true;
+		for(auto &insert : inserts) {
+			all_empty = all_empty && insert.get().rows.empty();
+		}
+		test(all_empty, "inserts return no rows");
+
+		auto count = db->async_execute("SELECT COUNT(*) FROM rusqltest").get();
+		test(count.rows.size() == 1 && count.rows[0].get<int>(0) == NUM_QUERIES, "all inserts were done");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	test_start_try(7);
+	try {
+		db->execute("INSERT INTO rusqltest VALUES (?, NULL)", 100);
+		auto low = db->async_execute("SELECT id, value FROM rusqltest WHERE id < ? ORDER BY id", 3);
+		auto null = db->async_execute("SELECT value FROM rusqltest WHERE id = ?", 100);
+
+		auto result = low.get();
+		test(result.columns->size() == 2 && (*result.columns)[1] == "value", "column names are materialized");
+		test(result.rows.size() == 3, "three rows");
+		test(result.rows[2].get<int>("id") == 2, "int column by name");
+		test(result.rows[2].get<std::string>(1) == "4", "string column by index");
+
+		auto null_result = null.get();
+		test(null_result.rows.size() == 1, "one row with NULL");
+		test(null_result.rows[0].is_null(0), "NULL cell is NULL");
+		test(!null_result.rows[0].get<boost::optional<std::string>>("value"), "NULL cell as optional");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	auto failing = db->async_execute("SELECT * FROM nonexistant");
+	try {
+		failing.get();
+		fail("errors are delivered through the future");
+	} catch(std::exception &e) {
+		pass("errors are delivered through the future");
+	}
+
+	db->execute("DROP TABLE rusqltest");
+	return 0;
+}
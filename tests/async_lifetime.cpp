@@ -0,0 +1,52 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include <boost/thread.hpp>
+#include "test.hpp"
+
+#include <future>
+
+int main(int, char *[]) {
+	test_init(2);
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	std::string const select = "SELECT value FROM rusqltest";
+	fake.script(select, FakeBackend::Result({"value"}).row({"20"}));
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+	db->set_async_workers(2);
+
+	test_start_try(2);
+	try {
+		// The job keeps the Database alive, and lets go of it on its worker after the caller did. The future would
+		// keep it too, so the result is handed over another way.
+		std::weak_ptr<rusql::Database> const gone = db;
+		std::promise<void> dropped;
+		std::shared_future<void> const go = dropped.get_future().share();
+		std::promise<uint64_t> value;
+		std::future<uint64_t> result = value.get_future();
+		{
+			std::shared_ptr<rusql::Database> const kept = db;
+			db->submit([kept, go, &value, &select](rusql::Connection& connection) {
+				go.wait();
+				value.set_value(connection.select_query(select).get_uint64(0));
+			});
+		}
+		db.reset();
+		dropped.set_value();
+		test(result.get() == 20, "a job runs after the caller dropped the Database");
+
+		bool destroyed = false;
+		for(int i = 0; i < 500 && !destroyed; ++i) {
+			destroyed = gone.expired();
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(2));
+		}
+		test(destroyed, "the Database can be destroyed on one of its own workers");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	return 0;
+}
@@ -0,0 +1,56 @@
+#include <rusql/rusql.hpp>
+#include <future>
+#include <vector>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	test_init(7);
+
+	db->execute("CREATE TABLE rusqltest (`id` INT(10) NOT NULL, `owner` INT(10) NOT NULL, `name` VARCHAR(10) NOT NULL)");
+	db->execute("INSERT INTO rusqltest VALUES (?, ?, ?), (?, ?, ?), (?, ?, ?), (?, ?, ?)", 1, 10, "a", 2, 20, "b", 3, 20, "c", 4, 30, "d");
+
+	try {
+		rusql::BatchLoader<int> wrong(db, "SELECT * FROM rusqltest WHERE id = ?", "id");
+		fail("query without IN (?) is rejected");
+	} catch(std::exception &e) {
+		pass("query without IN (?) is rejected");
+	}
+
+	test_start_try(6);
+	try {
+		rusql::BatchLoader<int> loader(db, "SELECT id, owner, name FROM rusqltest WHERE owner IN (?) ORDER BY id", "owner", 4, boost::chrono::milliseconds(20));
+
+		auto ten = loader.load(10);
+		auto twenty = loader.load(20);
+		auto twenty_again = loader.load(20);
+		auto missing = loader.load(99);
+		auto thirty = loader.load(30);
+
+		auto rows = ten.get();
+		test(rows.size() == 1 && rows[0].get<std::string>("name") == "a", "single row for key");
+		rows = twenty.get();
+		test(rows.size() == 2 && rows[0].get<int>("id") == 2 && rows[1].get<int>("id") == 3, "several rows for key");
+		test(twenty_again.get().size() == 2, "duplicate key gets the same rows");
+		test(missing.get().empty(), "missing key gets no rows");
+		rows = thirty.get();
+		test(rows.size() == 1 && rows[0].get<std::string>(2) == "d", "every key of a full batch is looked up");
+
+		std::vector<std::future<rusql::BatchLoader<int>::Rows>> many;
+		for(int i = 0; i < 50; ++i) {
+			many.emplace_back(loader.load(10 * (i % 4 + 1)));
+		}
+		size_t total = 0;
+		for(auto &f : many) {
+			total += f.get().size();
+		}
+		test(total == 13 + 13 * 2 + 12 * 1 + 12 * 0, "interleaved loads all complete");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db->execute("DROP TABLE rusqltest");
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <rusql/rusql.hpp>
+#include <boost/optional.hpp>
+#include <sstream>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	const int NUM_ROWS = 10000;
+	test_init(8);
+
+	db->execute("CREATE TABLE rusqltest (`id` INT(10) NOT NULL, `value` VARCHAR(20) NULL)");
+
+	test_start_try(3);
+	try {
+		int next = 0;
+		auto loaded = db->bulk_load("rusqltest", {"id", "value"}, [&next](rusql::BulkWriter &writer) -> bool {
+			for(int i = 0; i < 1000 && next < NUM_ROWS; ++i, ++next) {
+				writer.row(next, "row " + std::to_string(next));
+			}
+			return next < NUM_ROWS;
+		});
+		test(loaded == NUM_ROWS, "bulk_load reports the number of rows loaded");
+
+		auto count = db->select_query("SELECT COUNT(*), SUM(id) FROM rusqltest");
+		test(count.get_uint64(0) == NUM_ROWS, "all rows were loaded");
+		test(count.get_uint64(1) == uint64_t(NUM_ROWS) * (NUM_ROWS - 1) / 2, "all ids were loaded");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db->execute("DELETE FROM rusqltest");
+
+	test_start_try(3);
+	try {
+		db->bulk_load("rusqltest", {"id", "value"}, [](rusql::BulkWriter &writer) -> bool {
+			writer.row(1, std::string("tab\there"));
+			writer.row(2, std::string("back\\slash\nnewline"));
+			writer.row(3, boost::optional<std::string>());
+			return false;
+		});
+		auto value = db->select_query("SELECT value FROM rusqltest WHERE id = 1");
+		test(value.get_string(0) == "tab\there", "tabs are escaped");
+		value = db->select_query("SELECT value FROM rusqltest WHERE id = 2");
+		test(value.get_string(0) == "back\\slash\nnewline", "backslashes and newlines are escaped");
+		value = db->select_query("SELECT value FROM rusqltest WHERE id = 3");
+		test(value.is_null(0), "empty optional is loaded as NULL");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	test_start_try(1);
+	try {
+		std::istringstream input("10\tten\n11\t\\N\n");
+		test(db->bulk_load("rusqltest", {"id", "value"}, input) == 2, "stream is loaded as is");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	try {
+		db->query("LOAD DATA LOCAL INFILE '/etc/passwd' INTO TABLE rusqltest");
+		fail("LOCAL INFILE outside of bulk_load is refused");
+	} catch(std::exception &e) {
+		pass("LOCAL INFILE outside of bulk_load is refused");
+	}
+
+	db->execute("DROP TABLE rusqltest");
+	return 0;
+}
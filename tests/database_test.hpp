@@ -44,7 +44,7 @@ void cleanup_embedded(void) {
 	// TODO
 }
 
-std::shared_ptr<rusql::Database> get_database(int argc, char *argv[]) {
+rusql::Database::ConstructionInfo get_construction_info(int argc, char *argv[]) {
 	is_embedded = false;
 	if(argc == 1) {
 		is_embedded = true;
@@ -56,12 +56,15 @@ std::shared_ptr<rusql::Database> get_database(int argc, char *argv[]) {
 		atexit(cleanup_embedded);
 		auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo());
 		db->execute("CREATE DATABASE rusqltest");
-		return std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("rusqltest"));
+		return rusql::Database::ConstructionInfo("rusqltest");
 	} else if(argc == 5) {
-		return std::make_shared<rusql::Database>(
-				rusql::Database::ConstructionInfo{argv[1], argv[2], argv[3], argv[4]});
+		return rusql::Database::ConstructionInfo{argv[1], argv[2], argv[3], argv[4]};
 	} else {
 		std::cout << "1..0 # SKIP Invalid parameters" << std::endl;
 		exit(0);
 	}
 }
+
+std::shared_ptr<rusql::Database> get_database(int argc, char *argv[]) {
+	return std::make_shared<rusql::Database>(get_construction_info(argc, argv));
+}
@@ -0,0 +1,83 @@
+#include <rusql/rusql.hpp>
+#include <boost/thread.hpp>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	test_init(10);
+
+	typedef rusql::Deadline::Clock Clock;
+
+	{
+		rusql::CancellationToken token;
+		rusql::CancellationToken copy = token;
+		int called = 0;
+		size_t const forgotten = token.on_cancel([&called]() { called += 10; });
+		token.on_cancel([&called]() { ++called; });
+		token.forget(forgotten);
+		copy.cancel();
+		copy.cancel();
+		test(token.is_cancelled() && called == 1, "cancelling a copy runs the remaining callbacks once");
+	}
+
+	test_start_try(9);
+	try {
+		try {
+			db->execute(rusql::Deadline::after(boost::chrono::seconds(-1)), "SELECT 1");
+			fail("an expired deadline stops the statement before it runs");
+		} catch(rusql::DeadlineExceeded&) {
+			pass("an expired deadline stops the statement before it runs");
+		}
+
+		auto result = db->execute(rusql::Deadline::after(boost::chrono::seconds(10)), "SELECT ? AS x", 5);
+		result.bind_all_self();
+		test(result.fetch() && result.get<int>("x") == 5, "statements that finish in time return their rows");
+
+		rusql::Connection connection(db);
+		unsigned long const thread_id = connection.thread_id();
+		auto const start = Clock::now();
+		try {
+			connection.execute(rusql::Deadline::after(boost::chrono::milliseconds(100)), "SELECT SLEEP(5)");
+			fail("a statement past its deadline is killed");
+		} catch(rusql::DeadlineExceeded&) {
+			pass("a statement past its deadline is killed");
+		}
+		test(Clock::now() - start < boost::chrono::seconds(3), "the kill doesn't wait for the statement");
+		test(connection.thread_id() == thread_id, "the connection survives the kill");
+		test(connection.execute("SELECT 1").fetch(), "the connection is usable after the kill");
+
+		rusql::CancellationToken token;
+		boost::thread canceller([token]() mutable {
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+			token.cancel();
+		});
+		try {
+			connection.query(token, "DO SLEEP(5)");
+			fail("a statement is killed when its token is cancelled");
+		} catch(rusql::QueryCancelled&) {
+			pass("a statement is killed when its token is cancelled");
+		}
+		canceller.join();
+
+		try {
+			auto rs = db->select_query(token, "SELECT 1");
+			fail("a cancelled token stops later statements too");
+		} catch(rusql::QueryCancelled&) {
+			pass("a cancelled token stops later statements too");
+		}
+
+		auto statement = connection.prepare("SELECT SLEEP(?)");
+		try {
+			statement.bind_parameters(5).execute(rusql::Deadline::after(boost::chrono::milliseconds(100)));
+			fail("prepared statements can have a deadline");
+		} catch(rusql::DeadlineExceeded&) {
+			pass("prepared statements can have a deadline");
+		}
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include "test.hpp"
+
+int main(int, char *[]) {
+	test_init(12);
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	fake.script("SELECT id, name FROM people", FakeBackend::Result({"id", "name"})
+		.row({"1", "alice"})
+		.row_with_nulls({std::string("2"), boost::none})
+		.row({"3", "a name that is longer than any buffer the client starts with"}));
+	fake.script("SELECT id, name FROM people WHERE id > ?", FakeBackend::Result({"id", "name"}).row({"3", "carol"}));
+	FakeBackend::Result insert;
+	insert.affected_rows = 1;
+	insert.insert_id = 42;
+	fake.script("INSERT INTO people (name) VALUES (?)", insert);
+	fake.script_error("SELECT broken", "You have an error in your SQL syntax");
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+
+	test_start_try(12);
+	try {
+		{
+			auto rs = db->select_query("SELECT id, name FROM people");
+			test(rs.get<int>("id") == 1 && rs.get<std::string>("name") == "alice", "text protocol serves the first row");
+			rs.next();
+			test(!rs.get<boost::optional<std::string>>("name"), "text protocol serves NULL");
+			rs.next();
+			rs.next();
+			test(!rs, "text protocol ends after the scripted rows");
+		}
+
+		{
+			int id = 0;
+			boost::optional<std::string> name;
+			auto statement = db->execute("SELECT id, name FROM people");
+			statement.bind_results(id, name);
+			int rows = 0;
+			std::string last;
+			while(statement.fetch()) {
+				++rows;
+				last = name ? *name : "";
+			}
+			test(rows == 3, "prepared statement serves every row");
+			test(id == 3 && last == "a name that is longer than any buffer the client starts with", "prepared statement converts and refetches long values");
+		}
+
+		{
+			auto statement = db->execute("SELECT id, name FROM people WHERE id > ?", 2);
+			statement.bind_all_self();
+			test(statement.fetch() && statement.get<std::string>("name") == "carol", "named access works on bind_all_self");
+			test(!statement.fetch(), "prepared statement ends after the scripted rows");
+		}
+
+		test(db->execute("INSERT INTO people (name) VALUES (?)", "dave").insert_id() == 42, "scripted insert id is returned");
+
+		try {
+			db->query("SELECT broken");
+			fail("scripted error is thrown");
+		} catch(rusql::mysql::SQLError &e) {
+			test(std::string(e.what()).find("error in your SQL syntax") != std::string::npos, "scripted error is thrown");
+		}
+
+		try {
+			db->execute("SELECT nothing");
+			fail("unscripted statement fails");
+		} catch(rusql::mysql::SQLError &) {
+			pass("unscripted statement fails");
+		}
+
+		test(db->select_query("SELECT id, name FROM people").get<int>(0) == 1, "connection is usable after errors");
+		test(fake.number_of_statements() == 5, "statements are counted");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.reset();
+	return 0;
+}
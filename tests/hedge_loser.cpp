@@ -0,0 +1,67 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include <boost/thread.hpp>
+#include "test.hpp"
+
+int main(int, char *[]) {
+	test_init(6);
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	std::string const people = "SELECT name FROM people WHERE id > ?";
+	fake.script(people, FakeBackend::Result({"name"}).row({"alice"}).row({"bob"}));
+	for(int id = 0; id < 4; ++id) {
+		fake.script("SELECT name FROM people WHERE id = " + std::to_string(id), FakeBackend::Result({"name"}).row({"alice"}));
+	}
+
+	rusql::mysql::BackendScope scope(fake);
+	rusql::Database::ConstructionInfo const info("fake");
+
+	test_start_try(6);
+	try {
+		rusql::ReplicatedDatabase db(info, {info, info});
+		rusql::HedgePolicy policy;
+		policy.initial_delay = boost::chrono::milliseconds(20);
+		policy.minimum_delay = boost::chrono::milliseconds(0);
+		policy.minimum_samples = 3;
+		db.set_hedge_policy(policy);
+
+		// the first copy hangs until it is killed
+		fake.stall(people, 1, boost::chrono::seconds(10));
+		auto const start = boost::chrono::steady_clock::now();
+		auto const result = db.hedged_select(people, 0);
+		auto const took = boost::chrono::steady_clock::now() - start;
+		test(result.rows.size() == 2 && result.rows[1].get<std::string>("name") == "bob", "the faster copy's rows are returned");
+		test(db.number_of_hedges() == 1 && took < boost::chrono::seconds(5), "the slow replica is hedged rather than waited for");
+		test(fake.number_of_kills() == 1, "the slower copy is killed with KILL QUERY");
+
+		bool freed = false;
+		for(int i = 0; i < 500 && !freed; ++i) {
+			freed = db.get_replica(0)->number_of_active_connections() == 0 && db.get_replica(1)->number_of_active_connections() == 0;
+			if(!freed) {
+				boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+			}
+		}
+		test(freed, "the killed copy gives its connection back");
+
+		for(int id = 0; id < 3; ++id) {
+			db.hedged_select("SELECT name FROM people WHERE id = " + std::to_string(id));
+		}
+		test(db.hedge_delay("SELECT name FROM people WHERE id = 3") < policy.initial_delay, "statements that differ in their literals share their latencies");
+
+		rusql::HedgePolicy one = policy;
+		one.minimum_samples = 2;
+		one.max_statements = 1;
+		rusql::ReplicatedDatabase capped(info, {info, info});
+		capped.set_hedge_policy(one);
+		capped.hedged_select(people, 0);
+		capped.hedged_select("SELECT name FROM people WHERE id = 0");
+		capped.hedged_select("SELECT name FROM people WHERE id = 1");
+		test(capped.hedge_delay(people) == one.initial_delay && capped.hedge_delay("SELECT 1") < one.initial_delay, "statements beyond max_statements share one set of latencies");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	return 0;
+}
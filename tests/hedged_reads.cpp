@@ -0,0 +1,62 @@
+#include <rusql/rusql.hpp>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto info = get_construction_info(argc, argv);
+	test_init(9);
+
+	{
+		typedef rusql::LatencyHistogram H;
+		H histogram;
+		test(histogram.percentile(0.99) == H::Clock::duration::zero(), "empty histogram has no percentiles");
+		for(uint64_t us = 1; us <= 1000; ++us) {
+			histogram.record_microseconds(us);
+		}
+		auto const p50 = boost::chrono::duration_cast<boost::chrono::microseconds>(histogram.percentile(0.5)).count();
+		auto const p99 = boost::chrono::duration_cast<boost::chrono::microseconds>(histogram.percentile(0.99)).count();
+		test(p50 >= 500 && p50 <= 500 + 500 / long(H::sub_buckets), "p50 is within a bucket of the true value");
+		test(p99 >= 990 && p99 <= 990 + 990 / long(H::sub_buckets), "p99 is within a bucket of the true value");
+		histogram.decay();
+		// odd bucket counts round down
+		test(histogram.count() <= 500 && histogram.count() > 450, "decay halves the samples");
+
+		bool bounded = true;
+		for(uint64_t us = 0; us < 100000; us += 7) {
+			bounded = bounded && us <= H::bucket_upper_bound(H::bucket_for(us)) && (H::bucket_for(us) == 0 || us > H::bucket_upper_bound(H::bucket_for(us) - 1));
+		}
+		test(bounded, "every value falls in the bucket whose bounds contain it");
+	}
+
+	// the test server plays the primary as well as both replicas
+	rusql::ReplicatedDatabase db(info, {info, info});
+	db.query("CREATE TABLE rusqltest (`id` INT(10) NOT NULL)");
+	db.execute("INSERT INTO rusqltest VALUES (?), (?)", 1, 2);
+
+	test_start_try(4);
+	try {
+		try {
+			db.hedged_select("DELETE FROM rusqltest");
+			fail("writes can't be hedged");
+		} catch(rusql::mysql::SQLError&) {
+			pass("writes can't be hedged");
+		}
+
+		auto result = db.hedged_select("SELECT id FROM rusqltest WHERE id > ? ORDER BY id", 0);
+		test(result.rows.size() == 2 && result.rows[1].get<int>("id") == 2, "hedged_select returns the rows");
+
+		rusql::HedgePolicy always;
+		always.initial_delay = boost::chrono::milliseconds(0);
+		db.set_hedge_policy(always);
+		unsigned long long const before = db.number_of_hedges();
+		result = db.hedged_select("SELECT id FROM rusqltest WHERE id > ? ORDER BY id", 1);
+		test(result.rows.size() == 1 && result.rows[0].get<int>("id") == 2, "a hedged query still returns the rows once");
+		test(db.number_of_hedges() == before + 1, "with no delay, the query is sent to the other replica too");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.query("DROP TABLE rusqltest");
+	return 0;
+}
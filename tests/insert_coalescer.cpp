@@ -0,0 +1,76 @@
+#include <rusql/rusql.hpp>
+#include <boost/thread.hpp>
+#include <future>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	const int NUM_THREADS = 8;
+	const int ROWS_PER_THREAD = 100;
+	test_init(6);
+
+	db->execute("CREATE TABLE rusqltest (`thread` INT(10) NOT NULL, `seq` INT(10) NOT NULL, `value` VARCHAR(20) NOT NULL)");
+
+	try {
+		rusql::InsertCoalescer<int, int> wrong(db, "INSERT INTO rusqltest VALUES (?, ?, ?)");
+		fail("placeholder count is checked");
+	} catch(std::exception &e) {
+		pass("placeholder count is checked");
+	}
+
+	test_start_try(3);
+	try {
+		rusql::InsertCoalescer<int, int, std::string> coalescer(db, "INSERT INTO rusqltest VALUES (?, ?, ?)", 32, boost::chrono::milliseconds(5));
+
+		std::vector<std::shared_ptr<boost::thread>> threads;
+		boost::mutex errors_mutex;
+		int errors = 0;
+		for(int i = 0; i < NUM_THREADS; ++i) {
+			threads.emplace_back(std::make_shared<boost::thread>([i, &coalescer, &errors, &errors_mutex]() {
+				std::vector<std::future<void>> written;
+				for(int j = 0; j < ROWS_PER_THREAD; ++j) {
+					written.emplace_back(coalescer.insert(i, j, std::to_string(i) + "," + std::to_string(j)));
+				}
+				for(auto &w : written) {
+					try {
+						w.get();
+					} catch(...) {
+						boost::mutex::scoped_lock lock(errors_mutex);
+						++errors;
+					}
+				}
+			}));
+		}
+		for(auto &thread : threads) {
+			thread->join();
+		}
+		test(errors == 0, "every insert completed");
+
+		auto count = db->select_query("SELECT COUNT(*) FROM rusqltest");
+		test(count.get_uint64(0) == NUM_THREADS * ROWS_PER_THREAD, "every row was written");
+
+		auto value = db->select_query("SELECT value FROM rusqltest WHERE thread = 3 AND seq = 42");
+		test(value && value.get_string(0) == "3,42", "rows kept their values");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	test_start_try(2);
+	try {
+		rusql::InsertCoalescer<int, int, std::string> coalescer(db, "INSERT INTO rusqltest VALUES (?, ?, ?)", 1000, boost::chrono::seconds(60));
+		coalescer.flush();
+		auto single = coalescer.insert(99, 0, "flushed");
+		test(single.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout, "flush() of an empty buffer doesn't flush the next row");
+		coalescer.flush();
+		single.get();
+		pass("flush() writes a partial batch");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db->execute("DROP TABLE rusqltest");
+	return 0;
+}
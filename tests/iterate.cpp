@@ -5,7 +5,7 @@
 
 int main(int argc, char *argv[]) {
 	auto db = get_database(argc, argv);
-	test_init(13);
+	test_init(19);
 
 	test_start_try(3);
 	try {
@@ -56,5 +56,43 @@ int main(int argc, char *argv[]) {
 	test(rows[2].id == 3, "id 3 correct");
 	test(rows[2].value == "def", "value 3 correct");
 
+	test_start_try(3);
+	try {
+		auto statement = db->execute("SELECT * FROM rusqltest");
+		int id = 0;
+		std::string value;
+		statement.bind_results(id, value);
+		int count = 0;
+		std::string values;
+		for(auto &row : statement) {
+			(void)row;
+			++count;
+			values += value;
+		}
+		test(count == 3, "statement range visited every row");
+		test(values == "abcdef", "statement range visited rows in order");
+		test(statement.begin() == statement.end(), "statement range is empty after iterating");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	test_start_try(3);
+	try {
+		auto result = db->select_query("SELECT id FROM rusqltest");
+		uint64_t sum = 0;
+		for(auto &row : result) {
+			sum += row.get_uint64(0);
+		}
+		test(sum == 6, "result set range visited every row");
+		test(!result, "result set is closed after iterating");
+
+		auto empty = db->select_query("SELECT id FROM rusqltest WHERE id > 3");
+		test(empty.begin() == empty.end(), "empty result set gives an empty range");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
 	return 0;
 }
@@ -0,0 +1,72 @@
+#include <rusql/rusql.hpp>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	test_init(10);
+
+	db->execute("CREATE TABLE rusqltest (`id` INT(10) NOT NULL)");
+	db->execute("INSERT INTO rusqltest VALUES (?), (?), (?)", 1, 2, 3);
+
+	test_start_try(5);
+	try {
+		int const active_before = db->number_of_active_connections();
+		auto lease = db->acquire();
+		test(db->number_of_active_connections() == active_before + 1, "lease keeps its connection busy");
+
+		lease.query("SET @rusql_lease = 42");
+		test(lease.select_query("SELECT @rusql_lease").get_uint64(0) == 42, "session variables survive between statements");
+
+		lease.query("CREATE TEMPORARY TABLE rusqltemp (`id` INT(10) NOT NULL)");
+		lease.execute("INSERT INTO rusqltemp VALUES (?)", 7);
+		test(lease.select_query("SELECT id FROM rusqltemp").get_uint64(0) == 7, "temporary tables survive between statements");
+
+		lease.release();
+		test(db->number_of_active_connections() == active_before, "release gives the connection back");
+		test(lease.is_released(), "lease knows it was released");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	test_start_try(4);
+	try {
+		std::string const q = "SELECT id FROM rusqltest ORDER BY id";
+		uint64_t id = 0;
+		{
+			auto lease = db->acquire();
+			auto &statement = lease.execute_cached(q);
+			test(&statement == &lease.prepare_cached(q), "cached statement is handed back");
+			statement.bind_results(id);
+			test(statement.fetch() && id == 1, "cached statement returns rows");
+			// released with two rows left unfetched
+		}
+
+		auto lease = db->acquire();
+		auto &statement = lease.execute_cached(q);
+		statement.bind_results(id);
+		int rows = 0;
+		for(auto &row : statement) {
+			(void)row;
+			++rows;
+		}
+		test(rows == 3, "cached statement is reusable after release with unfetched rows");
+		test(lease.select_query("SELECT COUNT(*) FROM rusqltest").get_uint64(0) == 3, "connection is reusable after release with unfetched rows");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	try {
+		auto lease = db->acquire();
+		auto moved = std::move(lease);
+		lease.query("SELECT 1");
+		fail("using a moved-from lease throws");
+	} catch(rusql::LeaseError &e) {
+		pass("using a moved-from lease throws");
+	}
+
+	db->execute("DROP TABLE rusqltest");
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include <boost/thread.hpp>
+#include "test.hpp"
+
+#include <atomic>
+
+int main(int, char *[]) {
+	const int NUM_THREADS = 8;
+	const int ITERATIONS = 500;
+	test_init(2);
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	std::string const select = "SELECT value FROM rusqltest";
+	std::string const update = "UPDATE rusqltest SET value=value+1";
+	fake.script(select, FakeBackend::Result({"value"}).row({"20"}));
+	fake.script(update, FakeBackend::Result());
+	fake.script("START TRANSACTION", FakeBackend::Result());
+	fake.script("COMMIT", FakeBackend::Result());
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+
+	test_start_try(2);
+	try {
+		// Leases and transactions run statements on their connection without the pool's lock, while the
+		// other threads look at every connection under it.
+		std::atomic<int> errors(0);
+		std::atomic<bool> done(false);
+		std::vector<std::shared_ptr<boost::thread>> threads;
+		threads.emplace_back(std::make_shared<boost::thread>([&]() {
+			auto thread_handle = db->get_thread_handle();
+			try {
+				for(int i = 0; i < ITERATIONS; ++i) {
+					auto lease = db->acquire();
+					lease.query(update);
+					for(auto rs = lease.select_query(select); rs; rs.next()) {}
+					auto transaction = db->begin();
+					transaction.query(update);
+					transaction.commit();
+				}
+			} catch(std::exception &e) {
+				diag(e);
+				++errors;
+			}
+			done = true;
+		}));
+		for(int t = 1; t < NUM_THREADS; ++t) {
+			threads.emplace_back(std::make_shared<boost::thread>([&]() {
+				auto thread_handle = db->get_thread_handle();
+				try {
+					while(!done) {
+						for(auto rs = db->select_query(select); rs; rs.next()) {}
+						db->number_of_active_connections();
+						db->get_pool_metrics();
+					}
+				} catch(std::exception &e) {
+					diag(e);
+					++errors;
+				}
+			}));
+		}
+		for(auto &thread : threads) {
+			thread->join();
+		}
+		test(errors == 0, "leases and transactions run next to the rest of the pool");
+		test(db->number_of_active_connections() == 0, "every connection is free afterwards");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.reset();
+	return 0;
+}
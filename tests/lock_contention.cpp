@@ -0,0 +1,146 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include <boost/thread.hpp>
+#include "test.hpp"
+
+#include <sstream>
+
+int main(int, char *[]) {
+	const int THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32};
+	const int NUM_ROUNDS = sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]);
+	const int ITERATIONS = 500;
+
+	test_init(4 + NUM_ROUNDS);
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	std::string const select = "SELECT value FROM rusqltest";
+	std::string const update = "UPDATE rusqltest SET value=value+1";
+	fake.script(select, FakeBackend::Result({"value"}).row({"20"}));
+	fake.script(update, FakeBackend::Result());
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+
+	auto const find = [&db](rusql::LockSite const site) {
+		for(auto const &p : db->get_lock_profile()) {
+			if(p.site == site) {
+				return p;
+			}
+		}
+		rusql::LockSiteProfile none = rusql::LockSiteProfile();
+		none.site = site;
+		return none;
+	};
+
+	test_start_try(4);
+	try {
+		db->query(update);
+		test(db->get_lock_profile().empty(), "nothing is profiled by default");
+
+		db->set_lock_profiling(true);
+		db->query(update);
+		db->number_of_connections();
+		auto const query = find(rusql::LockSite::Query);
+		test(query.acquisitions == 1 && query.contended == 0 && find(rusql::LockSite::Inspect).acquisitions == 1, "lock acquisitions are counted per site");
+
+		// A request that waits for a free connection doesn't hold the lock meanwhile
+		rusql::AdmissionPolicy policy;
+		policy.max_connections = 1;
+		db->set_admission_policy(policy);
+		db->clear_lock_profile();
+		{
+			auto lease = db->acquire();
+			boost::thread waiter([&db, &select]() {
+				auto thread_handle = db->get_thread_handle();
+				for(auto rs = db->select_query(select); rs; rs.next()) {}
+			});
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+			lease.release();
+			waiter.join();
+		}
+		auto const waited = find(rusql::LockSite::SelectQuery);
+		test(waited.acquisitions == 1 && waited.total_hold < boost::chrono::milliseconds(40), "waiting for a connection doesn't count as holding the lock");
+		test(find(rusql::LockSite::Acquire).acquisitions == 1, "leases are counted");
+		db->set_admission_policy(rusql::AdmissionPolicy());
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	// The workload of test_threads, with ever more threads: how much longer do they wait for the pool's lock?
+	diag("threads\tacquisitions\tcontended\twait_ms\tp99_wait_ms\tmax_wait_ms\thold_ms\tp99_hold_ms");
+	for(int round = 0; round < NUM_ROUNDS; ++round) {
+		int const num_threads = THREAD_COUNTS[round];
+		db->clear_lock_profile();
+
+		std::vector<std::shared_ptr<boost::thread>> threads;
+		boost::mutex output_mutex;
+		int failures = 0;
+		for(int i = 0; i < num_threads; ++i) {
+			threads.emplace_back(std::make_shared<boost::thread>([&db, &output_mutex, &failures, &select, &update]() {
+				auto thread_handle = db->get_thread_handle();
+				try {
+					for(int j = 0; j < ITERATIONS; ++j) {
+						{
+							auto statement = db->execute(select);
+							uint64_t value;
+							statement.bind_results(value);
+							if(!statement.fetch() || statement.fetch()) {
+								boost::mutex::scoped_lock lock(output_mutex);
+								++failures;
+								return;
+							}
+						}
+						db->query(update);
+					}
+				} catch(std::exception &e) {
+					boost::mutex::scoped_lock lock(output_mutex);
+					++failures;
+					diag(e);
+				}
+			}));
+		}
+		for(auto &thread : threads) {
+			thread->join();
+		}
+
+		uint64_t acquisitions = 0;
+		uint64_t contended = 0;
+		rusql::LockSiteProfile::Clock::duration wait = rusql::LockSiteProfile::Clock::duration::zero();
+		rusql::LockSiteProfile::Clock::duration hold = wait;
+		rusql::LockSiteProfile::Clock::duration p99_wait = wait;
+		rusql::LockSiteProfile::Clock::duration max_wait = wait;
+		rusql::LockSiteProfile::Clock::duration p99_hold = wait;
+		for(auto const &p : db->get_lock_profile()) {
+			acquisitions += p.acquisitions;
+			contended += p.contended;
+			wait += p.total_wait;
+			hold += p.total_hold;
+			p99_wait = std::max(p99_wait, p.p99_wait);
+			max_wait = std::max(max_wait, p.max_wait);
+			p99_hold = std::max(p99_hold, p.p99_hold);
+		}
+		auto const ms = [](rusql::LockSiteProfile::Clock::duration const d) {
+			return boost::chrono::duration<double, boost::milli>(d).count();
+		};
+		std::ostringstream line;
+		line.setf(std::ios::fixed);
+		line.precision(3);
+		line << num_threads << '\t' << acquisitions << '\t' << contended << '\t' << ms(wait) << '\t' << ms(p99_wait)
+			<< '\t' << ms(max_wait) << '\t' << ms(hold) << '\t' << ms(p99_hold);
+		diag(line.str());
+
+		test(failures == 0 && acquisitions == uint64_t(num_threads) * ITERATIONS * 2, std::to_string(num_threads) + " threads took the lock twice per iteration");
+	}
+
+	std::ostringstream table;
+	rusql::write_lock_profile(table, db->get_lock_profile());
+	std::istringstream lines(table.str());
+	for(std::string line; std::getline(lines, line);) {
+		diag(line);
+	}
+
+	db.reset();
+	return 0;
+}
@@ -0,0 +1,55 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include "test.hpp"
+
+int main(int, char *[]) {
+	test_init(8);
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	std::string const people = "SELECT id FROM people";
+	fake.script(people, FakeBackend::Result({"id"}).row({"1"}).row({"2"}));
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+
+	test_start_try(8);
+	try {
+		{
+			auto first = db->select_query(people);
+			auto second = db->select_query(people);
+			auto const metrics = db->get_pool_metrics();
+			test(metrics.connections == 2 && metrics.busy == 2 && metrics.idle == 0, "busy connections are counted");
+		}
+		auto metrics = db->get_pool_metrics();
+		test(metrics.idle == 2 && metrics.busy == 0 && metrics.connections_created == 2, "idle and created connections are counted");
+		test(metrics.checkouts == 2 && metrics.checkout_wait_buckets.back().second <= metrics.checkouts, "checkouts are counted");
+
+		{
+			auto lease = db->acquire();
+			for(int i = 0; i < 3; ++i) {
+				auto &statement = lease.execute_cached(people);
+				statement.free_result();
+			}
+		}
+		metrics = db->get_pool_metrics();
+		test(metrics.statement_cache_hits == 2 && metrics.statement_cache_misses == 1, "statement cache lookups are counted");
+		test(metrics.statement_cache_hit_rate() > 0.66 && metrics.statement_cache_hit_rate() < 0.67, "the hit rate follows");
+		test(metrics.circuit_state == rusql::CircuitBreaker::State::Closed && metrics.waiting_interactive == 0 && metrics.rejected == 0, "admission state is included");
+
+		std::string const text = rusql::to_prometheus(metrics);
+		test(text.find("# TYPE rusql_pool_connections gauge\nrusql_pool_connections 2\n") != std::string::npos
+			&& text.find("rusql_pool_connections_by_state{state=\"idle\"} 2\n") != std::string::npos
+			&& text.find("rusql_pool_statement_cache_lookups_total{result=\"hit\"} 2\n") != std::string::npos, "metrics render in the Prometheus text format");
+		test(text.find("rusql_pool_checkout_wait_seconds_bucket{le=\"+Inf\"} 3\n") != std::string::npos
+			&& text.find("rusql_pool_checkout_wait_seconds_count 3\n") != std::string::npos
+			&& text.find("rusql_pool_checkout_wait_seconds_bucket{le=\"0.000128\"}") != std::string::npos
+			&& text.find("rusql_pool_checkout_wait_seconds_bucket{le=\"16.777216\"}") != std::string::npos, "the checkout wait renders as a histogram");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.reset();
+	return 0;
+}
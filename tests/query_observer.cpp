@@ -0,0 +1,105 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include "test.hpp"
+
+namespace {
+	typedef rusql::mysql::QueryStage Stage;
+
+	struct Recorded {
+		Stage stage;
+		std::string sql;
+		unsigned long connection_id;
+		bool row;
+		bool failed;
+	};
+
+	struct Recorder : rusql::mysql::QueryObserver {
+		std::vector<Recorded> events;
+		bool in_order = true;
+		rusql::mysql::QueryEvent::Clock::time_point last;
+
+		void on_event(rusql::mysql::QueryEvent const& event) override {
+			in_order = in_order && event.start >= last && event.duration.count() >= 0;
+			last = event.start;
+			events.push_back(Recorded{event.stage, event.sql, event.connection_id, event.row, event.failed});
+		}
+
+		std::vector<Stage> stages() const {
+			std::vector<Stage> result;
+			for(auto const &event : events) {
+				result.push_back(event.stage);
+			}
+			return result;
+		}
+	};
+}
+
+int main(int, char *[]) {
+	test_init(10);
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	std::string const people = "SELECT id FROM people";
+	fake.script(people, FakeBackend::Result({"id"}).row({"1"}).row({"2"}));
+	fake.script("DO 1", FakeBackend::Result());
+	fake.script_error("SELECT broken", "You have an error in your SQL syntax");
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+	auto recorder = std::make_shared<Recorder>();
+
+	test_start_try(10);
+	try {
+		db->query("DO 1");
+		test(recorder->events.empty(), "nothing is reported without an observer");
+		db->set_query_observer(recorder);
+
+		{
+			int id = 0;
+			auto statement = db->execute(people);
+			statement.bind_results(id);
+			while(statement.fetch()) {}
+		}
+		test(recorder->stages() == std::vector<Stage>({Stage::Acquire, Stage::Prepare, Stage::Execute, Stage::Fetch, Stage::Fetch, Stage::Fetch}), "a prepared statement reports every stage");
+		auto const id = recorder->events.front().connection_id;
+		bool same = id != 0;
+		for(auto const &event : recorder->events) {
+			same = same && event.connection_id == id && (event.stage == Stage::Acquire ? event.sql.empty() : event.sql == people);
+		}
+		test(same, "events carry the statement's text and the connection's id");
+		auto const &last = recorder->events.back();
+		test(recorder->events[3].row && !last.row, "fetches tell rows from the end of the result");
+
+		recorder->events.clear();
+		{
+			auto rs = db->select_query(people);
+			rs.next();
+		}
+		test(recorder->stages() == std::vector<Stage>({Stage::Acquire, Stage::Query, Stage::FetchRow, Stage::FetchRow, Stage::Close}), "a plain query reports every stage");
+		test(recorder->events.back().sql == people, "the result's events carry the query's text");
+
+		recorder->events.clear();
+		try {
+			db->query("SELECT broken");
+		} catch(rusql::mysql::SQLError &) {
+		}
+		test(recorder->events.size() == 2 && recorder->events.back().failed && !recorder->events.front().failed, "a failing stage is reported as failed");
+		test(recorder->in_order, "events come in order, with their duration");
+
+		recorder->events.clear();
+		db->set_query_observer(nullptr);
+		db->query("DO 1");
+		test(recorder->events.empty(), "nothing is reported after removing the observer");
+
+		std::weak_ptr<Recorder> const replaced = recorder;
+		recorder.reset();
+		db->query("DO 1");
+		test(replaced.expired(), "a replaced observer is let go once the connections have seen it was replaced");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.reset();
+	return 0;
+}
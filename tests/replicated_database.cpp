@@ -0,0 +1,83 @@
+#include <rusql/rusql.hpp>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto info = get_construction_info(argc, argv);
+	test_init(18);
+
+	test(rusql::is_read_only("SELECT * FROM t"), "SELECT is a read");
+	test(rusql::is_read_only("  (select 1) UNION (select 2)"), "parenthesized lowercase select is a read");
+	test(rusql::is_read_only("SHOW TABLES"), "SHOW is a read");
+	test(!rusql::is_read_only("SELECT * FROM t FOR UPDATE"), "locking SELECT is a write");
+	test(!rusql::is_read_only("SELECT * FROM t FOR SHARE"), "SELECT ... FOR SHARE is a write");
+	test(!rusql::is_read_only("select * from t for  update\n\tskip locked"), "locking clauses are found whatever their case and spacing");
+	test(!rusql::is_read_only("SELECT * FROM t FOR SHARE OF t NOWAIT"), "FOR SHARE ... NOWAIT is a write");
+	test(!rusql::is_read_only("INSERT INTO t SELECT * FROM u"), "INSERT ... SELECT is a write");
+	test(!rusql::is_read_only("SELECTED"), "only whole keywords count");
+
+	// the test server plays the primary as well as both replicas
+	rusql::ReplicatedDatabase db(info, {info, info}, boost::chrono::seconds(60));
+	db.query("CREATE TABLE rusqltest (`id` INT(10) NOT NULL)");
+	db.execute("INSERT INTO rusqltest VALUES (?), (?)", 1, 2);
+
+	auto busy = [&db](std::shared_ptr<rusql::Database> d) { return d->number_of_active_connections(); };
+
+	test_start_try(9);
+	try {
+		auto primary = db.get_primary();
+		{
+			auto rs = db.select_query("SELECT id FROM rusqltest");
+			test(busy(primary) == 0 && busy(db.get_replica(0)) + busy(db.get_replica(1)) == 1, "select_query goes to a replica");
+			auto rs2 = db.select_query("SELECT id FROM rusqltest");
+			test(busy(db.get_replica(0)) + busy(db.get_replica(1)) == 2, "second select_query goes to a replica too");
+		}
+		{
+			auto held = db.select_query("SELECT id FROM rusqltest");
+			size_t const held_by = busy(db.get_replica(0)) == 1 ? 0 : 1;
+			bool elsewhere = true;
+			for(int i = 0; i < 4; ++i) {
+				auto rs = db.select_query("SELECT id FROM rusqltest");
+				elsewhere = elsewhere && busy(db.get_replica(held_by)) == 1 && busy(db.get_replica(1 - held_by)) == 1;
+			}
+			test(elsewhere, "reads go to the other replica while a result is open");
+		}
+		{
+			auto statement = db.prepare("SELECT id FROM rusqltest WHERE id = ?");
+			test(busy(primary) == 0, "read-only statement goes to a replica");
+		}
+		{
+			auto statement = db.prepare("UPDATE rusqltest SET id = id");
+			test(busy(primary) == 1, "write goes to the primary");
+		}
+		{
+			auto rs = db.select_query("SELECT id FROM rusqltest FOR UPDATE");
+			test(busy(primary) == 1, "locking select_query goes to the primary");
+		}
+		{
+			auto locking = db.session();
+			{
+				auto rs = locking.select_query("SELECT id FROM rusqltest LOCK IN SHARE MODE");
+			}
+			auto rs = locking.select_query("SELECT id FROM rusqltest");
+			test(busy(primary) == 1, "a session's locking select_query counts as a write");
+		}
+
+		auto session = db.session();
+		{
+			auto rs = session.select_query("SELECT id FROM rusqltest");
+			test(busy(primary) == 0, "session reads from a replica before writing");
+		}
+		session.execute("UPDATE rusqltest SET id = id + 10 WHERE id = ?", 1);
+		{
+			auto rs = session.select_query("SELECT id FROM rusqltest");
+			test(busy(primary) == 1, "session reads from the primary after writing");
+		}
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.query("DROP TABLE rusqltest");
+	return 0;
+}
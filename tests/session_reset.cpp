@@ -0,0 +1,76 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include "test.hpp"
+
+namespace {
+	typedef rusql::mysql::FakeBackend FakeBackend;
+
+	//! A statement that the fake server reports as having set name to value.
+	FakeBackend::Result sets(std::string const& name, std::string const& value) {
+		FakeBackend::Result result;
+		result.session_changes.variables.emplace_back(name, value);
+		return result;
+	}
+}
+
+int main(int, char *[]) {
+	test_init(7);
+
+	FakeBackend fake;
+	std::string const init = "SET SESSION wait_timeout = 28800";
+	std::string const shorter = "SET SESSION wait_timeout = 60";
+	std::string const partly = "SET SESSION wait_timeout = 60, sql_mode = ''";
+	std::string const prepared = "SET SESSION sql_mode = ''";
+	std::string const lock_wait = "SET SESSION lock_wait_timeout = 5";
+	fake.script(init, sets("wait_timeout", "28800"));
+	fake.script(shorter, sets("wait_timeout", "60"));
+	fake.script(partly, sets("wait_timeout", "60"));
+	fake.script(prepared, FakeBackend::Result());
+	fake.script(lock_wait, sets("lock_wait_timeout", "5"));
+	fake.script_error("SET SESSION lock_wait_timeout = DEFAULT", "the server went away");
+
+	rusql::mysql::BackendScope scope(fake);
+	rusql::Database::ConstructionInfo info("fake");
+	info.init_commands.push_back(init);
+	auto db = std::make_shared<rusql::Database>(info);
+
+	test_start_try(7);
+	try {
+		// connects, and leaves the session as it was
+		db->query(init);
+		auto statements = fake.number_of_statements();
+		db->query(shorter);
+		test(fake.number_of_statements() == statements + 2, "a variable is set back to its old value as the connection goes back to the pool");
+
+		auto resets = fake.number_of_resets();
+		db->query(partly);
+		test(fake.number_of_resets() == resets + 1, "a SET of which not every variable was tracked resets the whole session");
+
+		resets = fake.number_of_resets();
+		{
+			auto statement = db->prepare(prepared);
+			statement.execute();
+			test(fake.number_of_resets() == resets, "a prepared SET leaves the session alone while the statement is around");
+		}
+		test(fake.number_of_resets() == resets + 1, "and resets it when the statement goes away");
+
+		{
+			auto lease = db->acquire();
+			statements = fake.number_of_statements();
+			lease.query(shorter);
+			test(fake.number_of_statements() == statements + 1, "the session of a lease is left alone until it is released");
+		}
+
+		db->query(lock_wait);
+		auto const metrics = db->get_pool_metrics();
+		test(metrics.reconnects == 1 && metrics.connections == 1, "a session that can't be restored is reconnected");
+		auto lease = db->acquire();
+		test(lease.get_session_state().variables.count("lock_wait_timeout") == 0, "and starts clean");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.reset();
+	return 0;
+}
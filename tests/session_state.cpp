@@ -0,0 +1,60 @@
+#include <rusql/rusql.hpp>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	test_init(12);
+
+	test_start_try(4);
+	try {
+		typedef rusql::SessionStatement S;
+		test(S::classify("  set time_zone = '+00:00'").kind == S::Set, "SET of a system variable changes the session");
+		test(S::classify("SET @rusql = 1").kind == S::None, "user variables are not followed");
+		test(S::classify("SET TRANSACTION ISOLATION LEVEL READ COMMITTED").kind == S::None, "SET TRANSACTION is not session state");
+		auto const use = S::classify("USE `rusql``db`");
+		test(use.kind == S::Use && use.schema == "rusql`db", "USE is parsed");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	// one connection, so every lease gets the same one
+	rusql::AdmissionPolicy policy;
+	policy.max_connections = 1;
+	db->set_admission_policy(policy);
+
+	test_start_try(8);
+	try {
+		std::string const global_zone = db->select_query("SELECT @@global.time_zone").get_string(0);
+		{
+			auto lease = db->acquire();
+			lease.set_session_variable("time_zone", std::string("+03:00"));
+			test(lease.select_query("SELECT @@session.time_zone").get_string(0) == "+03:00", "session variable is set");
+			test(lease.get_session_state().variables.at("time_zone") == "+03:00", "session variable is remembered");
+			test(lease.is_session_dirty(), "a changed session is dirty");
+
+			lease.set_session_variable("TIME_ZONE", std::string("+03:00"));
+			test(lease.select_query("SELECT @@session.time_zone").get_string(0) == "+03:00", "setting the same value again is harmless");
+
+			lease.query("SET @rusql_session = 1");
+			lease.use_database(lease.get_session_state().schema);
+			lease.set_names(lease.get_session_state().charset);
+			test(!lease.get_session_state().unknown, "user variables and unchanged settings don't make the session unknown");
+		}
+
+		auto lease = db->acquire();
+		test(!lease.is_session_dirty(), "released connection was reset");
+		test(lease.select_query("SELECT @@session.time_zone").get_string(0) == global_zone, "session variable was set back");
+
+		lease.query("SET SESSION sql_mode = ''");
+		lease.release();
+		lease = db->acquire();
+		test(!lease.is_session_dirty(), "session changed by plain SET is reset too");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	return 0;
+}
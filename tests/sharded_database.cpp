@@ -0,0 +1,82 @@
+#include <rusql/rusql.hpp>
+#include <future>
+#include <set>
+#include <vector>
+#include "test.hpp"
+#include "database_test.hpp"
+
+static std::future<rusql::MaterializedResult> ready(std::vector<int> const& ids) {
+	rusql::MaterializedResult result;
+	result.columns = std::make_shared<std::vector<std::string> const>(std::vector<std::string>{"id"});
+	for(int id : ids) {
+		result.rows.emplace_back(result.columns, std::vector<boost::optional<std::string>>{std::to_string(id)});
+	}
+	std::promise<rusql::MaterializedResult> p;
+	p.set_value(result);
+	return p.get_future();
+}
+
+static std::vector<int> drain(rusql::MergedRows rows) {
+	std::vector<int> ids;
+	for(auto &row : rows) {
+		ids.push_back(row.get<int>("id"));
+	}
+	return ids;
+}
+
+int main(int argc, char *argv[]) {
+	auto info = get_construction_info(argc, argv);
+	test_init(7);
+
+	{
+		std::vector<std::future<rusql::MaterializedResult>> shards;
+		shards.emplace_back(ready({1, 4, 9}));
+		shards.emplace_back(ready({}));
+		shards.emplace_back(ready({2, 3, 10}));
+		test(drain(rusql::MergedRows(std::move(shards), rusql::order_by<int>("id"))) == std::vector<int>({1, 2, 3, 4, 9, 10}), "sorted merge interleaves the shards");
+	}
+	{
+		std::vector<std::future<rusql::MaterializedResult>> shards;
+		shards.emplace_back(ready({5, 1}));
+		shards.emplace_back(ready({7}));
+		test(drain(rusql::MergedRows(std::move(shards))) == std::vector<int>({5, 1, 7}), "unsorted merge keeps shard order");
+	}
+
+	// the test server plays all three shards
+	rusql::ShardedDatabase db({info, info, info}, 64);
+	{
+		std::set<size_t> used;
+		bool stable = true;
+		for(int customer = 0; customer < 300; ++customer) {
+			used.insert(db.shard_for(customer));
+			stable = stable && db.shard_for(customer) == db.shard_for(customer);
+		}
+		test(stable, "a key always maps to the same shard");
+		test(used.size() == 3, "keys are spread over all shards");
+	}
+	{
+		rusql::ShardedDatabase grown({info, info, info, info}, 64);
+		int moved_elsewhere = 0;
+		for(int customer = 0; customer < 300; ++customer) {
+			size_t const now = grown.shard_for(customer);
+			moved_elsewhere += now != 3 && now != db.shard_for(customer);
+		}
+		test(moved_elsewhere == 0, "adding a shard only moves keys to the new shard");
+	}
+
+	db.query(0, "CREATE TABLE rusqltest (`id` INT(10) NOT NULL)");
+	db.execute(0, "INSERT INTO rusqltest VALUES (?), (?), (?)", 3, 1, 2);
+
+	test_start_try(2);
+	try {
+		// every shard sees the same table, so every row comes back once per shard
+		test(drain(db.scatter_sorted(rusql::order_by<int>("id"), "SELECT id FROM rusqltest ORDER BY id")) == std::vector<int>({1, 1, 1, 2, 2, 2, 3, 3, 3}), "scatter_sorted merges the shards in order");
+		test(drain(db.scatter("SELECT id FROM rusqltest WHERE id > ?", 2)) == std::vector<int>({3, 3, 3}), "scatter runs on every shard");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.query(0, "DROP TABLE rusqltest");
+	return 0;
+}
@@ -0,0 +1,78 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include "test.hpp"
+
+#include <sstream>
+
+int main(int, char *[]) {
+	test_init(12);
+
+	test(rusql::fingerprint("SELECT  name FROM people\n WHERE id = 12 AND name = 'it''s' -- why\n") == "select name from people where id = ? and name = ?", "fingerprint strips literals, comments and whitespace");
+	test(rusql::fingerprint("select * from t where x in (1, 2, 3)") == rusql::fingerprint("SELECT * FROM t WHERE x IN (?)"), "fingerprint collapses lists");
+	test(rusql::fingerprint("INSERT INTO t VALUES (1, 'a'), (2, 'b\\'c')") == "insert into t values (?+)", "fingerprint collapses rows");
+	test(rusql::fingerprint("SELECT `Weird 1` FROM t2 /* hint */ WHERE a = -1.5e+3 OR b = 0x1F") == "select `Weird 1` from t2 where a = -? or b = ?", "fingerprint keeps identifiers and handles numbers");
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	fake.script("SELECT name FROM people WHERE id = 1", FakeBackend::Result({"name"}).row({"alice"}));
+	fake.script("SELECT name FROM people WHERE id = 2", FakeBackend::Result({"name"}).row({"bob"}));
+	fake.script("SELECT name FROM people WHERE id > ?", FakeBackend::Result({"name"}).row({"alice"}).row({"bob"}));
+	fake.script_error("SELECT broken", "You have an error in your SQL syntax");
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+	auto statistics = std::make_shared<rusql::StatementStatistics>();
+	db->set_query_observer(statistics);
+
+	test_start_try(8);
+	try {
+		std::vector<rusql::SlowStatement> slow;
+		statistics->set_slow_threshold(rusql::StatementStatistics::Clock::duration::zero(), [&slow](rusql::SlowStatement const& statement) {
+			slow.push_back(statement);
+		});
+
+		for(auto rs = db->select_query("SELECT name FROM people WHERE id = 1"); rs; rs.next()) {}
+		for(auto rs = db->select_query("SELECT name FROM people WHERE id = 2"); rs; rs.next()) {}
+		{
+			std::string name;
+			auto statement = db->execute("SELECT name FROM people WHERE id > ?", 0);
+			statement.bind_results(name);
+			while(statement.fetch()) {}
+		}
+		try {
+			db->query("SELECT broken");
+		} catch(rusql::mysql::SQLError &) {
+		}
+
+		auto const report = statistics->report();
+		auto const find = [&report](std::string const& shape) {
+			auto const it = std::find_if(report.begin(), report.end(), [&shape](rusql::StatementSummary const& s) { return s.fingerprint == shape; });
+			return it == report.end() ? rusql::StatementSummary() : *it;
+		};
+		auto const by_id = find("select name from people where id = ?");
+		test(by_id.executions == 2 && by_id.rows == 2 && by_id.bytes == 8, "statements with different literals are counted together");
+		test(by_id.min_latency <= by_id.max_latency && by_id.max_latency <= by_id.total_latency && by_id.p99_latency >= by_id.p50_latency, "latencies are kept");
+
+		auto const prepared = find("select name from people where id > ?");
+		test(prepared.executions == 1 && prepared.prepares == 1 && prepared.rows == 2 && prepared.bytes == 8, "prepared statements are counted");
+		test(find("select broken").errors == 1, "errors are counted");
+		test(slow.size() == 4 && slow.front().fingerprint == "select name from people where id = ?" && slow.back().failed, "slow statements are reported");
+
+		std::ostringstream table;
+		statistics->write_report(table);
+		test(table.str().find("select name from people where id = ?") != std::string::npos, "the report is written as a table");
+
+		slow.clear();
+		statistics->set_slow_threshold(rusql::StatementStatistics::Clock::duration::zero(), nullptr);
+		statistics->clear();
+		for(auto rs = db->select_query("SELECT name FROM people WHERE id = 1"); rs; rs.next()) {}
+		test(slow.empty(), "slow statements are no longer reported without a listener");
+		test(statistics->report().size() == 1, "clear() forgets earlier statements");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.reset();
+	return 0;
+}
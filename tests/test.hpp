@@ -15,6 +15,10 @@ inline void fail(std::string text) {
 	std::cout << "not ok " << testnum++ << " " << text << std::endl;
 }
 
+inline void skip(std::string text) {
+	std::cout << "ok " << testnum++ << " # SKIP " << text << std::endl;
+}
+
 inline void test(bool c, std::string text) {
 	c ? pass(text) : fail(text);
 }
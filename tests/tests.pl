@@ -5,7 +5,7 @@ use TAP::Harness;
 
 my @test_args = @ARGV;
 
-my @tests = qw(test_compile test_connect test_query test_placeholders test_optional test_multiconnection test_signedness test_insert_id test_iterate test_threads test_named_bind);
+my @tests = qw(test_compile test_connect test_query test_placeholders test_optional test_multiconnection test_signedness test_insert_id test_iterate test_threads test_named_bind test_async_execute test_insert_coalescer test_batch_loader test_bulk_load test_transaction test_lease test_replicated_database test_sharded_database test_hedged_reads test_deadline test_admission test_adaptive_pool test_warm_up test_session_state test_fake_backend test_query_observer test_trace test_statement_statistics test_pool_metrics test_lock_contention test_allocation_accounting test_workload test_hedge_loser test_session_reset test_lease_threads test_async_lifetime);
 
 my $compiled_tests_dir;
 for(qw(. tests ../tests ../build/tests)) {
@@ -0,0 +1,86 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include <rusql/mysql/trace.hpp>
+#include "test.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+namespace {
+	typedef rusql::mysql::TracedCall TracedCall;
+
+	size_t count(std::vector<rusql::mysql::TraceEvent> const& events, TracedCall const call) {
+		return size_t(std::count_if(events.begin(), events.end(), [call](rusql::mysql::TraceEvent const& event) {
+			return event.call == call;
+		}));
+	}
+}
+
+int main(int, char *[]) {
+	test_init(8);
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	std::string const people = "SELECT id FROM people";
+	fake.script(people, FakeBackend::Result({"id"}).row({"1"}).row({"2"}));
+	fake.script_error("SELECT broken", "You have an error in your SQL syntax");
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+
+	test_start_try(8);
+	try {
+		db->ping();
+		rusql::mysql::clear_trace();
+		for(auto rs = db->select_query(people); rs; rs.next()) {}
+		auto events = rusql::mysql::dump_trace();
+		test(count(events, TracedCall::query) == 1 && count(events, TracedCall::fetch_row) >= 3, "calls are traced");
+		bool ordered = true;
+		for(size_t i = 1; i < events.size(); ++i) {
+			ordered = ordered && events[i - 1].start_us <= events[i].start_us && events[i].duration_us >= 0;
+		}
+		test(ordered, "events are ordered by start, with their duration");
+
+		rusql::mysql::clear_trace();
+		try {
+			db->query("SELECT broken");
+		} catch(rusql::mysql::SQLError &) {
+		}
+		events = rusql::mysql::dump_trace();
+		auto const failed = std::find_if(events.begin(), events.end(), [](rusql::mysql::TraceEvent const& event) {
+			return event.call == TracedCall::query;
+		});
+		test(failed != events.end() && failed->error_number == 1064, "a failed call has its error number");
+
+		std::ostringstream json;
+		rusql::mysql::write_chrome_trace(json, events);
+		test(json.str().find("{\"traceEvents\":[") == 0 && json.str().find("\"name\":\"query\",\"cat\":\"mysql\",\"ph\":\"X\"") != std::string::npos && json.str().find("\"errno\":1064") != std::string::npos, "the trace converts to the Trace Event Format");
+
+		rusql::mysql::clear_trace();
+		uint32_t const main_thread = failed->thread;
+		boost::thread pinger([&db]() {
+			auto handle = db->get_thread_handle();
+			for(size_t i = 0; i < rusql::mysql::trace_capacity + 100; ++i) {
+				db->ping();
+			}
+		});
+		pinger.join();
+		events = rusql::mysql::dump_trace();
+		test(!events.empty() && events.front().thread != main_thread, "each thread has its own ring, kept after it ended");
+		test(events.size() == rusql::mysql::trace_capacity, "a ring keeps the last calls of its thread");
+
+		rusql::mysql::set_tracing(false);
+		rusql::mysql::clear_trace();
+		db->ping();
+		test(rusql::mysql::dump_trace().empty(), "nothing is traced while tracing is off");
+		rusql::mysql::set_tracing(true);
+		db->ping();
+		test(count(rusql::mysql::dump_trace(), TracedCall::ping) == 1, "tracing can be switched back on");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db.reset();
+	return 0;
+}
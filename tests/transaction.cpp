@@ -0,0 +1,93 @@
+#include <rusql/rusql.hpp>
+#include "test.hpp"
+#include "database_test.hpp"
+
+static uint64_t count_rows(std::shared_ptr<rusql::Database> db) {
+	return db->select_query("SELECT COUNT(*) FROM rusqltest").get_uint64(0);
+}
+
+int main(int argc, char *argv[]) {
+	auto db = get_database(argc, argv);
+	const int NUM_INSERTS = 500;
+	test_init(9);
+
+	db->execute("CREATE TABLE rusqltest (`id` INT(10) NOT NULL, `value` INT(10) NOT NULL) ENGINE=InnoDB");
+	std::string engine = db->select_query("SELECT ENGINE FROM information_schema.TABLES WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'rusqltest'").get_string(0);
+	bool const transactional = engine == "InnoDB";
+
+	test_start_try(4);
+	try {
+		auto transaction = db->begin();
+		uint64_t const id = transaction.select_query("SELECT CONNECTION_ID()").get_uint64(0);
+		transaction.execute("INSERT INTO rusqltest VALUES (?, ?)", 1, 10);
+		test(db->number_of_active_connections() >= 1, "transaction keeps its connection busy");
+		test(transaction.select_query("SELECT CONNECTION_ID()").get_uint64(0) == id, "statements run on one connection");
+		transaction.commit();
+		test(!transaction.is_active(), "transaction is over after commit");
+		test(count_rows(db) == 1, "committed row is there");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	try {
+		auto transaction = db->begin();
+		transaction.commit();
+		transaction.query("SELECT 1");
+		fail("using a finished transaction throws");
+	} catch(rusql::TransactionError &e) {
+		pass("using a finished transaction throws");
+	}
+
+	if(transactional) {
+		test_start_try(3);
+		try {
+			{
+				auto transaction = db->begin();
+				transaction.execute("INSERT INTO rusqltest VALUES (?, ?)", 2, 20);
+			}
+			test(count_rows(db) == 1, "destruction rolls back");
+
+			auto transaction = db->begin();
+			transaction.execute("INSERT INTO rusqltest VALUES (?, ?)", 3, 30);
+			transaction.savepoint("before four");
+			transaction.execute("INSERT INTO rusqltest VALUES (?, ?)", 4, 40);
+			transaction.rollback_to("before four");
+			transaction.commit();
+			test(count_rows(db) == 2, "rollback to savepoint keeps earlier writes");
+			test(db->select_query("SELECT COUNT(*) FROM rusqltest WHERE id = 4").get_uint64(0) == 0, "rollback to savepoint drops later writes");
+		} catch(std::exception &e) {
+			diag(e);
+		}
+		test_finish_try();
+	} else {
+		skip("destruction rolls back (" + engine + " is not transactional)");
+		skip("rollback to savepoint keeps earlier writes (" + engine + " is not transactional)");
+		skip("rollback to savepoint drops later writes (" + engine + " is not transactional)");
+	}
+
+	// Every autocommitted INSERT is a commit of its own, in a transaction they share one; bench/ has their timing
+	// (insert_single and insert_transaction_prepared).
+	db->execute("DELETE FROM rusqltest");
+	test_start_try(1);
+	try {
+		for(int i = 0; i < NUM_INSERTS; ++i) {
+			db->execute("INSERT INTO rusqltest VALUES (?, ?)", i, i);
+		}
+		{
+			auto transaction = db->begin();
+			auto statement = transaction.prepare("INSERT INTO rusqltest VALUES (?, ?)");
+			for(int i = 0; i < NUM_INSERTS; ++i) {
+				statement.execute(i, i);
+			}
+			transaction.commit();
+		}
+		test(count_rows(db) == 2 * NUM_INSERTS, "all inserts were committed");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	db->execute("DROP TABLE rusqltest");
+	return 0;
+}
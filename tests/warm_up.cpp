@@ -0,0 +1,72 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include <boost/thread.hpp>
+#include "test.hpp"
+#include "database_test.hpp"
+
+int main(int argc, char *argv[]) {
+	auto info = get_construction_info(argc, argv);
+	test_init(7);
+
+	info.init_commands.push_back("SET @rusql_warm = 42");
+	auto db = std::make_shared<rusql::Database>(info);
+	db->set_hot_statements({"SELECT ? AS x"});
+
+	test_start_try(5);
+	try {
+		test(db->warm_up(4) == 4, "warm_up opens the connections");
+		test(db->number_of_active_connections() == 0, "warm connections are free");
+
+		auto rs = db->select_query("SELECT @rusql_warm AS warm");
+		test(rs.get<int>("warm") == 42, "init commands ran on the connection");
+		rs.release();
+
+		auto lease = db->acquire();
+		auto &statement = lease.execute_cached("SELECT ? AS x", 7);
+		statement.bind_all_self();
+		test(statement.fetch() && statement.get<int>("x") == 7, "hot statements can be run through a lease");
+
+		rusql::AdmissionPolicy policy;
+		policy.max_connections = 6;
+		db->set_admission_policy(policy);
+		test(db->warm_up(10) == 6, "warm_up stays within the pool limit");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	// Other requests fill the pool while warm_up()'s connections are still connecting
+	test_start_try(2);
+	try {
+		typedef rusql::mysql::FakeBackend FakeBackend;
+		FakeBackend fake;
+		std::string const init = "SET @rusql_warm = 42";
+		fake.script(init, FakeBackend::Result());
+		rusql::mysql::BackendScope scope(fake);
+
+		rusql::Database::ConstructionInfo fake_info("fake");
+		fake_info.init_commands.push_back(init);
+		auto fake_db = std::make_shared<rusql::Database>(fake_info);
+		rusql::AdmissionPolicy policy;
+		policy.max_connections = 2;
+		fake_db->set_admission_policy(policy);
+
+		fake.stall(init, 2, boost::chrono::milliseconds(300));
+		size_t warmed = 0;
+		boost::thread warming([&fake_db, &warmed]() {
+			auto thread_handle = fake_db->get_thread_handle();
+			warmed = fake_db->warm_up(2);
+		});
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+		auto first = fake_db->acquire();
+		auto second = fake_db->acquire();
+		warming.join();
+		test(warmed == 2, "warm_up counts only the connections the pool had room for");
+		test(fake_db->number_of_connections() == 2, "the pool doesn't grow past its limit during warm_up");
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include <rusql/rusql.hpp>
+#include <rusql/mysql/fake_backend.hpp>
+#include <boost/thread.hpp>
+#include "test.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+struct CountingObserver : rusql::mysql::QueryObserver {
+	CountingObserver()
+	: events(0)
+	{}
+
+	void on_event(rusql::mysql::QueryEvent const&) override {
+		++events;
+	}
+
+	std::atomic<uint64_t> events;
+};
+
+int main(int, char *[]) {
+	test_init(12);
+
+	typedef rusql::mysql::FakeBackend FakeBackend;
+	FakeBackend fake;
+	std::string const insert = "INSERT INTO people VALUES (?, ?, ?, ?)";
+	std::string const select = "SELECT name FROM people WHERE name = 'alice'";
+	std::string const other = "SELECT name FROM people WHERE name = 'bob'";
+	FakeBackend::Result inserted;
+	inserted.affected_rows = 1;
+	fake.script(insert, inserted);
+	fake.script(select, FakeBackend::Result({"name"}).row({"alice"}));
+	fake.script(other, FakeBackend::Result({"name"}).row({"bob"}));
+	std::string const by_id = "SELECT name FROM people WHERE id = ?";
+	fake.script(by_id, FakeBackend::Result({"name"}).row({"alice"}));
+	std::string const dated = "INSERT INTO visits VALUES (?, ?)";
+	fake.script(dated, inserted);
+
+	rusql::mysql::BackendScope scope(fake);
+	auto db = std::make_shared<rusql::Database>(rusql::Database::ConstructionInfo("fake"));
+	std::string const path = "/tmp/rusql-test-workload-" + std::to_string(getpid());
+
+	test_start_try(12);
+	try {
+		auto observer = std::make_shared<CountingObserver>();
+		db->set_query_observer(observer);
+
+		auto recorder = db->start_recording(path);
+		db->execute(insert, int64_t(-5), uint64_t(7), std::string("secret"), boost::optional<std::string>());
+		for(auto rs = db->select_query(select); rs; rs.next()) {}
+		boost::thread thread([&db, &other]() {
+			auto thread_handle = db->get_thread_handle();
+			for(auto rs = db->select_query(other); rs; rs.next()) {}
+		});
+		thread.join();
+		test(recorder->number_of_statements() == 3 && observer->events > 3, "statements are recorded next to the query observer");
+		db->stop_recording();
+		for(auto rs = db->select_query(select); rs; rs.next()) {}
+
+		auto const statements = rusql::read_workload(path);
+		test(statements.size() == 3, "statements after stop_recording() are not recorded");
+
+		auto const &executed = statements.at(0);
+		test(executed.stage == rusql::mysql::QueryStage::Execute && *executed.sql == insert && *executed.fingerprint == "insert into people values (?+)", "prepared statements are recorded with their text and fingerprint");
+		test(executed.parameters.size() == 4
+			&& executed.parameters[0].type == rusql::RecordedValue::Type::Signed && executed.parameters[0].signed_value == -5
+			&& executed.parameters[1].type == rusql::RecordedValue::Type::Unsigned && executed.parameters[1].unsigned_value == 7
+			&& executed.parameters[2].type == rusql::RecordedValue::Type::String && executed.parameters[2].string_value == "secret"
+			&& executed.parameters[3].type == rusql::RecordedValue::Type::Null, "parameters are recorded");
+
+		auto const &queried = statements.at(1);
+		test(queried.stage == rusql::mysql::QueryStage::Query && *queried.sql == select && queried.start_us >= executed.start_us && queried.connection_id != 0, "plain statements are recorded");
+		test(executed.thread == 1 && queried.thread == 1 && statements.at(2).thread == 2, "threads are numbered in order of their first statement");
+
+		rusql::WorkloadRecorder::Options options;
+		options.redact = true;
+		options.max_texts = 1;
+		db->start_recording(path, options);
+		db->execute(insert, int64_t(1), uint64_t(2), std::string("secret"), boost::optional<std::string>("x"));
+		for(auto rs = db->select_query(select); rs; rs.next()) {}
+		for(auto rs = db->select_query(other); rs; rs.next()) {}
+		db->stop_recording();
+
+		auto const redacted = rusql::read_workload(path);
+		test(redacted.size() == 3 && redacted[0].parameters[2].string_value == "xxxxxx" && redacted[0].parameters[0].signed_value == 1, "redaction replaces strings and keeps numbers");
+		test(*redacted[1].sql == "SELECT name FROM people WHERE name = 'xxxxx'" && *redacted[2].sql == "SELECT name FROM people WHERE name = 'xxx'", "redaction replaces quoted strings in statements");
+		test(*redacted[1].fingerprint == *redacted[2].fingerprint && redacted[1].sql != redacted[2].sql, "texts are defined anew after max_texts");
+
+		MYSQL_TIME when;
+		std::memset(&when, 0, sizeof(when));
+		when.year = 2024;
+		when.month = 2;
+		when.day = 29;
+		when.hour = 13;
+		when.minute = 5;
+		when.second_part = 250000;
+		MYSQL_TIME took;
+		std::memset(&took, 0, sizeof(took));
+		took.hour = 30;
+		took.second = 9;
+		took.neg = true;
+		std::vector<MYSQL_BIND> binds(2);
+		std::memset(binds.data(), 0, binds.size() * sizeof(MYSQL_BIND));
+		binds[0].buffer_type = MYSQL_TYPE_DATETIME;
+		binds[0].buffer = &when;
+		binds[1].buffer_type = MYSQL_TYPE_TIME;
+		binds[1].buffer = &took;
+		db->start_recording(path);
+		db->prepare(dated).bind_parameter_binds(binds).execute();
+		db->stop_recording();
+		auto const times = rusql::read_workload(path);
+		test(times.size() == 1 && times[0].parameters.size() == 2
+			&& times[0].parameters[0].string_value == "2024-02-29 13:05:00.250000"
+			&& times[0].parameters[1].string_value == "-30:00:09", "dates and times are recorded as their text");
+
+		db->start_recording(path);
+		{
+			auto statement = db->prepare(by_id);
+			statement.bind_parameters(int64_t(42)).execute();
+			statement.bind_all_self();
+			while(statement.fetch()) {}
+			statement.free_result();
+			statement.execute();
+		}
+		db->stop_recording();
+		auto const again = rusql::read_workload(path);
+		test(again.size() == 2 && again[1].parameters.size() == 1 && again[1].parameters[0].signed_value == 42, "bind_all_self() keeps the parameters for the next execution");
+
+		std::string bytes;
+		{
+			std::ifstream in(path.c_str(), std::ios::binary);
+			std::ostringstream all;
+			all << in.rdbuf();
+			bytes = all.str();
+		}
+		std::istringstream truncated(bytes.substr(0, bytes.size() - 3));
+		try {
+			rusql::read_workload(truncated);
+			fail("a truncated recording is refused");
+		} catch(std::runtime_error &) {
+			pass("a truncated recording is refused");
+		}
+	} catch(std::exception &e) {
+		diag(e);
+	}
+	test_finish_try();
+
+	std::remove(path.c_str());
+	db.reset();
+	return 0;
+}
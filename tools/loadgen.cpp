@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <rusql/rusql.hpp>
+#include "tests/database_test.hpp"
+
+//! rusql_loadgen: a sysbench-style OLTP load on a table of its own, from N threads sharing a Database. Every
+//! event runs a number of point selects, range scans, updates and inserts, all as prepared statements; the
+//! throughput and latencies are reported at intervals and at the end.
+namespace {
+	typedef boost::chrono::steady_clock Clock;
+
+	enum Kind { PointSelect, RangeScan, Update, Insert, number_of_kinds };
+	char const* const kind_names[number_of_kinds] = {"point_select", "range_scan", "update", "insert"};
+
+	std::string const table = "rusql_loadgen";
+	std::string const queries[number_of_kinds] = {
+		"SELECT c FROM " + table + " WHERE id = ?",
+		"SELECT c FROM " + table + " WHERE id BETWEEN ? AND ?",
+		"UPDATE " + table + " SET k = k + 1 WHERE id = ?",
+		"INSERT INTO " + table + " (k, c, pad) VALUES (?, ?, ?)",
+	};
+
+	struct Options {
+		Options()
+		: threads(4)
+		, seconds(10)
+		, report_interval(1)
+		, table_size(10000)
+		, range_size(100)
+		, per_connection(false)
+		, prepare(true)
+		, cleanup(false)
+		{
+			per_event[PointSelect] = 10;
+			per_event[RangeScan] = 1;
+			per_event[Update] = 2;
+			per_event[Insert] = 1;
+		}
+
+		size_t threads;
+		double seconds;
+		double report_interval;
+		uint64_t table_size;
+		uint64_t range_size;
+		//! Statements of each kind in an event.
+		size_t per_event[number_of_kinds];
+		//! Whether every thread keeps a connection of its own, rather than taking one from the pool per statement.
+		bool per_connection;
+		//! Whether to create and fill the table first.
+		bool prepare;
+		//! Whether to drop the table afterwards.
+		bool cleanup;
+	};
+
+	//! Counted by all threads together.
+	struct Totals : boost::noncopyable {
+		Totals()
+		: events(0)
+		, errors(0)
+		{
+			for(auto &q : statements) {
+				q = 0;
+			}
+		}
+
+		std::atomic<uint64_t> events;
+		std::atomic<uint64_t> errors;
+		std::atomic<uint64_t> statements[number_of_kinds];
+		//! Since the start.
+		rusql::LatencyHistogram event_latency;
+		rusql::LatencyHistogram latency[number_of_kinds];
+		//! Since the last report; cleared by it.
+		rusql::LatencyHistogram interval_latency;
+	};
+
+	//! Runs every statement on a connection taken from the pool for it.
+	struct Pooled {
+		rusql::Database &db;
+
+		template <typename ... T>
+		void select(std::string const& q, T const& ... args) {
+			std::string c;
+			auto statement = db.execute(q, args ...);
+			statement.bind_results(c);
+			while(statement.fetch()) {}
+		}
+
+		template <typename ... T>
+		void write(std::string const& q, T const& ... args) {
+			db.execute(q, args ...);
+		}
+	};
+
+	//! Runs every statement on the thread's own connection, prepared once.
+	struct Leased {
+		rusql::Lease &lease;
+
+		template <typename ... T>
+		void select(std::string const& q, T const& ... args) {
+			std::string c;
+			auto &statement = lease.execute_cached(q, args ...);
+			statement.bind_results(c);
+			while(statement.fetch()) {}
+			statement.free_result();
+		}
+
+		template <typename ... T>
+		void write(std::string const& q, T const& ... args) {
+			lease.execute_cached(q, args ...).free_result();
+		}
+	};
+
+	std::string filler(std::mt19937_64 &random, size_t const length) {
+		static char const digits[] = "0123456789";
+		std::string s(length, '-');
+		for(size_t i = 0; i < length; ++i) {
+			if(i % 12 != 11) {
+				s[i] = digits[random() % 10];
+			}
+		}
+		return s;
+	}
+
+	template <typename Runner>
+	void run_events(Runner runner, Options const& options, Totals &totals, std::atomic<bool> const& stop, unsigned const seed) {
+		std::mt19937_64 random(seed);
+		std::uniform_int_distribution<uint64_t> id(1, options.table_size);
+		uint64_t const range = std::min(options.range_size, options.table_size);
+		std::uniform_int_distribution<uint64_t> range_start(1, options.table_size - range + 1);
+
+		while(!stop.load(std::memory_order_relaxed)) {
+			auto const event_start = Clock::now();
+			bool failed = false;
+			for(int kind = 0; kind < number_of_kinds; ++kind) {
+				for(size_t i = 0; i < options.per_event[kind]; ++i) {
+					auto const start = Clock::now();
+					try {
+						switch(Kind(kind)) {
+						case PointSelect:
+							runner.select(queries[kind], id(random));
+							break;
+						case RangeScan: {
+							uint64_t const first = range_start(random);
+							runner.select(queries[kind], first, first + range - 1);
+							break;
+						}
+						case Update:
+							runner.write(queries[kind], id(random));
+							break;
+						case Insert:
+							runner.write(queries[kind], uint64_t(id(random)), filler(random, 120), filler(random, 60));
+							break;
+						case number_of_kinds:
+						default:
+							break;
+						}
+					} catch(std::exception &e) {
+						if(totals.errors++ == 0) {
+							std::cerr << "First error, in " << kind_names[kind] << ": " << e.what() << std::endl;
+						}
+						failed = true;
+					}
+					totals.latency[kind].record(Clock::now() - start);
+					++totals.statements[kind];
+				}
+			}
+			if(!failed) {
+				auto const took = Clock::now() - event_start;
+				totals.event_latency.record(took);
+				totals.interval_latency.record(took);
+				++totals.events;
+			}
+		}
+	}
+
+	//! Creates the table if it doesn't exist and fills it up to table_size rows.
+	void prepare_table(rusql::Database &db, Options const& options) {
+		db.query("CREATE TABLE IF NOT EXISTS " + table + " ("
+			"id BIGINT UNSIGNED NOT NULL AUTO_INCREMENT PRIMARY KEY, "
+			"k BIGINT UNSIGNED NOT NULL DEFAULT 0, "
+			"c CHAR(120) NOT NULL DEFAULT '', "
+			"pad CHAR(60) NOT NULL DEFAULT '', "
+			"KEY k (k))");
+		uint64_t rows = 0;
+		{
+			auto statement = db.execute("SELECT COUNT(*) FROM " + table);
+			statement.bind_results(rows);
+			while(statement.fetch()) {}
+		}
+		if(rows >= options.table_size) {
+			return;
+		}
+		std::cerr << "Filling " << table << " with " << options.table_size - rows << " rows" << std::endl;
+		std::mt19937_64 random(1);
+		uint64_t next = rows;
+		db.bulk_load(table, {"k", "c", "pad"}, [&](rusql::BulkWriter &writer) -> bool {
+			for(int i = 0; i < 1000 && next < options.table_size; ++i, ++next) {
+				writer.row(random() % options.table_size, filler(random, 120), filler(random, 60));
+			}
+			return next < options.table_size;
+		});
+	}
+
+	double ms(Clock::duration const d) {
+		return boost::chrono::duration<double, boost::milli>(d).count();
+	}
+
+	void usage() {
+		std::cerr << "Usage: rusql_loadgen [options] [<host> <user> <pass> <db>]" << std::endl
+		          << "Runs an OLTP load on the table " << table << " and reports throughput and latency." << std::endl
+		          << "  --threads=<n>              threads running events (4)" << std::endl
+		          << "  --time=<seconds>           how long to run (10)" << std::endl
+		          << "  --report-interval=<s>      seconds between reports, 0 for none (1)" << std::endl
+		          << "  --table-size=<rows>        rows in the table, and the range of ids used (10000)" << std::endl
+		          << "  --range-size=<rows>        rows per range scan (100)" << std::endl
+		          << "  --point-selects=<n>        point selects per event (10)" << std::endl
+		          << "  --range-scans=<n>          range scans per event (1)" << std::endl
+		          << "  --updates=<n>              updates per event (2)" << std::endl
+		          << "  --inserts=<n>              inserts per event (1)" << std::endl
+		          << "  --mode=pool|connection     take a pooled connection per statement (default), or keep one per thread" << std::endl
+		          << "  --no-prepare               use the table as it is, rather than creating and filling it" << std::endl
+		          << "  --cleanup                  drop the table afterwards" << std::endl
+		          << "Without a database to connect to, the embedded server is used." << std::endl;
+	}
+
+	//! Parses --name=value into value; whether arg was that option.
+	template <typename T>
+	bool option(char const* const arg, char const* const name, T &value) {
+		size_t const n = std::strlen(name);
+		if(std::strncmp(arg, name, n) != 0 || arg[n] != '=') {
+			return false;
+		}
+		std::istringstream in(arg + n + 1);
+		if(!(in >> value)) {
+			throw std::invalid_argument(std::string("Invalid value for ") + name + ": " + (arg + n + 1));
+		}
+		return true;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	std::vector<char*> args;
+	try {
+		for(int i = 0; i < argc; ++i) {
+			char const* const arg = argv[i];
+			std::string mode;
+			if(option(arg, "--threads", options.threads) || option(arg, "--time", options.seconds)
+				|| option(arg, "--report-interval", options.report_interval) || option(arg, "--table-size", options.table_size)
+				|| option(arg, "--range-size", options.range_size) || option(arg, "--point-selects", options.per_event[PointSelect])
+				|| option(arg, "--range-scans", options.per_event[RangeScan]) || option(arg, "--updates", options.per_event[Update])
+				|| option(arg, "--inserts", options.per_event[Insert])) {
+				continue;
+			} else if(option(arg, "--mode", mode)) {
+				if(mode != "pool" && mode != "connection") {
+					throw std::invalid_argument("--mode is pool or connection, not " + mode);
+				}
+				options.per_connection = mode == "connection";
+			} else if(std::strcmp(arg, "--no-prepare") == 0) {
+				options.prepare = false;
+			} else if(std::strcmp(arg, "--cleanup") == 0) {
+				options.cleanup = true;
+			} else if(std::strcmp(arg, "--help") == 0) {
+				usage();
+				return 0;
+			} else if(i > 0 && std::strncmp(arg, "--", 2) == 0) {
+				throw std::invalid_argument(std::string("Unknown option ") + arg);
+			} else {
+				args.push_back(argv[i]);
+			}
+		}
+		if(options.threads == 0 || options.table_size == 0 || options.range_size == 0) {
+			throw std::invalid_argument("--threads, --table-size and --range-size must be at least 1");
+		}
+	} catch(std::invalid_argument &e) {
+		std::cerr << e.what() << std::endl;
+		usage();
+		return 1;
+	}
+	if(args.size() != 1 && args.size() != 5) {
+		usage();
+		return 1;
+	}
+
+	std::shared_ptr<rusql::Database> db;
+	try {
+		db = std::make_shared<rusql::Database>(get_construction_info(int(args.size()), args.data()));
+		if(options.prepare) {
+			prepare_table(*db, options);
+		}
+	} catch(std::exception &e) {
+		std::cerr << "Can't prepare " << table << ": " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "threads: " << options.threads << ", mode: " << (options.per_connection ? "connection" : "pool")
+	          << ", per event: " << options.per_event[PointSelect] << " point selects, " << options.per_event[RangeScan]
+	          << " range scans, " << options.per_event[Update] << " updates, " << options.per_event[Insert] << " inserts" << std::endl;
+
+	Totals totals;
+	std::atomic<bool> stop(false);
+	auto const start = Clock::now();
+	std::vector<std::shared_ptr<boost::thread>> threads;
+	for(size_t t = 0; t < options.threads; ++t) {
+		threads.emplace_back(std::make_shared<boost::thread>([&, t]() {
+			auto thread_handle = db->get_thread_handle();
+			unsigned const seed = unsigned(t + 1);
+			if(options.per_connection) {
+				auto lease = db->acquire();
+				run_events(Leased{lease}, options, totals, stop, seed);
+			} else {
+				run_events(Pooled{*db}, options, totals, stop, seed);
+			}
+		}));
+	}
+
+	auto const end = start + boost::chrono::duration_cast<Clock::duration>(boost::chrono::duration<double>(options.seconds));
+	auto last = start;
+	uint64_t last_events = 0;
+	uint64_t last_statements = 0;
+	uint64_t last_errors = 0;
+	while(true) {
+		auto next = end;
+		if(options.report_interval > 0) {
+			next = std::min(end, last + boost::chrono::duration_cast<Clock::duration>(boost::chrono::duration<double>(options.report_interval)));
+		}
+		boost::this_thread::sleep_until(next);
+		auto const now = Clock::now();
+		if(options.report_interval > 0) {
+			uint64_t statements = 0;
+			for(auto const &s : totals.statements) {
+				statements += s;
+			}
+			uint64_t const events = totals.events;
+			uint64_t const errors = totals.errors;
+			double const seconds = boost::chrono::duration<double>(now - last).count();
+			std::cout << "[ " << boost::chrono::duration<double>(now - start).count() << "s ] events/s: " << double(events - last_events) / seconds
+			          << " statements/s: " << double(statements - last_statements) / seconds << " errors/s: " << double(errors - last_errors) / seconds
+			          << " latency ms p50: " << ms(totals.interval_latency.percentile(0.5)) << " p95: " << ms(totals.interval_latency.percentile(0.95))
+			          << " p99: " << ms(totals.interval_latency.percentile(0.99)) << std::endl;
+			totals.interval_latency.clear();
+			last_events = events;
+			last_statements = statements;
+			last_errors = errors;
+		}
+		last = now;
+		if(now >= end) {
+			break;
+		}
+	}
+	stop = true;
+	for(auto &thread : threads) {
+		thread->join();
+	}
+	double const seconds = boost::chrono::duration<double>(Clock::now() - start).count();
+
+	std::cout << "total: " << totals.events << " events, " << double(totals.events) / seconds << " events/s, "
+	          << totals.errors << " errors in " << seconds << " s" << std::endl;
+	std::cout << "event latency ms: p50 " << ms(totals.event_latency.percentile(0.5)) << " p95 " << ms(totals.event_latency.percentile(0.95))
+	          << " p99 " << ms(totals.event_latency.percentile(0.99)) << " max " << ms(totals.event_latency.percentile(1)) << std::endl;
+	std::cout << std::setprecision(3) << "statement\tcount\tper_second\tp50_ms\tp95_ms\tp99_ms\tmax_ms" << std::endl;
+	for(int kind = 0; kind < number_of_kinds; ++kind) {
+		auto const &latency = totals.latency[kind];
+		if(totals.statements[kind] == 0) {
+			continue;
+		}
+		std::cout << kind_names[kind] << '\t' << totals.statements[kind] << '\t' << double(totals.statements[kind]) / seconds << '\t'
+		          << ms(latency.percentile(0.5)) << '\t' << ms(latency.percentile(0.95)) << '\t' << ms(latency.percentile(0.99)) << '\t'
+		          << ms(latency.percentile(1)) << std::endl;
+	}
+
+	if(options.cleanup) {
+		try {
+			db->query("DROP TABLE " + table);
+		} catch(std::exception &e) {
+			std::cerr << "Can't drop " << table << ": " << e.what() << std::endl;
+		}
+	}
+	return totals.errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <rusql/rusql.hpp>
+#include "tests/database_test.hpp"
+
+namespace {
+	typedef boost::chrono::steady_clock Clock;
+
+	//! The recorded and replayed latencies of one fingerprint.
+	struct Shape : boost::noncopyable {
+		Shape()
+		: statements(0)
+		, errors(0)
+		{}
+
+		rusql::LatencyHistogram recorded;
+		rusql::LatencyHistogram replayed;
+		std::atomic<uint64_t> statements;
+		std::atomic<uint64_t> errors;
+	};
+
+	//! Statements that plain query() can't run, since they return rows.
+	bool returns_rows(std::string const& fingerprint) {
+		for(char const* const start : {"select", "show", "with", "explain", "describe", "desc ", "(", "call"}) {
+			if(fingerprint.compare(0, std::strlen(start), start) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void run(rusql::Lease& lease, rusql::RecordedStatement const& s) {
+		if(s.stage == rusql::mysql::QueryStage::Query) {
+			if(returns_rows(*s.fingerprint)) {
+				for(auto rs = lease.select_query(*s.sql); rs; rs.next()) {}
+			} else {
+				lease.query(*s.sql);
+			}
+			return;
+		}
+
+		std::vector<MYSQL_BIND> binds;
+		for(auto const &p : s.parameters) {
+			switch(p.type) {
+			case rusql::RecordedValue::Type::Null: binds.push_back(rusql::mysql::get_mysql_bind(boost::none)); break;
+			case rusql::RecordedValue::Type::Signed: binds.push_back(rusql::mysql::get_mysql_bind(p.signed_value)); break;
+			case rusql::RecordedValue::Type::Unsigned: binds.push_back(rusql::mysql::get_mysql_bind(p.unsigned_value)); break;
+			case rusql::RecordedValue::Type::String: binds.push_back(rusql::mysql::get_mysql_bind(p.string_value)); break;
+			default: assert(!"Unreachable code");
+			}
+		}
+		auto &statement = lease.prepare_cached(*s.sql);
+		statement.bind_parameter_binds(binds).execute();
+		if(statement.field_count() != 0) {
+			statement.bind_all_self();
+			while(statement.fetch()) {}
+		}
+		statement.free_result();
+	}
+
+	double ms(Clock::duration const d) {
+		return boost::chrono::duration<double, boost::milli>(d).count();
+	}
+
+	void usage() {
+		std::cerr << "Usage: rusql_replay [--speed=<factor>] [--threads=<n>] <recording> [<host> <user> <pass> <db>]" << std::endl
+		          << "Runs the statements of a recording made by Database::start_recording() again, each recorded thread on" << std::endl
+		          << "a connection of its own, and reports their latencies next to the recorded ones." << std::endl
+		          << "  --speed=<factor>  1 for the recorded pace (default), 2 for twice as fast, 0 for as fast as possible" << std::endl
+		          << "  --threads=<n>     run the recorded threads on n threads instead of one each" << std::endl
+		          << "Without a database to connect to, the embedded server is used." << std::endl;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	double speed = 1;
+	size_t workers = 0;
+	std::vector<char*> args;
+	for(int i = 0; i < argc; ++i) {
+		if(std::strncmp(argv[i], "--speed=", 8) == 0) {
+			speed = std::atof(argv[i] + 8);
+		} else if(std::strncmp(argv[i], "--threads=", 10) == 0) {
+			workers = size_t(std::atol(argv[i] + 10));
+		} else if(std::strcmp(argv[i], "--help") == 0) {
+			usage();
+			return 0;
+		} else {
+			args.push_back(argv[i]);
+		}
+	}
+	if(args.size() != 2 && args.size() != 6) {
+		usage();
+		return 1;
+	}
+	std::string const path = args[1];
+	args.erase(args.begin() + 1);
+
+	std::vector<rusql::RecordedStatement> statements;
+	try {
+		statements = rusql::read_workload(path);
+	} catch(std::exception &e) {
+		std::cerr << path << ": " << e.what() << std::endl;
+		return 1;
+	}
+	if(statements.empty()) {
+		std::cerr << path << ": no statements were recorded" << std::endl;
+		return 1;
+	}
+
+	std::map<std::string, std::unique_ptr<Shape>> shapes;
+	std::vector<Shape*> shape_of(statements.size());
+	uint32_t threads = 0;
+	std::vector<unsigned long> connections;
+	uint64_t first_us = statements.front().start_us;
+	uint64_t last_us = 0;
+	for(size_t i = 0; i < statements.size(); ++i) {
+		auto const &s = statements[i];
+		auto &shape = shapes[*s.fingerprint];
+		if(!shape) {
+			shape.reset(new Shape());
+		}
+		shape->recorded.record_microseconds(s.duration_us);
+		shape_of[i] = shape.get();
+		threads = std::max(threads, s.thread);
+		connections.push_back(s.connection_id);
+		first_us = std::min(first_us, s.start_us);
+		last_us = std::max(last_us, s.start_us + s.duration_us);
+	}
+	std::sort(connections.begin(), connections.end());
+	connections.erase(std::unique(connections.begin(), connections.end()), connections.end());
+	if(workers == 0) {
+		workers = threads;
+	}
+
+	// Each worker runs the statements of its recorded threads in the order they started; they were recorded as
+	// they ended
+	std::vector<std::vector<size_t>> plan(workers);
+	for(size_t i = 0; i < statements.size(); ++i) {
+		plan[(statements[i].thread - 1) % workers].push_back(i);
+	}
+	for(auto &indices : plan) {
+		std::stable_sort(indices.begin(), indices.end(), [&statements](size_t const a, size_t const b) {
+			return statements[a].start_us < statements[b].start_us;
+		});
+	}
+
+	std::shared_ptr<rusql::Database> db;
+	try {
+		db = std::make_shared<rusql::Database>(get_construction_info(int(args.size()), args.data()));
+	} catch(std::exception &e) {
+		std::cerr << "Can't connect: " << e.what() << std::endl;
+		return 1;
+	}
+
+	rusql::LatencyHistogram all;
+	std::atomic<uint64_t> errors(0);
+	std::atomic<int64_t> max_lag_ns(0);
+	auto const start = Clock::now();
+	std::vector<std::shared_ptr<boost::thread>> pool;
+	for(auto const &indices : plan) {
+		if(indices.empty()) {
+			continue;
+		}
+		pool.emplace_back(std::make_shared<boost::thread>([&, indices]() {
+			auto thread_handle = db->get_thread_handle();
+			auto lease = db->acquire();
+			for(size_t const i : indices) {
+				auto const &s = statements[i];
+				if(speed > 0) {
+					auto const due = start + boost::chrono::duration_cast<Clock::duration>(boost::chrono::duration<double, boost::micro>(double(s.start_us - first_us) / speed));
+					auto const now = Clock::now();
+					if(now < due) {
+						boost::this_thread::sleep_until(due);
+					} else {
+						int64_t const lag = boost::chrono::duration_cast<boost::chrono::nanoseconds>(now - due).count();
+						int64_t old = max_lag_ns.load();
+						while(lag > old && !max_lag_ns.compare_exchange_weak(old, lag)) {}
+					}
+				}
+
+				auto const began = Clock::now();
+				try {
+					run(lease, s);
+				} catch(std::exception &) {
+					++errors;
+					++shape_of[i]->errors;
+				}
+				auto const took = Clock::now() - began;
+				shape_of[i]->replayed.record(took);
+				++shape_of[i]->statements;
+				all.record(took);
+			}
+		}));
+	}
+	for(auto &thread : pool) {
+		thread->join();
+	}
+	auto const elapsed = Clock::now() - start;
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "recorded: " << statements.size() << " statements, " << threads << " threads, " << connections.size()
+	          << " connections, " << double(last_us - first_us) / 1e6 << " s" << std::endl;
+	std::cout << "replayed: " << all.count() << " statements on " << pool.size() << " threads in " << ms(elapsed) / 1000 << " s, "
+	          << double(all.count()) / boost::chrono::duration<double>(elapsed).count() << " statements/s, " << errors << " errors";
+	if(speed > 0) {
+		std::cout << ", at most " << double(max_lag_ns) / 1e6 << " ms behind schedule";
+	}
+	std::cout << std::endl;
+	std::cout << "latency: p50 " << ms(all.percentile(0.5)) << " ms, p90 " << ms(all.percentile(0.9)) << " ms, p99 "
+	          << ms(all.percentile(0.99)) << " ms, max " << ms(all.percentile(1)) << " ms" << std::endl;
+
+	std::vector<std::pair<std::string, Shape*>> by_count;
+	for(auto const &shape : shapes) {
+		by_count.push_back(std::make_pair(shape.first, shape.second.get()));
+	}
+	std::sort(by_count.begin(), by_count.end(), [](std::pair<std::string, Shape*> const& a, std::pair<std::string, Shape*> const& b) {
+		return a.second->statements > b.second->statements;
+	});
+	std::cout << "statements\terrors\trecorded_p50_ms\trecorded_p99_ms\treplayed_p50_ms\treplayed_p99_ms\tfingerprint" << std::endl;
+	for(auto const &shape : by_count) {
+		Shape const &s = *shape.second;
+		std::cout << s.statements << '\t' << s.errors << '\t' << ms(s.recorded.percentile(0.5)) << '\t' << ms(s.recorded.percentile(0.99)) << '\t'
+		          << ms(s.replayed.percentile(0.5)) << '\t' << ms(s.replayed.percentile(0.99)) << '\t' << shape.first << std::endl;
+	}
+	return errors == 0 ? 0 : 2;
+}